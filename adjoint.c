@@ -0,0 +1,351 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include "headers/fmi2TypesPlatform.h"
+#include "headers/fmi2FunctionTypes.h"
+#include "headers/fmi2Functions.h"
+
+/**
+ * @struct Checkpoint
+ * @brief Serialized state of the instance before a step of the forward run.
+ */
+typedef struct {
+    fmi2Byte *data;
+    size_t size;
+    int step;                        // index of the step which starts from this state
+    double time;
+    fmi2EventInfo eventInfo;
+    double *z;                       // event indicators, to detect the same state events again
+} Checkpoint;
+
+/**
+ * @struct Adjoint
+ * @brief Gradient of a scalar cost, the value of a state or Real output at tEnd, by the adjoint method.
+ *
+ * The forward run stores a checkpoint every interval steps. The backward pass recomputes each
+ * segment from its checkpoint, keeping the states of its steps, then integrates the discrete
+ * adjoint of the explicit Euler steps x+ = x + dt f(x, p) from the last step to the first:
+ *   mu += dt (df/dp)^T lambda,  lambda += dt (df/dx)^T lambda,
+ * from lambda = dcost/dx and mu = dcost/dp at tEnd. Then mu is the gradient with respect to the
+ * parameters and lambda the one with respect to the initial states. (df/dx)^T lambda is assembled
+ * from the colored Jacobian of the linearization, so the backward pass costs one directional
+ * derivative per color and per parameter for each step, whatever the number of outputs.
+ */
+typedef struct {
+    int cost;                        // variable index of the cost, -1 if the adjoint is disabled
+    int costState;                   // index in x of a cost which is a state, -1 otherwise
+    int costRow;                     // row of an output cost in the Jacobian pattern
+    const char *output;              // file the gradient is written to
+    int nx;
+    int *parameters;                 // variable index of the Real parameters
+    int nParameters;
+    fmi2ValueReference *unknownVRs;  // derivatives, then the cost
+    Linearization jacobian;          // pattern and coloring of [df/dx df/du; dg/dx dg/du]
+    double *values;                  // nonzeros of the Jacobian
+    double *lambda;                  // adjoint of the states
+    double *mu;                      // gradient with respect to the parameters
+    double *work;
+    double *du;
+    double *stepEnds;                // tEnd of each forward step, shortened at the operating points
+    int nSteps;
+    int stepCapacity;
+    Checkpoint *checkpoints;
+    int nCheckpoints;
+    int checkpointCapacity;
+    int interval;                    // steps between two checkpoints
+} Adjoint;
+
+/**
+ * @brief Sets the cost, a Real output or a continuous state at the end of the simulation.
+ *
+ * @return 0 on success, -1 if the name is not a Real output or a state.
+ */
+int setAdjointCost(Adjoint *adjoint, const char *name, const ScalarVariable *variables) {
+    int i = get_variable_index(name);
+    if (i < 0 || variables[i].type != REAL) return -1;
+
+    int found = 0;
+    for (int k = 0; k < model.numberOfContinuousStates; k++) found |= model_states[k].state == i;
+    for (int k = 0; k < NOUTPUTS; k++) found |= model_outputs[k].variable == i;
+    if (!found) return -1;
+    adjoint->cost = i;
+    return 0;
+}
+
+/**
+ * @brief Frees the memory held by the adjoint.
+ */
+void freeAdjoint(Adjoint *adjoint) {
+    for (int c = 0; c < adjoint->nCheckpoints; c++) {
+        free(adjoint->checkpoints[c].data);
+        free(adjoint->checkpoints[c].z);
+    }
+    free(adjoint->checkpoints);
+    free(adjoint->parameters);
+    free(adjoint->unknownVRs);
+    free(adjoint->values);
+    free(adjoint->lambda);
+    free(adjoint->mu);
+    free(adjoint->work);
+    free(adjoint->du);
+    free(adjoint->stepEnds);
+    freeLinearization(&adjoint->jacobian);
+    memset(adjoint, 0, sizeof(Adjoint));
+    adjoint->cost = -1;
+}
+
+/**
+ * @brief Builds the Jacobian pattern and the list of parameters, and sizes the checkpoints.
+ *
+ * The gradient is computed for every tunable Real parameter: a fixed one cannot be set after the
+ * initialization, which the finite difference of parameterDerivative does.
+ *
+ * @param adjoint The adjoint, its cost already set.
+ * @param variables The model variables.
+ * @param nVariables The number of model variables.
+ * @param nSteps The expected number of steps, there are about sqrt(nSteps) checkpoints.
+ * @return 0 on success, -1 on error.
+ */
+int initAdjoint(Adjoint *adjoint, const ScalarVariable *variables, int nVariables, int nSteps) {
+    if (!model.canGetAndSetFMUstate || !model.canSerializeFMUstate) {
+        printf("The adjoint needs an FMU which can get and serialize its state\n");
+        return -1;
+    }
+    if (initLinearization(&adjoint->jacobian, variables, nVariables) != 0) return -1;
+
+    const LinearizationPattern *pattern = &adjoint->jacobian.pattern;
+    int nx = pattern->nx;
+    adjoint->nx = nx;
+    adjoint->costState = -1;
+    adjoint->costRow = -1;
+    for (int k = 0; k < nx; k++) {
+        if (model_states[k].state == adjoint->cost) adjoint->costState = k;
+    }
+    for (int r = nx; r < nx + pattern->ny; r++) {
+        if (pattern->unknownVariables[r] == adjoint->cost) adjoint->costRow = r;
+    }
+
+    adjoint->parameters = (int*)malloc((nVariables + 1) * sizeof(int));
+    adjoint->unknownVRs = (fmi2ValueReference*)malloc((nx + 2) * sizeof(fmi2ValueReference));
+    adjoint->values = (double*)calloc(pattern->nNonZeros + 1, sizeof(double));
+    adjoint->lambda = (double*)calloc(nx + 1, sizeof(double));
+    adjoint->mu = (double*)calloc(nVariables + 1, sizeof(double));
+    adjoint->work = (double*)calloc(2 * nx + 4, sizeof(double));
+    adjoint->du = (double*)calloc(nx + 2, sizeof(double));
+    if (!adjoint->parameters || !adjoint->unknownVRs || !adjoint->values || !adjoint->lambda ||
+        !adjoint->mu || !adjoint->work || !adjoint->du) {
+        return -1;
+    }
+
+    for (int i = 0; i < nVariables; i++) {
+        if (variables[i].type == REAL && variables[i].causality == PARAMETER && variables[i].variability == TUNABLE) {
+            adjoint->parameters[adjoint->nParameters++] = i;
+        }
+    }
+    memcpy(adjoint->unknownVRs, pattern->unknownVRs, nx * sizeof(fmi2ValueReference));
+    adjoint->unknownVRs[nx] = variables[adjoint->cost].valueReference;
+
+    adjoint->interval = (int)sqrt((double)(nSteps > 1 ? nSteps : 1));
+    if (adjoint->interval < 1) adjoint->interval = 1;
+    return 0;
+}
+
+/**
+ * @brief Records a step of the forward run, saving a checkpoint every interval steps.
+ *
+ * Called before each step, with the instance and the simulation at the start of the step.
+ *
+ * @param stepEnd The end time the step is bounded by.
+ * @return fmi2Status The worst status of the FMU, fmi2Error if memory is exhausted
+ */
+fmi2Status addAdjointStep(FMU *fmu, fmi2Component component, Adjoint *adjoint, double stepEnd,
+                          double time, const fmi2EventInfo *eventInfo, const double *z, int nz) {
+    fmi2Status status = fmi2OK;
+
+    if (adjoint->nSteps == adjoint->stepCapacity) {
+        int capacity = adjoint->stepCapacity ? 2 * adjoint->stepCapacity : 1024;
+        double *stepEnds = (double*)realloc(adjoint->stepEnds, capacity * sizeof(double));
+        if (!stepEnds) return fmi2Error;
+        adjoint->stepEnds = stepEnds;
+        adjoint->stepCapacity = capacity;
+    }
+
+    if (adjoint->nSteps % adjoint->interval == 0) {
+        if (adjoint->nCheckpoints == adjoint->checkpointCapacity) {
+            int capacity = adjoint->checkpointCapacity ? 2 * adjoint->checkpointCapacity : 64;
+            Checkpoint *checkpoints = (Checkpoint*)realloc(adjoint->checkpoints, capacity * sizeof(Checkpoint));
+            if (!checkpoints) return fmi2Error;
+            adjoint->checkpoints = checkpoints;
+            adjoint->checkpointCapacity = capacity;
+        }
+
+        Checkpoint *checkpoint = &adjoint->checkpoints[adjoint->nCheckpoints];
+        memset(checkpoint, 0, sizeof(Checkpoint));
+        fmi2FMUstate fmuState = NULL;
+        status = fmu->getFMUstate(component, &fmuState);
+        if (status <= fmi2Warning) status = fmu->serializedFMUstateSize(component, fmuState, &checkpoint->size);
+        if (status <= fmi2Warning) {
+            checkpoint->data = (fmi2Byte*)malloc(checkpoint->size + 1);
+            checkpoint->z = (double*)malloc((nz + 1) * sizeof(double));
+            status = checkpoint->data && checkpoint->z
+                     ? fmu->serializeFMUstate(component, fmuState, checkpoint->data, checkpoint->size)
+                     : fmi2Error;
+        }
+        if (fmuState) fmu->freeFMUstate(component, &fmuState);
+        if (status > fmi2Warning) {
+            free(checkpoint->data);
+            free(checkpoint->z);
+            return status;
+        }
+
+        checkpoint->step = adjoint->nSteps;
+        checkpoint->time = time;
+        checkpoint->eventInfo = *eventInfo;
+        memcpy(checkpoint->z, z, nz * sizeof(double));
+        adjoint->nCheckpoints++;
+    }
+
+    adjoint->stepEnds[adjoint->nSteps++] = stepEnd;
+    return status;
+}
+
+/**
+ * @brief Puts the instance back in the state of a checkpoint.
+ */
+fmi2Status restoreCheckpoint(FMU *fmu, fmi2Component component, const Checkpoint *checkpoint) {
+    fmi2FMUstate fmuState = NULL;
+    fmi2Status status = fmu->deSerializeFMUstate(component, checkpoint->data, checkpoint->size, &fmuState);
+    if (status <= fmi2Warning) status = fmu->setFMUstate(component, fmuState);
+    if (fmuState) fmu->freeFMUstate(component, &fmuState);
+    return status;
+}
+
+/**
+ * @brief Derivatives and cost differentiated with respect to parameter j, in du[0..nx].
+ *
+ * A parameter is not a known of a directional derivative in continuous-time mode, which has the
+ * states and the inputs only: the derivative is a forward difference over setReal. Most FMUs
+ * accept a tunable parameter in continuous-time mode, although FMI 2.0 only requires it in event mode.
+ */
+static fmi2Status parameterDerivative(FMU *fmu, fmi2Component component, Adjoint *adjoint, int j, double *du) {
+    int nx = adjoint->nx;
+    fmi2ValueReference vr = model_variables[adjoint->parameters[j]].valueReference;
+    fmi2Status status, fmi2Flag;
+
+    double p0, p, *f0 = adjoint->work;
+    status = fmu->getReal(component, &vr, 1, &p0);
+    if (status <= fmi2Warning) {
+        fmi2Flag = fmu->getDerivatives(component, f0, nx);
+        if (fmi2Flag > status) status = fmi2Flag;
+        fmi2Flag = fmu->getReal(component, adjoint->unknownVRs + nx, 1, f0 + nx);
+        if (fmi2Flag > status) status = fmi2Flag;
+    }
+    if (status > fmi2Warning) return status;
+
+    double step = sqrt(DBL_EPSILON) * fmax(fabs(p0), 1.0);
+    p = p0 + step;
+    step = p - p0;
+    fmi2Flag = fmu->setReal(component, &vr, 1, &p);
+    if (fmi2Flag > status) status = fmi2Flag;
+    fmi2Flag = fmu->getDerivatives(component, du, nx);
+    if (fmi2Flag > status) status = fmi2Flag;
+    fmi2Flag = fmu->getReal(component, adjoint->unknownVRs + nx, 1, du + nx);
+    if (fmi2Flag > status) status = fmi2Flag;
+    for (int k = 0; k <= nx; k++) du[k] = (du[k] - f0[k]) / step;
+
+    fmi2Flag = fmu->setReal(component, &vr, 1, &p0);
+    return fmi2Flag > status ? fmi2Flag : status;
+}
+
+// Colored Jacobian of the derivatives and outputs at the current point of the instance
+static fmi2Status adjointJacobian(FMU *fmu, fmi2Component component, Adjoint *adjoint) {
+    return model.providesDirectionalDerivative
+           ? directionalJacobian(fmu, component, &adjoint->jacobian.pattern, adjoint->values)
+           : finiteDifferenceJacobian(fmu, component, &adjoint->jacobian.pattern, adjoint->values);
+}
+
+/**
+ * @brief Starts the backward pass: lambda = dcost/dx and mu = dcost/dp at the final point.
+ */
+fmi2Status adjointTerminal(FMU *fmu, fmi2Component component, Adjoint *adjoint) {
+    const LinearizationPattern *pattern = &adjoint->jacobian.pattern;
+    int nx = adjoint->nx;
+    fmi2Status status = fmi2OK, fmi2Flag;
+
+    memset(adjoint->lambda, 0, nx * sizeof(double));
+    memset(adjoint->mu, 0, adjoint->nParameters * sizeof(double));
+    if (adjoint->costState >= 0) {
+        adjoint->lambda[adjoint->costState] = 1.0;
+        return status;
+    }
+
+    status = adjointJacobian(fmu, component, adjoint);
+    for (int p = pattern->rowStart[adjoint->costRow]; p < pattern->rowStart[adjoint->costRow + 1]; p++) {
+        if (pattern->columns[p] < nx) adjoint->lambda[pattern->columns[p]] = adjoint->values[p];
+    }
+    for (int j = 0; j < adjoint->nParameters && status <= fmi2Warning; j++) {
+        fmi2Flag = parameterDerivative(fmu, component, adjoint, j, adjoint->du);
+        if (fmi2Flag > status) status = fmi2Flag;
+        adjoint->mu[j] = adjoint->du[nx];
+    }
+    return status;
+}
+
+/**
+ * @brief Steps the adjoint back over a forward step of size dt, the instance being at its start.
+ */
+fmi2Status adjointStep(FMU *fmu, fmi2Component component, Adjoint *adjoint, double dt) {
+    const LinearizationPattern *pattern = &adjoint->jacobian.pattern;
+    int nx = adjoint->nx;
+    double *transposed = adjoint->work + nx + 2;
+    fmi2Status status, fmi2Flag;
+
+    // (df/dx)^T lambda from the rows of the derivatives
+    status = adjointJacobian(fmu, component, adjoint);
+    memset(transposed, 0, nx * sizeof(double));
+    for (int r = 0; r < nx; r++) {
+        for (int p = pattern->rowStart[r]; p < pattern->rowStart[r + 1]; p++) {
+            if (pattern->columns[p] < nx) transposed[pattern->columns[p]] += adjoint->values[p] * adjoint->lambda[r];
+        }
+    }
+
+    // (df/dp)^T lambda, one column of df/dp per parameter
+    for (int j = 0; j < adjoint->nParameters && status <= fmi2Warning; j++) {
+        fmi2Flag = parameterDerivative(fmu, component, adjoint, j, adjoint->du);
+        if (fmi2Flag > status) status = fmi2Flag;
+        double dot = 0;
+        for (int k = 0; k < nx; k++) dot += adjoint->du[k] * adjoint->lambda[k];
+        adjoint->mu[j] += dt * dot;
+    }
+
+    for (int k = 0; k < nx; k++) adjoint->lambda[k] += dt * transposed[k];
+    return status;
+}
+
+/**
+ * @brief Writes the gradient of the cost, one "name,value" line per parameter and initial state.
+ *
+ * @return 0 on success, -1 if the file cannot be written.
+ */
+int writeGradient(const Adjoint *adjoint) {
+    FILE *file = fopen(adjoint->output, "w");
+    if (!file) {
+        printf("Could not open %s\n", adjoint->output);
+        return -1;
+    }
+    fprintf(file, "# gradient of %s at the end of the simulation\n", variable_names[adjoint->cost]);
+    for (int j = 0; j < adjoint->nParameters; j++) {
+        fprintf(file, "%s,%.17g\n", variable_names[adjoint->parameters[j]], adjoint->mu[j]);
+    }
+    for (int k = 0; k < adjoint->nx; k++) {
+        fprintf(file, "start(%s),%.17g\n", variable_names[model_states[k].state], adjoint->lambda[k]);
+    }
+    int failed = ferror(file);
+    if (fclose(file) != 0 || failed) {
+        printf("Could not write %s\n", adjoint->output);
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,604 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "headers/fmi2TypesPlatform.h"
+#include "headers/fmi2FunctionTypes.h"
+#include "headers/fmi2Functions.h"
+
+#define CALIBRATION_MAX_ITERATIONS 100
+#define CALIBRATION_TOLERANCE 1e-10  // relative decrease of the cost below which the search stops
+#define MAX_DATA_LINE_SIZE 65536
+
+/**
+ * @struct Measurements
+ * @brief Measured time series: one row per time, one column per measured variable.
+ */
+typedef struct {
+    int *signals;                    // variable index of each measured column
+    int nSignals;
+    double *times;                   // increasing measurement times
+    double *values;                  // nTimes rows of nSignals values, NAN if missing
+    int nTimes;
+} Measurements;
+
+/**
+ * @brief Simulates the model with candidate parameter values and samples the measured signals.
+ *
+ * @param context The context given to the calibration.
+ * @param parameters The candidate values, one per calibrated parameter.
+ * @param samples The simulated values at the measurement times, laid out as Measurements::values.
+ * @param jacobian If not NULL, d(sample)/d(parameter), one row of nParameters values per sample.
+ * @return fmi2Status The worst status of the simulation.
+ */
+typedef fmi2Status (*SampleFunction)(void *context, const double *parameters, double *samples, double *jacobian);
+
+typedef enum {
+    CALIBRATE_LM,                    // Levenberg-Marquardt, finite-difference Jacobian
+    CALIBRATE_LM_SENSITIVITY,        // Levenberg-Marquardt, Jacobian from forward sensitivities
+    CALIBRATE_NELDER_MEAD            // derivative-free simplex search
+} CalibrationMethod;
+
+/**
+ * @struct Calibration
+ * @brief Least-squares fit of parameters to measurements, cost = 1/2 sum (sample - measure)^2.
+ *
+ * Every simulation of an iteration is independent: the finite-difference columns, the damping
+ * factors tried by Levenberg-Marquardt and the candidate points of the simplex are simulated in
+ * parallel, each by its own instance, with at most one thread per processor.
+ */
+typedef struct {
+    Measurements data;
+    int *parameters;                 // variable index of each calibrated parameter
+    int nParameters;
+    double *values;                  // current estimate of the parameters
+    int method;                      // CalibrationMethod
+    const char *output;              // parameter file the fitted values are written to
+    SampleFunction sample;
+    void *context;
+    int maxThreads;
+    double cost;
+    int nSimulations;
+} Calibration;
+
+/**
+ * @brief Frees the memory held by the calibration.
+ */
+void freeCalibration(Calibration *calibration) {
+    free(calibration->data.signals);
+    free(calibration->data.times);
+    free(calibration->data.values);
+    free(calibration->parameters);
+    free(calibration->values);
+    memset(calibration, 0, sizeof(Calibration));
+}
+
+/**
+ * @brief Loads the measurements from a CSV file.
+ *
+ * The first line holds the column names: the time, then Real variables of the model. The
+ * separator is the first ',', ';' or tab of this line. Empty cells are missing measurements.
+ *
+ * @return 0 on success, -1 if the file cannot be read or is malformed.
+ */
+int loadMeasurements(Measurements *data, const char *path) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        printf("Could not open %s\n", path);
+        return -1;
+    }
+
+    char *line = (char*)malloc(MAX_DATA_LINE_SIZE);
+    if (!line || !fgets(line, MAX_DATA_LINE_SIZE, file)) {
+        printf("Empty measurement file %s\n", path);
+        free(line);
+        fclose(file);
+        return -1;
+    }
+    char sep = line[strcspn(line, ",;\t")];
+    if (sep == '\0') sep = ',';
+    line[strcspn(line, "\r\n")] = '\0';
+
+    // Header: time column, then one variable per column
+    int capacity = 1;
+    for (char *p = line; *p; p++) capacity += *p == sep;
+    data->signals = (int*)malloc(capacity * sizeof(int));
+    if (!data->signals) {
+        free(line);
+        fclose(file);
+        return -1;
+    }
+    char *name = strchr(line, sep);
+    while (name) {
+        char *next = strchr(++name, sep);
+        if (next) *next = '\0';
+        while (*name == ' ' || *name == '"') name++;
+        size_t length = strlen(name);
+        while (length > 0 && (name[length - 1] == ' ' || name[length - 1] == '"')) name[--length] = '\0';
+        int i = get_variable_index(name);
+        if (i < 0 || model_variables[i].type != REAL) {
+            printf("Measured column '%s' is not a Real variable of the model\n", name);
+            free(line);
+            fclose(file);
+            return -1;
+        }
+        data->signals[data->nSignals++] = i;
+        name = next;
+    }
+
+    // Rows: time, then the measured values
+    int rowCapacity = 0, result = 0;
+    while (result == 0 && fgets(line, MAX_DATA_LINE_SIZE, file)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#') continue;
+
+        if (data->nTimes == rowCapacity) {
+            rowCapacity = rowCapacity ? 2 * rowCapacity : 256;
+            double *times = (double*)realloc(data->times, rowCapacity * sizeof(double));
+            if (times) data->times = times;
+            double *values = (double*)realloc(data->values, (size_t)rowCapacity * data->nSignals * sizeof(double) + 1);
+            if (values) data->values = values;
+            if (!times || !values) {
+                result = -1;
+                break;
+            }
+        }
+
+        char *p = line, *end;
+        double *row = data->values + (size_t)data->nTimes * data->nSignals;
+        data->times[data->nTimes] = strtod(p, &end);
+        if (end == p || (data->nTimes > 0 && data->times[data->nTimes] <= data->times[data->nTimes - 1])) {
+            printf("Invalid or decreasing time in %s: %s\n", path, line);
+            result = -1;
+            break;
+        }
+        for (int k = 0; k < data->nSignals; k++) {
+            p = strchr(end, sep);
+            row[k] = NAN;
+            if (!p) continue;
+            p++;
+            row[k] = strtod(p, &end);
+            if (end == p) row[k] = NAN;
+        }
+        data->nTimes++;
+    }
+
+    free(line);
+    fclose(file);
+    if (result == 0 && (data->nTimes == 0 || data->nSignals == 0)) {
+        printf("No measurements in %s\n", path);
+        result = -1;
+    }
+    return result;
+}
+
+/**
+ * @brief Adds a Real parameter or start value to calibrate, given by its name.
+ *
+ * @return 0 on success, -1 if the variable cannot be set before initialization or memory is exhausted.
+ */
+int addCalibrationParameter(Calibration *calibration, const char *name, const ScalarVariable *variables) {
+    int i = get_variable_index(name);
+    if (i < 0 || variables[i].type != REAL || !isSettableBeforeInitialization(&variables[i])) return -1;
+
+    int *parameters = (int*)realloc(calibration->parameters, (calibration->nParameters + 1) * sizeof(int));
+    if (!parameters) return -1;
+    calibration->parameters = parameters;
+    calibration->parameters[calibration->nParameters++] = i;
+    return 0;
+}
+
+// Whether d(variable)/d(parameter) is available from the sensitivities: a state or a Real output
+static int isSensitivitySignal(const ScalarVariable *variables, int i) {
+    for (int k = 0; k < model.numberOfContinuousStates; k++) {
+        if (model_states[k].state == i) return 1;
+    }
+    return variables[i].causality == OUTPUT;
+}
+
+/**
+ * @brief Loads the measurements and takes the initial estimate from the start values.
+ *
+ * @param calibration The calibration, with its parameters and method.
+ * @param path The measurement file.
+ * @param variables The model variables.
+ * @param overrides The user overrides, which take precedence over the start values, may be NULL.
+ * @return 0 on success, -1 if the measurements are invalid or memory is exhausted.
+ */
+int initCalibration(Calibration *calibration, const char *path, const ScalarVariable *variables,
+                    const ParameterOverrides *overrides) {
+    if (loadMeasurements(&calibration->data, path) != 0) return -1;
+
+    if (calibration->method == CALIBRATE_LM_SENSITIVITY) {
+        for (int k = 0; k < calibration->data.nSignals; k++) {
+            if (!isSensitivitySignal(variables, calibration->data.signals[k])) {
+                printf("No sensitivity of '%s', expected a state or a Real output\n",
+                       variable_names[calibration->data.signals[k]]);
+                return -1;
+            }
+        }
+    }
+
+    calibration->values = (double*)malloc((calibration->nParameters + 1) * sizeof(double));
+    if (!calibration->values) return -1;
+    for (int j = 0; j < calibration->nParameters; j++) {
+        int i = calibration->parameters[j];
+        calibration->values[j] = variables[i].hasStart ? variable_starts[i].realValue : 0;
+        for (int k = 0; overrides && k < overrides->count; k++) {
+            if (strcmp(overrides->items[k].name, variable_names[i]) == 0) {
+                calibration->values[j] = atof(overrides->items[k].value);
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Sensitivity of a measured variable to the parameter p at the last recorded point.
+ */
+double sampleSensitivity(const Sensitivities *sensitivities, int variable, int p) {
+    for (int k = 0; k < sensitivities->nx; k++) {
+        if (model_states[k].state == variable) return sensitivities->s[(size_t)p * sensitivities->nx + k];
+    }
+    size_t width = (size_t)sensitivities->ny * sensitivities->nParameters;
+    for (int k = 0; k < sensitivities->ny; k++) {
+        if (sensitivities->outputs[k] == variable) {
+            return sensitivities->rows[(sensitivities->nRows - 1) * width + (size_t)k * sensitivities->nParameters + p];
+        }
+    }
+    return NAN;
+}
+
+/**
+ * @brief Job shared by the threads simulating a batch of candidates.
+ */
+typedef struct {
+    Calibration *calibration;
+    const double *candidates;        // n rows of nParameters values
+    double *samples;                 // n rows of nTimes * nSignals samples
+    double *jacobians;               // NULL, or n Jacobians of the samples
+    int n;
+    int next;                        // next candidate to simulate
+    fmi2Status status;
+    pthread_mutex_t lock;
+} CalibrationBatch;
+
+static void *calibrationWorker(void *arg) {
+    CalibrationBatch *batch = (CalibrationBatch*)arg;
+    Calibration *calibration = batch->calibration;
+    size_t nSamples = (size_t)calibration->data.nTimes * calibration->data.nSignals;
+
+    for (;;) {
+        pthread_mutex_lock(&batch->lock);
+        int k = batch->next++;
+        pthread_mutex_unlock(&batch->lock);
+        if (k >= batch->n) break;
+
+        fmi2Status status = calibration->sample(calibration->context,
+                                                batch->candidates + (size_t)k * calibration->nParameters,
+                                                batch->samples + k * nSamples,
+                                                batch->jacobians ? batch->jacobians + k * nSamples * calibration->nParameters : NULL);
+        pthread_mutex_lock(&batch->lock);
+        if (status > batch->status) batch->status = status;
+        pthread_mutex_unlock(&batch->lock);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Simulates n candidates, in parallel when there are several.
+ */
+static fmi2Status simulateCandidates(Calibration *calibration, const double *candidates, int n,
+                                     double *samples, double *jacobians) {
+    CalibrationBatch batch = {calibration, candidates, samples, jacobians, n, 0, fmi2OK};
+    pthread_t threads[64];
+    int nThreads = min(min(n, calibration->maxThreads), 64);
+    int started = 0;
+
+    pthread_mutex_init(&batch.lock, NULL);
+    for (int t = 1; t < nThreads; t++) {
+        if (pthread_create(&threads[started], NULL, calibrationWorker, &batch) == 0) started++;
+    }
+    calibrationWorker(&batch);
+    for (int t = 0; t < started; t++) pthread_join(threads[t], NULL);
+    pthread_mutex_destroy(&batch.lock);
+
+    calibration->nSimulations += n;
+    return batch.status;
+}
+
+// Residuals sample - measure, 0 for the missing measurements, and their cost 1/2 sum r^2
+static double residuals(const Measurements *data, const double *samples, double *r) {
+    double cost = 0;
+    for (size_t k = 0; k < (size_t)data->nTimes * data->nSignals; k++) {
+        r[k] = isnan(data->values[k]) ? 0 : samples[k] - data->values[k];
+        cost += 0.5 * r[k] * r[k];
+    }
+    return isnan(cost) ? INFINITY : cost;
+}
+
+/**
+ * @brief Levenberg-Marquardt iterations from the current estimate.
+ *
+ * At each iteration the normal equations (J^T J + lambda diag(J^T J)) dp = -J^T r are solved for
+ * three damping factors lambda/10, lambda and 10 lambda, whose candidates are simulated together.
+ */
+static fmi2Status levenbergMarquardt(Calibration *calibration) {
+    const Measurements *data = &calibration->data;
+    int nP = calibration->nParameters;
+    size_t m = (size_t)data->nTimes * data->nSignals;
+    int sensitivity = calibration->method == CALIBRATE_LM_SENSITIVITY;
+    int nCandidates = sensitivity ? 3 : (nP > 3 ? nP : 3);
+
+    double *candidates = (double*)malloc((size_t)nCandidates * nP * sizeof(double));
+    double *samples = (double*)malloc((nCandidates * m + 1) * sizeof(double));
+    double *jacobians = (double*)malloc((nCandidates * m * nP + 1) * sizeof(double));
+    double *J = (double*)malloc((m * nP + 1) * sizeof(double));
+    double *r = (double*)malloc((m + 1) * sizeof(double));
+    double *rTrial = (double*)malloc((m + 1) * sizeof(double));
+    double *A = (double*)malloc(((size_t)nP * nP + 1) * sizeof(double));
+    double *M = (double*)malloc(((size_t)nP * nP + 1) * sizeof(double));
+    double *g = (double*)malloc((nP + 1) * sizeof(double));
+    fmi2Status status = fmi2OK;
+    double lambda = 1e-3;
+
+    if (!candidates || !samples || !jacobians || !J || !r || !rTrial || !A || !M || !g) {
+        status = fmi2Error;
+        goto done;
+    }
+
+    status = simulateCandidates(calibration, calibration->values, 1, samples, sensitivity ? J : NULL);
+    calibration->cost = residuals(data, samples, r);
+    if (status > fmi2Warning || isinf(calibration->cost)) goto done;
+
+    for (int iteration = 0; iteration < CALIBRATION_MAX_ITERATIONS; iteration++) {
+        // Jacobian of the residuals, by forward differences simulated in parallel
+        if (!sensitivity) {
+            for (int j = 0; j < nP; j++) {
+                double *candidate = candidates + (size_t)j * nP;
+                memcpy(candidate, calibration->values, nP * sizeof(double));
+                double step = sqrt(DBL_EPSILON) * fmax(fabs(candidate[j]), 1.0);
+                candidate[j] += step;
+            }
+            status = simulateCandidates(calibration, candidates, nP, samples, NULL);
+            if (status > fmi2Warning) break;
+            for (int j = 0; j < nP; j++) {
+                double step = candidates[(size_t)j * nP + j] - calibration->values[j];
+                for (size_t k = 0; k < m; k++) {
+                    double rj = isnan(data->values[k]) ? 0 : samples[j * m + k] - data->values[k];
+                    J[k * nP + j] = (rj - r[k]) / step;
+                }
+            }
+        }
+        for (size_t k = 0; k < m; k++) {
+            if (isnan(data->values[k])) memset(J + k * nP, 0, nP * sizeof(double));
+        }
+
+        // Normal equations
+        for (int a = 0; a < nP; a++) {
+            g[a] = 0;
+            for (size_t k = 0; k < m; k++) g[a] += J[k * nP + a] * r[k];
+            for (int b = 0; b < nP; b++) {
+                double sum = 0;
+                for (size_t k = 0; k < m; k++) sum += J[k * nP + a] * J[k * nP + b];
+                A[a * nP + b] = sum;
+            }
+        }
+
+        // Three damping factors at once, increased until one of them decreases the cost
+        int best = -1;
+        double bestCost = calibration->cost, bestLambda = lambda;
+        for (int attempt = 0; attempt < 8 && best < 0; attempt++) {
+            double factors[3] = {lambda / 10, lambda, lambda * 10};
+            for (int c = 0; c < 3; c++) {
+                double *candidate = candidates + (size_t)c * nP;
+                memcpy(M, A, (size_t)nP * nP * sizeof(double));
+                for (int a = 0; a < nP; a++) {
+                    M[a * nP + a] += factors[c] * fmax(A[a * nP + a], DBL_EPSILON);
+                    candidate[a] = -g[a];
+                }
+                if (solveLinearSystem(M, candidate, nP) != 0) memset(candidate, 0, nP * sizeof(double));
+                for (int a = 0; a < nP; a++) candidate[a] += calibration->values[a];
+            }
+
+            fmi2Status fmi2Flag = simulateCandidates(calibration, candidates, 3, samples, sensitivity ? jacobians : NULL);
+            for (int c = 0; c < 3; c++) {
+                double cost = fmi2Flag > fmi2Warning ? INFINITY : residuals(data, samples + c * m, rTrial);
+                if (cost < bestCost) {
+                    best = c;
+                    bestCost = cost;
+                    bestLambda = factors[c];
+                }
+            }
+            if (best < 0) lambda *= 100;
+        }
+        if (best < 0) break;
+
+        double decrease = (calibration->cost - bestCost) / fmax(calibration->cost, DBL_MIN);
+        memcpy(calibration->values, candidates + (size_t)best * nP, nP * sizeof(double));
+        calibration->cost = residuals(data, samples + best * m, r);
+        if (sensitivity) memcpy(J, jacobians + best * m * nP, m * nP * sizeof(double));
+        lambda = fmax(bestLambda, 1e-12);
+        INFO("Iteration %d: cost %g, lambda %g\n", iteration, calibration->cost, lambda);
+        if (decrease < CALIBRATION_TOLERANCE || calibration->cost == 0) break;
+    }
+
+done:
+    free(candidates);
+    free(samples);
+    free(jacobians);
+    free(J);
+    free(r);
+    free(rTrial);
+    free(A);
+    free(M);
+    free(g);
+    return status;
+}
+
+/**
+ * @brief Nelder-Mead simplex search from the current estimate, without derivatives.
+ *
+ * The reflected, expanded and both contracted points of an iteration are simulated together,
+ * as well as the points of a shrink.
+ */
+static fmi2Status nelderMead(Calibration *calibration) {
+    const Measurements *data = &calibration->data;
+    int nP = calibration->nParameters, nVertices = nP + 1;
+    size_t m = (size_t)data->nTimes * data->nSignals;
+    int nBatch = nP > 4 ? nP : 4;
+
+    double *simplex = (double*)malloc((size_t)nVertices * nP * sizeof(double));
+    double *costs = (double*)malloc(nVertices * sizeof(double));
+    double *centroid = (double*)malloc(nP * sizeof(double));
+    double *candidates = (double*)malloc((size_t)nBatch * nP * sizeof(double));
+    double *samples = (double*)malloc((nBatch * m + 1) * sizeof(double));
+    double *r = (double*)malloc((m + 1) * sizeof(double));
+    fmi2Status status = fmi2OK;
+
+    if (!simplex || !costs || !centroid || !candidates || !samples || !r) {
+        status = fmi2Error;
+        goto done;
+    }
+
+    // Initial simplex: the estimate and one vertex moved by 10% along each parameter
+    memcpy(simplex, calibration->values, nP * sizeof(double));
+    for (int j = 0; j < nP; j++) {
+        double *vertex = simplex + (size_t)(j + 1) * nP;
+        memcpy(vertex, calibration->values, nP * sizeof(double));
+        vertex[j] += vertex[j] != 0 ? 0.1 * vertex[j] : 0.1;
+    }
+    for (int first = 0; first < nVertices && status <= fmi2Warning; first += nBatch) {
+        int n = min(nBatch, nVertices - first);
+        status = simulateCandidates(calibration, simplex + (size_t)first * nP, n, samples, NULL);
+        for (int c = 0; c < n; c++) costs[first + c] = residuals(data, samples + c * m, r);
+    }
+    if (status > fmi2Warning) goto done;
+
+    for (int iteration = 0; iteration < 200 * nP; iteration++) {
+        // Order the vertices by cost (insertion sort, the simplex is nearly sorted)
+        for (int a = 1; a < nVertices; a++) {
+            for (int b = a; b > 0 && costs[b] < costs[b - 1]; b--) {
+                double t = costs[b]; costs[b] = costs[b - 1]; costs[b - 1] = t;
+                for (int j = 0; j < nP; j++) {
+                    t = simplex[b * nP + j]; simplex[b * nP + j] = simplex[(b - 1) * nP + j]; simplex[(b - 1) * nP + j] = t;
+                }
+            }
+        }
+        double *worst = simplex + (size_t)nP * nP;
+        double size = 0;
+        for (int v = 1; v < nVertices; v++) {
+            for (int j = 0; j < nP; j++) {
+                size = fmax(size, fabs(simplex[v * nP + j] - simplex[j]) / fmax(fabs(simplex[j]), 1.0));
+            }
+        }
+        if (costs[nP] - costs[0] <= CALIBRATION_TOLERANCE * (fabs(costs[0]) + DBL_MIN) ||
+            size <= sqrt(CALIBRATION_TOLERANCE) * 1e-3) break;
+
+        for (int j = 0; j < nP; j++) {
+            centroid[j] = 0;
+            for (int v = 0; v < nP; v++) centroid[j] += simplex[v * nP + j] / nP;
+        }
+
+        // Reflection, expansion, outside and inside contraction
+        const double coefficients[4] = {1.0, 2.0, 0.5, -0.5};
+        for (int c = 0; c < 4; c++) {
+            for (int j = 0; j < nP; j++) {
+                candidates[c * nP + j] = centroid[j] + coefficients[c] * (centroid[j] - worst[j]);
+            }
+        }
+        status = simulateCandidates(calibration, candidates, 4, samples, NULL);
+        if (status > fmi2Warning) break;
+        double trial[4];
+        for (int c = 0; c < 4; c++) trial[c] = residuals(data, samples + c * m, r);
+
+        int chosen = -1;
+        if (trial[0] < costs[0]) {
+            chosen = trial[1] < trial[0] ? 1 : 0;
+        } else if (trial[0] < costs[nP - 1]) {
+            chosen = 0;
+        } else if (trial[0] < costs[nP]) {
+            if (trial[2] <= trial[0]) chosen = 2;
+        } else if (trial[3] < costs[nP]) {
+            chosen = 3;
+        }
+
+        if (chosen >= 0) {
+            memcpy(worst, candidates + (size_t)chosen * nP, nP * sizeof(double));
+            costs[nP] = trial[chosen];
+            continue;
+        }
+
+        // Shrink towards the best vertex
+        for (int first = 1; first < nVertices && status <= fmi2Warning; first += nBatch) {
+            int n = min(nBatch, nVertices - first);
+            for (int v = first; v < first + n; v++) {
+                for (int j = 0; j < nP; j++) {
+                    simplex[v * nP + j] = simplex[j] + 0.5 * (simplex[v * nP + j] - simplex[j]);
+                }
+            }
+            status = simulateCandidates(calibration, simplex + (size_t)first * nP, n, samples, NULL);
+            for (int c = 0; c < n; c++) costs[first + c] = residuals(data, samples + c * m, r);
+        }
+        if (status > fmi2Warning) break;
+    }
+
+    int best = 0;
+    for (int v = 1; v < nVertices; v++) {
+        if (costs[v] < costs[best]) best = v;
+    }
+    memcpy(calibration->values, simplex + (size_t)best * nP, nP * sizeof(double));
+    calibration->cost = costs[best];
+
+done:
+    free(simplex);
+    free(costs);
+    free(centroid);
+    free(candidates);
+    free(samples);
+    free(r);
+    return status;
+}
+
+/**
+ * @brief Fits the calibrated parameters to the measurements, from their current values.
+ *
+ * @param calibration The calibration, with its measurements, parameters, initial values and
+ *                    sample function.
+ * @return fmi2Status The worst status of the simulations, fmi2Error if memory is exhausted.
+ */
+fmi2Status runCalibration(Calibration *calibration) {
+    // A model instantiated only once per process simulates the candidates one after the other
+    long nProcessors = sysconf(_SC_NPROCESSORS_ONLN);
+    calibration->maxThreads = nProcessors > 0 && !model.canBeInstantiatedOnlyOncePerProcess ? (int)nProcessors : 1;
+    calibration->nSimulations = 0;
+
+    if (calibration->method == CALIBRATE_NELDER_MEAD) return nelderMead(calibration);
+    return levenbergMarquardt(calibration);
+}
+
+/**
+ * @brief Writes the fitted values as a parameter file, which --params can read back.
+ *
+ * @return 0 on success, -1 if the file cannot be written.
+ */
+int writeCalibration(const Calibration *calibration) {
+    FILE *file = fopen(calibration->output, "w");
+    if (!file) {
+        printf("Could not open %s\n", calibration->output);
+        return -1;
+    }
+    fprintf(file, "# cost %.17g after %d simulations\n", calibration->cost, calibration->nSimulations);
+    for (int j = 0; j < calibration->nParameters; j++) {
+        fprintf(file, "%s=%.17g\n", variable_names[calibration->parameters[j]], calibration->values[j]);
+    }
+    int failed = ferror(file);
+    if (fclose(file) != 0 || failed) {
+        printf("Could not write %s\n", calibration->output);
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,466 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+// Comparison of a result file with a reference, in a single streaming pass over both files
+
+#define READ_BUFFER_SIZE (1 << 20)
+
+/**
+ * @struct ResultReader
+ * @brief CSV result file read one row at a time.
+ */
+typedef struct {
+    FILE *file;
+    const char *path;
+    char *line;                      // current line, grown by getline
+    size_t lineSize;
+    char sep;
+    int nColumns;
+    char **names;                    // name of each column
+    char **fields;                   // start of each field of the current line
+    int timeColumn;
+    size_t nRows;
+} ResultReader;
+
+/**
+ * @struct Tube
+ * @brief Tolerance of one compared variable: |y - yref| <= max(abs, rel * |yref|), where yref may
+ * be any reference value less than shift away in time.
+ */
+typedef struct {
+    char *name;
+    double abs;
+    double rel;
+} Tube;
+
+/**
+ * @struct ComparedVariable
+ * @brief A variable present in both files, with its error statistics.
+ */
+typedef struct {
+    const char *name;
+    int resultColumn;
+    int referenceColumn;
+    double abs;
+    double rel;
+    double maxError;                 // largest |y - yref(t)|, yref interpolated at the result time
+    double maxErrorTime;
+    double sumSquares;
+    size_t nFailures;                // rows outside the tube
+} ComparedVariable;
+
+/**
+ * @struct ReferenceWindow
+ * @brief Reference rows around the current result time, in a ring buffer.
+ *
+ * It holds the rows from the last one before t - shift to the first one after t + shift, so
+ * that the tube and the interpolated reference are computed without reading the file again.
+ */
+typedef struct {
+    double *times;
+    double *values;                  // capacity rows of nVariables values
+    size_t first;
+    size_t count;
+    size_t capacity;
+    int nVariables;
+    int eof;
+} ReferenceWindow;
+
+// Reads the next data line, 0 at the end of the file
+static int readLine(ResultReader *reader) {
+    ssize_t length;
+    while ((length = getline(&reader->line, &reader->lineSize, reader->file)) >= 0) {
+        while (length > 0 && (reader->line[length - 1] == '\n' || reader->line[length - 1] == '\r')) {
+            reader->line[--length] = '\0';
+        }
+        if (length > 0 && reader->line[0] != '#') return 1;
+    }
+    return 0;
+}
+
+// Splits the current line at the separators outside quotes into fields, returns their number
+static int splitFields(ResultReader *reader, int maxFields) {
+    char *p = reader->line;
+    int n = 0;
+    while (p && n < maxFields) {
+        reader->fields[n++] = p;
+        int quoted = 0;
+        for (; *p && (quoted || *p != reader->sep); p++) {
+            if (*p == '"') quoted = !quoted;
+        }
+        if (*p) *p++ = '\0'; else p = NULL;
+    }
+    return n;
+}
+
+/**
+ * @brief Opens a result file and reads its header.
+ *
+ * The separator is the first ',', ';' or tab of the header. The time column is the one named
+ * "time", or the first one. Names may be quoted, with doubled quotes inside.
+ *
+ * @return 0 on success, -1 if the file cannot be read.
+ */
+static int openResults(ResultReader *reader, const char *path) {
+    memset(reader, 0, sizeof(ResultReader));
+    reader->path = path;
+    reader->file = fopen(path, "r");
+    if (!reader->file) {
+        printf("Could not open %s\n", path);
+        return -1;
+    }
+    setvbuf(reader->file, NULL, _IOFBF, READ_BUFFER_SIZE);
+    if (!readLine(reader)) {
+        printf("Empty result file %s\n", path);
+        return -1;
+    }
+
+    reader->sep = reader->line[strcspn(reader->line, ",;\t")];
+    if (reader->sep == '\0') reader->sep = ',';
+    int capacity = 1;
+    for (char *p = reader->line; *p; p++) capacity += *p == reader->sep;
+    reader->names = (char**)calloc(capacity, sizeof(char*));
+    reader->fields = (char**)malloc(capacity * sizeof(char*));
+    if (!reader->names || !reader->fields) return -1;
+
+    int nFields = splitFields(reader, capacity);
+    for (int c = 0; c < nFields; c++) {
+        char *name = reader->fields[c];
+        while (*name == ' ') name++;
+        size_t length = strlen(name);
+        while (length > 0 && name[length - 1] == ' ') length--;
+        if (length >= 2 && name[0] == '"' && name[length - 1] == '"') {
+            name++;
+            length -= 2;
+        }
+        char *copy = (char*)malloc(length + 1), *q = copy;
+        if (!copy) return -1;
+        for (size_t k = 0; k < length; k++) {
+            *q++ = name[k];
+            if (name[k] == '"' && k + 1 < length && name[k + 1] == '"') k++;
+        }
+        *q = '\0';
+        reader->names[reader->nColumns] = copy;
+        if (strcmp(copy, "time") == 0) reader->timeColumn = reader->nColumns;
+        reader->nColumns++;
+    }
+    return 0;
+}
+
+static void closeResults(ResultReader *reader) {
+    if (reader->file) fclose(reader->file);
+    for (int c = 0; reader->names && c < reader->nColumns; c++) free(reader->names[c]);
+    free(reader->names);
+    free(reader->fields);
+    free(reader->line);
+}
+
+/**
+ * @brief Reads the next row: its time and the values of the requested columns.
+ *
+ * @param columns Column of each value to read, in any order.
+ * @return 1 if a row was read, 0 at the end of the file, -1 if the row is malformed.
+ */
+static int readRow(ResultReader *reader, const int *columns, int n, double *time, double *values) {
+    if (!readLine(reader)) return 0;
+    reader->nRows++;
+
+    // Field start of each column, found in one scan of the line, separators inside quotes excluded
+    char **fields = reader->fields;
+    if (splitFields(reader, reader->nColumns) < reader->nColumns) {
+        printf("Missing values in %s, row %zu\n", reader->path, reader->nRows);
+        return -1;
+    }
+
+    char *end;
+    *time = strtod(fields[reader->timeColumn], &end);
+    if (end == fields[reader->timeColumn]) {
+        printf("Invalid time in %s, row %zu\n", reader->path, reader->nRows);
+        return -1;
+    }
+    for (int k = 0; k < n; k++) {
+        values[k] = strtod(fields[columns[k]], &end);
+        if (end == fields[columns[k]]) values[k] = NAN;
+    }
+    return 1;
+}
+
+// Row k of the window, 0 being the oldest
+static double *windowRow(const ReferenceWindow *window, size_t k) {
+    return window->values + ((window->first + k) % window->capacity) * window->nVariables;
+}
+
+static double windowTime(const ReferenceWindow *window, size_t k) {
+    return window->times[(window->first + k) % window->capacity];
+}
+
+// Appends the next reference row to the window, growing it if needed
+static int pushReference(ReferenceWindow *window, ResultReader *reader, const int *columns) {
+    if (window->count == window->capacity) {
+        size_t capacity = 2 * window->capacity;
+        double *times = (double*)malloc(capacity * sizeof(double));
+        double *values = (double*)malloc(capacity * window->nVariables * sizeof(double) + 1);
+        if (!times || !values) {
+            free(times);
+            free(values);
+            return -1;
+        }
+        for (size_t k = 0; k < window->count; k++) {
+            times[k] = windowTime(window, k);
+            memcpy(values + k * window->nVariables, windowRow(window, k), window->nVariables * sizeof(double));
+        }
+        free(window->times);
+        free(window->values);
+        window->times = times;
+        window->values = values;
+        window->first = 0;
+        window->capacity = capacity;
+    }
+
+    size_t slot = (window->first + window->count) % window->capacity;
+    int result = readRow(reader, columns, window->nVariables, &window->times[slot],
+                         window->values + slot * window->nVariables);
+    if (result == 0) window->eof = 1;
+    if (result == 1) {
+        if (window->count > 0 && window->times[slot] < windowTime(window, window->count - 1)) {
+            printf("Decreasing time in %s, row %zu\n", reader->path, reader->nRows);
+            return -1;
+        }
+        window->count++;
+    }
+    return result < 0 ? -1 : 0;
+}
+
+// Reference value of variable v at time t, interpolated linearly, held outside the window
+static double interpolateReference(const ReferenceWindow *window, int v, double t) {
+    size_t k = 0;
+    while (k + 1 < window->count && windowTime(window, k + 1) <= t) k++;
+    double t0 = windowTime(window, k), y0 = windowRow(window, k)[v];
+    if (k + 1 >= window->count || t <= t0) return y0;
+    double t1 = windowTime(window, k + 1), y1 = windowRow(window, k + 1)[v];
+    return t1 > t0 ? y0 + (y1 - y0) * (t - t0) / (t1 - t0) : y1;
+}
+
+static void printUsage(const char *program) {
+    printf("Usage: %s reference.csv result.csv [--abs tol] [--rel tol] [--shift dt]"
+           " [--var name=abs[,rel]]... [--quiet]\n", program);
+}
+
+/**
+ * @brief Compares a result file with a reference file.
+ *
+ * Both files are read once, row by row, and only the reference rows within the time shift of
+ * the current result row are kept, so the memory does not depend on the length of the files.
+ * Each result value must lie in the tube [min - tol, max + tol], where min and max are taken over
+ * the reference interpolated on [t - shift, t + shift]; a nonzero shift accepts events found a
+ * little earlier or later than in the reference.
+ *
+ * @return 0 if every value is inside its tube, 1 if some are not, -1 on error.
+ */
+int main(int argc, char *argv[]) {
+    const char *paths[2] = {NULL, NULL};
+    double absTolerance = 1e-6, relTolerance = 1e-4, shift = 0;
+    int quiet = 0, nPaths = 0, nTubes = 0;
+    Tube *tubes = (Tube*)calloc(argc, sizeof(Tube));
+    if (!tubes) return -1;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--abs") == 0 && i + 1 < argc) {
+            absTolerance = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--rel") == 0 && i + 1 < argc) {
+            relTolerance = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--shift") == 0 && i + 1 < argc) {
+            shift = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--var") == 0 && i + 1 < argc) {
+            char *equal = strrchr(argv[++i], '=');
+            if (!equal || equal == argv[i]) {
+                printf("Invalid tolerance '%s', expected name=abs[,rel]\n", argv[i]);
+                return -1;
+            }
+            Tube *tube = &tubes[nTubes++];
+            tube->name = strndup(argv[i], equal - argv[i]);
+            tube->rel = -1;
+            if (sscanf(equal + 1, "%lf,%lf", &tube->abs, &tube->rel) < 1) {
+                printf("Invalid tolerance '%s', expected name=abs[,rel]\n", argv[i]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--quiet") == 0) {
+            quiet = 1;
+        } else if (strncmp(argv[i], "--", 2) != 0 && nPaths < 2) {
+            paths[nPaths++] = argv[i];
+        } else {
+            printUsage(argv[0]);
+            return -1;
+        }
+    }
+    if (nPaths != 2 || shift < 0) {
+        printUsage(argv[0]);
+        return -1;
+    }
+
+    ResultReader reference, result;
+    if (openResults(&reference, paths[0]) != 0 || openResults(&result, paths[1]) != 0) return -1;
+
+    // Variables of the result found in the reference, except the step and the time
+    ComparedVariable *variables = (ComparedVariable*)calloc(result.nColumns, sizeof(ComparedVariable));
+    int *resultColumns = (int*)malloc(result.nColumns * sizeof(int));
+    int *referenceColumns = (int*)malloc(result.nColumns * sizeof(int));
+    double *values = (double*)malloc(result.nColumns * sizeof(double));
+    double *low = (double*)malloc(result.nColumns * sizeof(double));
+    double *high = (double*)malloc(result.nColumns * sizeof(double));
+    if (!variables || !resultColumns || !referenceColumns || !values || !low || !high) return -1;
+
+    int nVariables = 0;
+    for (int c = 0; c < result.nColumns; c++) {
+        if (c == result.timeColumn || strcmp(result.names[c], "step") == 0) continue;
+        int r = 0;
+        while (r < reference.nColumns && strcmp(reference.names[r], result.names[c]) != 0) r++;
+        if (r == reference.nColumns) {
+            if (!quiet) printf("%s is not in the reference, it is not compared\n", result.names[c]);
+            continue;
+        }
+        ComparedVariable *variable = &variables[nVariables];
+        variable->name = result.names[c];
+        variable->resultColumn = c;
+        variable->referenceColumn = r;
+        variable->abs = absTolerance;
+        variable->rel = relTolerance;
+        for (int t = 0; t < nTubes; t++) {
+            if (strcmp(tubes[t].name, variable->name) == 0) {
+                variable->abs = tubes[t].abs;
+                if (tubes[t].rel >= 0) variable->rel = tubes[t].rel;
+            }
+        }
+        resultColumns[nVariables] = c;
+        referenceColumns[nVariables] = r;
+        nVariables++;
+    }
+
+    // A reference variable the result lacks is a failure, the result is incomplete
+    int nMissing = 0;
+    for (int r = 0; r < reference.nColumns; r++) {
+        if (r == reference.timeColumn || strcmp(reference.names[r], "step") == 0) continue;
+        int c = 0;
+        while (c < result.nColumns && strcmp(result.names[c], reference.names[r]) != 0) c++;
+        if (c == result.nColumns) {
+            printf("%s is missing from the result\n", reference.names[r]);
+            nMissing++;
+        }
+    }
+    int failed = nMissing > 0;
+    if (nVariables == 0) {
+        printf("No common variable to compare\n");
+        return -1;
+    }
+
+    ReferenceWindow window = {0};
+    window.nVariables = nVariables;
+    window.capacity = 16;
+    window.times = (double*)malloc(window.capacity * sizeof(double));
+    window.values = (double*)malloc(window.capacity * nVariables * sizeof(double));
+    if (!window.times || !window.values) return -1;
+
+    int status = 0, firstReported = 0;
+    size_t nRows = 0;
+    double time, previousTime = -INFINITY;
+    while (status == 0 && (status = readRow(&result, resultColumns, nVariables, &time, values)) == 1) {
+        status = 0;
+        nRows++;
+        if (time < previousTime) {
+            printf("Decreasing time in %s, row %zu\n", paths[1], result.nRows);
+            status = -1;
+            break;
+        }
+        previousTime = time;
+
+        // Slide the window: read up to t + shift, drop the rows before t - shift but the last one
+        while (status == 0 && !window.eof && (window.count == 0 || windowTime(&window, window.count - 1) < time + shift)) {
+            status = pushReference(&window, &reference, referenceColumns);
+        }
+        while (window.count > 1 && windowTime(&window, 1) <= time - shift) {
+            window.first = (window.first + 1) % window.capacity;
+            window.count--;
+        }
+        if (status != 0 || window.count == 0) {
+            if (window.count == 0) printf("Empty reference %s\n", paths[0]);
+            status = -1;
+            break;
+        }
+
+        // Tube: extreme reference values over [t - shift, t + shift]
+        for (int v = 0; v < nVariables; v++) {
+            low[v] = high[v] = interpolateReference(&window, v, time - shift);
+            double end = interpolateReference(&window, v, time + shift);
+            low[v] = fmin(low[v], end);
+            high[v] = fmax(high[v], end);
+        }
+        for (size_t k = 0; shift > 0 && k < window.count; k++) {
+            double t = windowTime(&window, k);
+            if (t <= time - shift || t >= time + shift) continue;
+            const double *row = windowRow(&window, k);
+            for (int v = 0; v < nVariables; v++) {
+                low[v] = fmin(low[v], row[v]);
+                high[v] = fmax(high[v], row[v]);
+            }
+        }
+
+        for (int v = 0; v < nVariables; v++) {
+            ComparedVariable *variable = &variables[v];
+            double y = values[v];
+            double yRef = shift > 0 ? interpolateReference(&window, v, time) : low[v];
+            if (isnan(y) && isnan(yRef)) continue;   // non-numeric in both files, e.g. strings
+
+            double error = fabs(y - yRef);
+            if (isnan(error)) error = INFINITY;
+            variable->sumSquares += error * error;
+            if (error > variable->maxError) {
+                variable->maxError = error;
+                variable->maxErrorTime = time;
+            }
+
+            double tolerance = fmax(variable->abs, variable->rel * fmax(fabs(low[v]), fabs(high[v])));
+            if (!(y >= low[v] - tolerance && y <= high[v] + tolerance)) {
+                variable->nFailures++;
+                failed = 1;
+                if (!firstReported) {
+                    printf("First failure: %s = %.17g at t=%.17g, outside [%.17g, %.17g]\n", variable->name, y, time,
+                           low[v] - tolerance, high[v] + tolerance);
+                    firstReported = 1;
+                }
+            }
+        }
+    }
+
+    if (status == 0) {
+        if (!quiet || failed) {
+            printf("%-24s %12s %14s %14s %10s\n", "variable", "max error", "at time", "rms error", "failures");
+            for (int v = 0; v < nVariables; v++) {
+                const ComparedVariable *variable = &variables[v];
+                if (quiet && variable->nFailures == 0) continue;
+                printf("%-24s %12.4g %14.8g %14.4g %10zu\n", variable->name, variable->maxError,
+                       variable->maxErrorTime, nRows ? sqrt(variable->sumSquares / nRows) : 0.0,
+                       variable->nFailures);
+            }
+        }
+        printf("%s: %zu rows, %d variables compared", failed ? "FAILED" : "PASSED", nRows, nVariables);
+        if (nMissing > 0) printf(", %d missing", nMissing);
+        printf("\n");
+    }
+
+    closeResults(&reference);
+    closeResults(&result);
+    for (int t = 0; t < nTubes; t++) free(tubes[t].name);
+    free(tubes);
+    free(variables);
+    free(resultColumns);
+    free(referenceColumns);
+    free(values);
+    free(low);
+    free(high);
+    free(window.times);
+    free(window.values);
+    return status != 0 ? -1 : failed;
+}
@@ -0,0 +1,190 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "headers/fmi2TypesPlatform.h"
+#include "headers/fmi2FunctionTypes.h"
+#include "headers/fmi2Functions.h"
+
+#define EXCHANGE_MAGIC "FMUSHM01"
+#define EXCHANGE_ALIGN 64            // cache line, the rig and the simulation never share one
+
+/**
+ * @struct ExchangeHeader
+ * @brief Start of the shared memory region, followed by the value references then the values.
+ *
+ * Layout, each part starting on a 64 bytes boundary: this header, the input value references and
+ * the output value references as uint32, the input values and the output values as doubles.
+ * Each direction is a sequence lock: the writer makes its counter odd, writes the values, then
+ * makes it even again. A reader copies the values between two reads of the same even counter.
+ */
+typedef struct {
+    char magic[8];                   // "FMUSHM01"
+    uint32_t nInputs;
+    uint32_t nOutputs;
+    uint64_t inputVrsOffset;         // offsets from the start of the region, in bytes
+    uint64_t outputVrsOffset;
+    uint64_t inputsOffset;
+    uint64_t outputsOffset;
+    _Alignas(EXCHANGE_ALIGN) _Atomic uint64_t inputSequence;   // written by the rig
+    _Alignas(EXCHANGE_ALIGN) _Atomic uint64_t outputSequence;  // written by the simulation
+    double time;                     // model time of the outputs
+    uint64_t cycle;                  // number of steps published
+} ExchangeHeader;
+
+/**
+ * @struct Exchange
+ * @brief Inputs and outputs exchanged with another process at each step, through POSIX shared memory.
+ */
+typedef struct {
+    char *name;                      // shared memory object, e.g. "/fmusim"
+    ExchangeHeader *header;
+    size_t size;
+    fmi2ValueReference *inputVrs;
+    fmi2ValueReference *outputVrs;
+    double *inputs;                  // in the region
+    double *outputs;
+    double *values;                  // private copy, setReal and getReal never touch the region
+    uint64_t lastInput;              // input sequence applied last
+} Exchange;
+
+static size_t alignExchange(size_t offset) {
+    return (offset + EXCHANGE_ALIGN - 1) & ~(size_t)(EXCHANGE_ALIGN - 1);
+}
+
+/**
+ * @brief Creates the shared memory region of the Real inputs and outputs of the model.
+ *
+ * The input values of the region start from the current values of the instance, so that the
+ * inputs do not change until the rig writes them. An existing region is never taken over, it may
+ * belong to another running simulation.
+ *
+ * @return 0 on success, -1 if the region exists already or cannot be created.
+ */
+int openExchange(Exchange *exchange, const char *name, FMU *fmu, fmi2Component component,
+                 const ScalarVariable *variables, int nVariables) {
+    int nInputs = 0, nOutputs = 0;
+    for (int i = 0; i < nVariables; i++) {
+        if (variables[i].type != REAL) continue;
+        if (variables[i].causality == INPUT) nInputs++;
+        if (variables[i].causality == OUTPUT) nOutputs++;
+    }
+
+    size_t inputVrsOffset = alignExchange(sizeof(ExchangeHeader));
+    size_t outputVrsOffset = alignExchange(inputVrsOffset + nInputs * sizeof(uint32_t));
+    size_t inputsOffset = alignExchange(outputVrsOffset + nOutputs * sizeof(uint32_t));
+    size_t outputsOffset = alignExchange(inputsOffset + nInputs * sizeof(double));
+    exchange->size = alignExchange(outputsOffset + nOutputs * sizeof(double));
+
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0 && errno == EEXIST) {
+        printf("The shared memory %s exists already, it may be used by another simulation\n", name);
+        return -1;
+    }
+    if (fd < 0 || ftruncate(fd, (off_t)exchange->size) != 0) {
+        printf("Could not create the shared memory %s\n", name);
+        if (fd >= 0) {
+            close(fd);
+            shm_unlink(name);
+        }
+        return -1;
+    }
+    void *region = mmap(NULL, exchange->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    exchange->name = strdup(name);
+    if (region == MAP_FAILED || !exchange->name) {
+        printf("Could not map the shared memory %s\n", name);
+        return -1;
+    }
+
+    char *bytes = (char*)region;
+    memset(bytes, 0, exchange->size);
+    exchange->header = (ExchangeHeader*)region;
+    exchange->inputVrs = (fmi2ValueReference*)(bytes + inputVrsOffset);
+    exchange->outputVrs = (fmi2ValueReference*)(bytes + outputVrsOffset);
+    exchange->inputs = (double*)(bytes + inputsOffset);
+    exchange->outputs = (double*)(bytes + outputsOffset);
+    exchange->values = (double*)malloc((nInputs + nOutputs + 1) * sizeof(double));
+    if (!exchange->values) return -1;
+
+    ExchangeHeader *header = exchange->header;
+    header->nInputs = (uint32_t)nInputs;
+    header->nOutputs = (uint32_t)nOutputs;
+    header->inputVrsOffset = inputVrsOffset;
+    header->outputVrsOffset = outputVrsOffset;
+    header->inputsOffset = inputsOffset;
+    header->outputsOffset = outputsOffset;
+    nInputs = nOutputs = 0;
+    for (int i = 0; i < nVariables; i++) {
+        if (variables[i].type != REAL) continue;
+        if (variables[i].causality == INPUT) exchange->inputVrs[nInputs++] = variables[i].valueReference;
+        if (variables[i].causality == OUTPUT) exchange->outputVrs[nOutputs++] = variables[i].valueReference;
+    }
+    if (nInputs > 0 && fmu->getReal(component, exchange->inputVrs, nInputs, exchange->inputs) > fmi2Warning) {
+        return -1;
+    }
+
+    // The magic is written last, a rig waiting for it then sees a complete layout
+    atomic_thread_fence(memory_order_release);
+    memcpy(header->magic, EXCHANGE_MAGIC, sizeof(header->magic));
+    return 0;
+}
+
+/**
+ * @brief Unmaps and removes the shared memory region.
+ */
+void closeExchange(Exchange *exchange) {
+    if (exchange->header) munmap(exchange->header, exchange->size);
+    if (exchange->name) shm_unlink(exchange->name);
+    free(exchange->name);
+    free(exchange->values);
+    memset(exchange, 0, sizeof(Exchange));
+}
+
+/**
+ * @brief Sets the inputs last written by the rig, if they changed since the previous step.
+ *
+ * Never waits for the rig: the inputs keep their values until it writes new ones. The read is
+ * retried only while the rig is in the middle of a write.
+ */
+fmi2Status readExchangeInputs(FMU *fmu, fmi2Component component, Exchange *exchange) {
+    ExchangeHeader *header = exchange->header;
+    uint32_t n = header->nInputs;
+    uint64_t sequence;
+    for (;;) {
+        sequence = atomic_load_explicit(&header->inputSequence, memory_order_acquire);
+        if (sequence == exchange->lastInput) return fmi2OK;
+        if (sequence & 1) continue;
+        memcpy(exchange->values, exchange->inputs, n * sizeof(double));
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&header->inputSequence, memory_order_relaxed) == sequence) break;
+    }
+    exchange->lastInput = sequence;
+    return n > 0 ? fmu->setReal(component, exchange->inputVrs, n, exchange->values) : fmi2OK;
+}
+
+/**
+ * @brief Publishes the outputs and the time of the step just completed.
+ */
+fmi2Status publishExchangeOutputs(FMU *fmu, fmi2Component component, Exchange *exchange, double time) {
+    ExchangeHeader *header = exchange->header;
+    uint32_t n = header->nOutputs;
+    if (n > 0) {
+        fmi2Status status = fmu->getReal(component, exchange->outputVrs, n, exchange->values);
+        if (status > fmi2Warning) return status;
+    }
+
+    uint64_t sequence = atomic_load_explicit(&header->outputSequence, memory_order_relaxed);
+    atomic_store_explicit(&header->outputSequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memcpy(exchange->outputs, exchange->values, n * sizeof(double));
+    header->time = time;
+    header->cycle++;
+    atomic_store_explicit(&header->outputSequence, sequence + 2, memory_order_release);
+    return fmi2OK;
+}
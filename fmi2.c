@@ -267,8 +267,22 @@ typedef struct {
  * - fmi2GetEventIndicators
  * - fmi2GetContinuousStates
  * - fmi2GetNominalsOfContinuousStates
+ *
+ * together with fmi2SetRealInputDerivatives, fmi2GetRealOutputDerivatives, fmi2DoStep,
+ * fmi2GetStatus, fmi2GetRealStatus and fmi2GetBooleanStatus, which step the co-simulation
+ * slaves of an SSP system. They are weak references, left NULL when the sources of the FMU
+ * implement Model Exchange only.
  */
 
+#ifndef FMI_COSIMULATION
+extern fmi2SetRealInputDerivativesTYPE fmi2SetRealInputDerivatives __attribute__((weak));
+extern fmi2GetRealOutputDerivativesTYPE fmi2GetRealOutputDerivatives __attribute__((weak));
+extern fmi2DoStepTYPE fmi2DoStep __attribute__((weak));
+extern fmi2GetStatusTYPE fmi2GetStatus __attribute__((weak));
+extern fmi2GetRealStatusTYPE fmi2GetRealStatus __attribute__((weak));
+extern fmi2GetBooleanStatusTYPE fmi2GetBooleanStatus __attribute__((weak));
+#endif
+
 static int loadFunctions(FMU *fmu) {
     fmu->getTypesPlatform          = (fmi2GetTypesPlatformTYPE *)      fmi2GetTypesPlatform;
     fmu->getVersion                = (fmi2GetVersionTYPE *)            fmi2GetVersion;
@@ -316,6 +330,12 @@ static int loadFunctions(FMU *fmu) {
     fmu->getEventIndicators        = (fmi2GetEventIndicatorsTYPE *)    fmi2GetEventIndicators;
     fmu->getContinuousStates       = (fmi2GetContinuousStatesTYPE *)   fmi2GetContinuousStates;
     fmu->getNominalsOfContinuousStates = (fmi2GetNominalsOfContinuousStatesTYPE *) fmi2GetNominalsOfContinuousStates;
+    fmu->setRealInputDerivatives   = (fmi2SetRealInputDerivativesTYPE *) fmi2SetRealInputDerivatives;
+    fmu->getRealOutputDerivatives  = (fmi2GetRealOutputDerivativesTYPE *) fmi2GetRealOutputDerivatives;
+    fmu->doStep                    = (fmi2DoStepTYPE *)                fmi2DoStep;
+    fmu->getStatus                 = (fmi2GetStatusTYPE *)             fmi2GetStatus;
+    fmu->getRealStatus             = (fmi2GetRealStatusTYPE *)         fmi2GetRealStatus;
+    fmu->getBooleanStatus          = (fmi2GetBooleanStatusTYPE *)      fmi2GetBooleanStatus;
 #endif
     return 0;
 }
@@ -0,0 +1,196 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include "headers/fmi3PlatformTypes.h"
+#include "headers/fmi3FunctionTypes.h"
+#include "headers/fmi3Functions.h"
+#include "fmu/sources/config.h"
+#include "fmu/sources/model.h"
+
+
+/**
+ * @struct FMU3
+ * @brief Structure representing an FMI 3.0 FMU with function pointers for the FMI operations.
+ *
+ * This is the FMI 3.0 counterpart of the FMU structure of fmi2.c. It contains the common functions
+ * and either the Co-Simulation or the Model Exchange functions, depending on FMI_COSIMULATION.
+ * Scheduled Execution is not supported.
+ *
+ * Unlike FMI 2.0, the getters and setters are typed by width (getFloat64, getInt32, ...) and take
+ * the total number of values in addition to the number of value references: an array variable has
+ * a single value reference and all its elements are exchanged in one call.
+ */
+typedef struct {
+    /***************************************************
+    Common Functions
+    ****************************************************/
+    fmi3GetVersionTYPE                      *getVersion;
+    fmi3SetDebugLoggingTYPE                 *setDebugLogging;
+    fmi3FreeInstanceTYPE                    *freeInstance;
+    fmi3EnterInitializationModeTYPE         *enterInitializationMode;
+    fmi3ExitInitializationModeTYPE          *exitInitializationMode;
+    fmi3EnterEventModeTYPE                  *enterEventMode;
+    fmi3TerminateTYPE                       *terminate;
+    fmi3ResetTYPE                           *reset;
+    fmi3GetFloat32TYPE                      *getFloat32;
+    fmi3GetFloat64TYPE                      *getFloat64;
+    fmi3GetInt8TYPE                         *getInt8;
+    fmi3GetUInt8TYPE                        *getUInt8;
+    fmi3GetInt16TYPE                        *getInt16;
+    fmi3GetUInt16TYPE                       *getUInt16;
+    fmi3GetInt32TYPE                        *getInt32;
+    fmi3GetUInt32TYPE                       *getUInt32;
+    fmi3GetInt64TYPE                        *getInt64;
+    fmi3GetUInt64TYPE                       *getUInt64;
+    fmi3GetBooleanTYPE                      *getBoolean;
+    fmi3GetStringTYPE                       *getString;
+    fmi3GetBinaryTYPE                       *getBinary;
+    fmi3GetClockTYPE                        *getClock;
+    fmi3SetFloat32TYPE                      *setFloat32;
+    fmi3SetFloat64TYPE                      *setFloat64;
+    fmi3SetInt8TYPE                         *setInt8;
+    fmi3SetUInt8TYPE                        *setUInt8;
+    fmi3SetInt16TYPE                        *setInt16;
+    fmi3SetUInt16TYPE                       *setUInt16;
+    fmi3SetInt32TYPE                        *setInt32;
+    fmi3SetUInt32TYPE                       *setUInt32;
+    fmi3SetInt64TYPE                        *setInt64;
+    fmi3SetUInt64TYPE                       *setUInt64;
+    fmi3SetBooleanTYPE                      *setBoolean;
+    fmi3SetStringTYPE                       *setString;
+    fmi3SetBinaryTYPE                       *setBinary;
+    fmi3SetClockTYPE                        *setClock;
+    fmi3GetNumberOfVariableDependenciesTYPE *getNumberOfVariableDependencies;
+    fmi3GetVariableDependenciesTYPE         *getVariableDependencies;
+    fmi3GetFMUStateTYPE                     *getFMUState;
+    fmi3SetFMUStateTYPE                     *setFMUState;
+    fmi3FreeFMUStateTYPE                    *freeFMUState;
+    fmi3SerializedFMUStateSizeTYPE          *serializedFMUStateSize;
+    fmi3SerializeFMUStateTYPE               *serializeFMUState;
+    fmi3DeserializeFMUStateTYPE             *deserializeFMUState;
+    fmi3GetDirectionalDerivativeTYPE        *getDirectionalDerivative;
+    fmi3GetAdjointDerivativeTYPE            *getAdjointDerivative;
+    fmi3EnterConfigurationModeTYPE          *enterConfigurationMode;
+    fmi3ExitConfigurationModeTYPE           *exitConfigurationMode;
+    fmi3GetIntervalDecimalTYPE              *getIntervalDecimal;
+    fmi3GetIntervalFractionTYPE             *getIntervalFraction;
+    fmi3GetShiftDecimalTYPE                 *getShiftDecimal;
+    fmi3GetShiftFractionTYPE                *getShiftFraction;
+    fmi3SetIntervalDecimalTYPE              *setIntervalDecimal;
+    fmi3SetIntervalFractionTYPE             *setIntervalFraction;
+    fmi3SetShiftDecimalTYPE                 *setShiftDecimal;
+    fmi3SetShiftFractionTYPE                *setShiftFraction;
+    fmi3EvaluateDiscreteStatesTYPE          *evaluateDiscreteStates;
+    fmi3UpdateDiscreteStatesTYPE            *updateDiscreteStates;
+    /***************************************************
+    Functions for FMI3 for Co-Simulation
+    ****************************************************/
+    fmi3InstantiateCoSimulationTYPE *instantiateCoSimulation;
+    fmi3EnterStepModeTYPE           *enterStepMode;
+    fmi3GetOutputDerivativesTYPE    *getOutputDerivatives;
+    fmi3DoStepTYPE                  *doStep;
+    /***************************************************
+    Functions for FMI3 for Model Exchange
+    ****************************************************/
+    fmi3InstantiateModelExchangeTYPE      *instantiateModelExchange;
+    fmi3EnterContinuousTimeModeTYPE       *enterContinuousTimeMode;
+    fmi3CompletedIntegratorStepTYPE       *completedIntegratorStep;
+    fmi3SetTimeTYPE                       *setTime;
+    fmi3SetContinuousStatesTYPE           *setContinuousStates;
+    fmi3GetContinuousStateDerivativesTYPE *getContinuousStateDerivatives;
+    fmi3GetEventIndicatorsTYPE            *getEventIndicators;
+    fmi3GetContinuousStatesTYPE           *getContinuousStates;
+    fmi3GetNominalsOfContinuousStatesTYPE *getNominalsOfContinuousStates;
+    fmi3GetNumberOfEventIndicatorsTYPE    *getNumberOfEventIndicators;
+    fmi3GetNumberOfContinuousStatesTYPE   *getNumberOfContinuousStates;
+} FMU3;
+
+
+/**
+ * @brief Loads the function pointers of the FMU3 structure.
+ *
+ * The FMU sources are compiled with the simulator, so the pointers are the fmi3 functions themselves,
+ * as in loadFunctions() of fmi2.c. The Co-Simulation functions are loaded if FMI_COSIMULATION is
+ * defined, the Model Exchange functions otherwise.
+ *
+ * @param fmu A pointer to the FMU3 structure where the function pointers will be loaded.
+ * @return Returns 0 on success.
+ */
+static int loadFunctions3(FMU3 *fmu) {
+    fmu->getVersion                      = (fmi3GetVersionTYPE *)                      fmi3GetVersion;
+    fmu->setDebugLogging                 = (fmi3SetDebugLoggingTYPE *)                 fmi3SetDebugLogging;
+    fmu->freeInstance                    = (fmi3FreeInstanceTYPE *)                    fmi3FreeInstance;
+    fmu->enterInitializationMode         = (fmi3EnterInitializationModeTYPE *)         fmi3EnterInitializationMode;
+    fmu->exitInitializationMode          = (fmi3ExitInitializationModeTYPE *)          fmi3ExitInitializationMode;
+    fmu->enterEventMode                  = (fmi3EnterEventModeTYPE *)                  fmi3EnterEventMode;
+    fmu->terminate                       = (fmi3TerminateTYPE *)                       fmi3Terminate;
+    fmu->reset                           = (fmi3ResetTYPE *)                           fmi3Reset;
+    fmu->getFloat32                      = (fmi3GetFloat32TYPE *)                      fmi3GetFloat32;
+    fmu->getFloat64                      = (fmi3GetFloat64TYPE *)                      fmi3GetFloat64;
+    fmu->getInt8                         = (fmi3GetInt8TYPE *)                         fmi3GetInt8;
+    fmu->getUInt8                        = (fmi3GetUInt8TYPE *)                        fmi3GetUInt8;
+    fmu->getInt16                        = (fmi3GetInt16TYPE *)                        fmi3GetInt16;
+    fmu->getUInt16                       = (fmi3GetUInt16TYPE *)                       fmi3GetUInt16;
+    fmu->getInt32                        = (fmi3GetInt32TYPE *)                        fmi3GetInt32;
+    fmu->getUInt32                       = (fmi3GetUInt32TYPE *)                       fmi3GetUInt32;
+    fmu->getInt64                        = (fmi3GetInt64TYPE *)                        fmi3GetInt64;
+    fmu->getUInt64                       = (fmi3GetUInt64TYPE *)                       fmi3GetUInt64;
+    fmu->getBoolean                      = (fmi3GetBooleanTYPE *)                      fmi3GetBoolean;
+    fmu->getString                       = (fmi3GetStringTYPE *)                       fmi3GetString;
+    fmu->getBinary                       = (fmi3GetBinaryTYPE *)                       fmi3GetBinary;
+    fmu->getClock                        = (fmi3GetClockTYPE *)                        fmi3GetClock;
+    fmu->setFloat32                      = (fmi3SetFloat32TYPE *)                      fmi3SetFloat32;
+    fmu->setFloat64                      = (fmi3SetFloat64TYPE *)                      fmi3SetFloat64;
+    fmu->setInt8                         = (fmi3SetInt8TYPE *)                         fmi3SetInt8;
+    fmu->setUInt8                        = (fmi3SetUInt8TYPE *)                        fmi3SetUInt8;
+    fmu->setInt16                        = (fmi3SetInt16TYPE *)                        fmi3SetInt16;
+    fmu->setUInt16                       = (fmi3SetUInt16TYPE *)                       fmi3SetUInt16;
+    fmu->setInt32                        = (fmi3SetInt32TYPE *)                        fmi3SetInt32;
+    fmu->setUInt32                       = (fmi3SetUInt32TYPE *)                       fmi3SetUInt32;
+    fmu->setInt64                        = (fmi3SetInt64TYPE *)                        fmi3SetInt64;
+    fmu->setUInt64                       = (fmi3SetUInt64TYPE *)                       fmi3SetUInt64;
+    fmu->setBoolean                      = (fmi3SetBooleanTYPE *)                      fmi3SetBoolean;
+    fmu->setString                       = (fmi3SetStringTYPE *)                       fmi3SetString;
+    fmu->setBinary                       = (fmi3SetBinaryTYPE *)                       fmi3SetBinary;
+    fmu->setClock                        = (fmi3SetClockTYPE *)                        fmi3SetClock;
+    fmu->getNumberOfVariableDependencies = (fmi3GetNumberOfVariableDependenciesTYPE *) fmi3GetNumberOfVariableDependencies;
+    fmu->getVariableDependencies         = (fmi3GetVariableDependenciesTYPE *)         fmi3GetVariableDependencies;
+    fmu->getFMUState                     = (fmi3GetFMUStateTYPE *)                     fmi3GetFMUState;
+    fmu->setFMUState                     = (fmi3SetFMUStateTYPE *)                     fmi3SetFMUState;
+    fmu->freeFMUState                    = (fmi3FreeFMUStateTYPE *)                    fmi3FreeFMUState;
+    fmu->serializedFMUStateSize          = (fmi3SerializedFMUStateSizeTYPE *)          fmi3SerializedFMUStateSize;
+    fmu->serializeFMUState               = (fmi3SerializeFMUStateTYPE *)               fmi3SerializeFMUState;
+    fmu->deserializeFMUState             = (fmi3DeserializeFMUStateTYPE *)             fmi3DeserializeFMUState;
+    fmu->getDirectionalDerivative        = (fmi3GetDirectionalDerivativeTYPE *)        fmi3GetDirectionalDerivative;
+    fmu->getAdjointDerivative            = (fmi3GetAdjointDerivativeTYPE *)            fmi3GetAdjointDerivative;
+    fmu->enterConfigurationMode          = (fmi3EnterConfigurationModeTYPE *)          fmi3EnterConfigurationMode;
+    fmu->exitConfigurationMode           = (fmi3ExitConfigurationModeTYPE *)           fmi3ExitConfigurationMode;
+    fmu->getIntervalDecimal              = (fmi3GetIntervalDecimalTYPE *)              fmi3GetIntervalDecimal;
+    fmu->getIntervalFraction             = (fmi3GetIntervalFractionTYPE *)             fmi3GetIntervalFraction;
+    fmu->getShiftDecimal                 = (fmi3GetShiftDecimalTYPE *)                 fmi3GetShiftDecimal;
+    fmu->getShiftFraction                = (fmi3GetShiftFractionTYPE *)                fmi3GetShiftFraction;
+    fmu->setIntervalDecimal              = (fmi3SetIntervalDecimalTYPE *)              fmi3SetIntervalDecimal;
+    fmu->setIntervalFraction             = (fmi3SetIntervalFractionTYPE *)             fmi3SetIntervalFraction;
+    fmu->setShiftDecimal                 = (fmi3SetShiftDecimalTYPE *)                 fmi3SetShiftDecimal;
+    fmu->setShiftFraction                = (fmi3SetShiftFractionTYPE *)                fmi3SetShiftFraction;
+    fmu->evaluateDiscreteStates          = (fmi3EvaluateDiscreteStatesTYPE *)          fmi3EvaluateDiscreteStates;
+    fmu->updateDiscreteStates            = (fmi3UpdateDiscreteStatesTYPE *)            fmi3UpdateDiscreteStates;
+#ifdef FMI_COSIMULATION
+    fmu->instantiateCoSimulation = (fmi3InstantiateCoSimulationTYPE *) fmi3InstantiateCoSimulation;
+    fmu->enterStepMode           = (fmi3EnterStepModeTYPE *)           fmi3EnterStepMode;
+    fmu->getOutputDerivatives    = (fmi3GetOutputDerivativesTYPE *)    fmi3GetOutputDerivatives;
+    fmu->doStep                  = (fmi3DoStepTYPE *)                  fmi3DoStep;
+#else // FMI3 for Model Exchange
+    fmu->instantiateModelExchange      = (fmi3InstantiateModelExchangeTYPE *)      fmi3InstantiateModelExchange;
+    fmu->enterContinuousTimeMode       = (fmi3EnterContinuousTimeModeTYPE *)       fmi3EnterContinuousTimeMode;
+    fmu->completedIntegratorStep       = (fmi3CompletedIntegratorStepTYPE *)       fmi3CompletedIntegratorStep;
+    fmu->setTime                       = (fmi3SetTimeTYPE *)                       fmi3SetTime;
+    fmu->setContinuousStates           = (fmi3SetContinuousStatesTYPE *)           fmi3SetContinuousStates;
+    fmu->getContinuousStateDerivatives = (fmi3GetContinuousStateDerivativesTYPE *) fmi3GetContinuousStateDerivatives;
+    fmu->getEventIndicators            = (fmi3GetEventIndicatorsTYPE *)            fmi3GetEventIndicators;
+    fmu->getContinuousStates           = (fmi3GetContinuousStatesTYPE *)           fmi3GetContinuousStates;
+    fmu->getNominalsOfContinuousStates = (fmi3GetNominalsOfContinuousStatesTYPE *) fmi3GetNominalsOfContinuousStates;
+    fmu->getNumberOfEventIndicators    = (fmi3GetNumberOfEventIndicatorsTYPE *)    fmi3GetNumberOfEventIndicators;
+    fmu->getNumberOfContinuousStates   = (fmi3GetNumberOfContinuousStatesTYPE *)   fmi3GetNumberOfContinuousStates;
+#endif
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,471 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <complex.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "headers/fmi2TypesPlatform.h"
+#include "headers/fmi2FunctionTypes.h"
+#include "headers/fmi2Functions.h"
+
+#define MULTISINE_AMPLITUDE 1e-2     // peak of the excitation, relative to max(|u0|, 1)
+
+typedef enum {
+    FREQUENCY_LINEAR,                // transfer functions of the linearization
+    FREQUENCY_MULTISINE              // simulations excited by multi-sines, analysed by FFT
+} FrequencyMethod;
+
+struct FrequencyResponse;
+
+/**
+ * @brief Simulates the model with one input excited by a multi-sine, the other inputs held.
+ *
+ * Over the second period of the excitation, the deviation of the input from its start value
+ * and the Real outputs are sampled at every step.
+ *
+ * @param context The context given to the frequency response.
+ * @param response The frequency response, for multisineSample.
+ * @param input The excited input, index in FrequencyResponse::inputs.
+ * @param group The frequencies of the excitation, see multisineSample.
+ * @param u The nSamples input deviations.
+ * @param y The nSamples rows of ny outputs.
+ * @return fmi2Status The worst status of the simulation.
+ */
+typedef fmi2Status (*ExcitationFunction)(void *context, const struct FrequencyResponse *response,
+                                         int input, int group, double *u, double *y);
+
+/**
+ * @struct FrequencyResponse
+ * @brief Frequency responses from the Real inputs to the Real outputs on a logarithmic grid.
+ *
+ * With the linearization, G(jw) = C (jwI - A)^-1 B + D is evaluated at each operating point:
+ * A is reduced once to Hessenberg form, so that each frequency costs a complex Hessenberg
+ * solve for all the inputs at once instead of a full factorization.
+ *
+ * With multi-sines, the grid is rounded to the bins of an FFT over nSamples steps. The bins are
+ * split in groups, each simulation excites one input with the bins of one group at once, and
+ * all the simulations run in parallel. G is the ratio of the FFTs of the outputs and the input
+ * over the second period, the first one letting the transient die out.
+ */
+typedef struct FrequencyResponse {
+    double *frequencies;             // requested frequencies in Hz, increasing
+    int nFrequencies;
+    int method;                      // FrequencyMethod
+    const char *output;              // result file of the multi-sine method
+    int *inputs;                     // variable index of each Real input
+    int nu;
+    int *outputs;                    // variable index of each Real output
+    int ny;
+    double h;                        // step of the multi-sine simulations
+    int nSamples;                    // steps per period, a power of two
+    int *bins;                       // excited FFT bins, increasing
+    int nBins;
+    int nGroups;                     // bin b is excited in group b % nGroups
+    double *excitation;              // one period per group, unit peak
+    ExcitationFunction simulate;
+    void *context;
+    int maxThreads;
+} FrequencyResponse;
+
+/**
+ * @brief Parses a logarithmic frequency grid "fmin,fmax,n" in Hz.
+ *
+ * @return 0 on success, -1 if the grid is invalid or memory is exhausted.
+ */
+int setFrequencyGrid(FrequencyResponse *response, const char *grid) {
+    double fMin, fMax;
+    int n;
+    char extra;
+    if (sscanf(grid, "%lf,%lf,%d%c", &fMin, &fMax, &n, &extra) != 3 ||
+        fMin <= 0 || fMax < fMin || n < 1 || (n == 1 && fMax != fMin)) return -1;
+
+    double *frequencies = (double*)realloc(response->frequencies, n * sizeof(double));
+    if (!frequencies) return -1;
+    response->frequencies = frequencies;
+    response->nFrequencies = n;
+    for (int k = 0; k < n; k++) {
+        response->frequencies[k] = n == 1 ? fMin : fMin * pow(fMax / fMin, (double)k / (n - 1));
+    }
+    return 0;
+}
+
+/**
+ * @brief Frees the memory held by the frequency response.
+ */
+void freeFrequencyResponse(FrequencyResponse *response) {
+    free(response->frequencies);
+    free(response->inputs);
+    free(response->outputs);
+    free(response->bins);
+    free(response->excitation);
+    memset(response, 0, sizeof(FrequencyResponse));
+}
+
+/**
+ * @brief Collects the Real inputs and outputs and, for multi-sines, builds the excitations.
+ *
+ * The period is the smallest power of two of steps h covering the lowest frequency, the
+ * frequencies above the Nyquist frequency are dropped. The phases of each group follow
+ * Schroeder, which keeps the peak of the sum low.
+ *
+ * @return 0 on success, -1 if the model has no Real input or output, or memory is exhausted.
+ */
+int initFrequencyResponse(FrequencyResponse *response, const ScalarVariable *variables, int nVariables, double h) {
+    response->inputs = (int*)malloc((nVariables + 1) * sizeof(int));
+    response->outputs = (int*)malloc((NOUTPUTS + 1) * sizeof(int));
+    if (!response->inputs || !response->outputs) return -1;
+    for (int i = 0; i < nVariables; i++) {
+        if (variables[i].causality == INPUT && variables[i].type == REAL) response->inputs[response->nu++] = i;
+    }
+    for (int k = 0; k < NOUTPUTS; k++) {
+        if (variables[model_outputs[k].variable].type == REAL) response->outputs[response->ny++] = model_outputs[k].variable;
+    }
+    if (response->nu == 0 || response->ny == 0) {
+        printf("The frequency response needs Real inputs and outputs\n");
+        return -1;
+    }
+    // A model instantiated only once per process runs the multi-sine simulations one after the other
+    long nProcessors = sysconf(_SC_NPROCESSORS_ONLN);
+    response->maxThreads = nProcessors > 0 && !model.canBeInstantiatedOnlyOncePerProcess ? (int)nProcessors : 1;
+    if (response->method != FREQUENCY_MULTISINE) return 0;
+
+    response->h = h;
+    response->nSamples = 2;
+    while (response->nSamples * h * response->frequencies[0] < 1.0 - 1e-9) response->nSamples *= 2;
+    double f0 = 1.0 / (response->nSamples * h);
+
+    response->bins = (int*)malloc(response->nFrequencies * sizeof(int));
+    if (!response->bins) return -1;
+    for (int k = 0; k < response->nFrequencies; k++) {
+        int bin = (int)lround(response->frequencies[k] / f0);
+        if (bin < 1) bin = 1;
+        if (bin >= response->nSamples / 2) {
+            printf("Frequencies above %g Hz are dropped, the Nyquist frequency of the step\n", 0.5 / h);
+            break;
+        }
+        if (response->nBins == 0 || bin > response->bins[response->nBins - 1]) response->bins[response->nBins++] = bin;
+    }
+    if (response->nBins == 0) return -1;
+
+    // Enough groups to give each processor a simulation
+    response->nGroups = response->maxThreads / response->nu;
+    if (response->nGroups < 1) response->nGroups = 1;
+    if (response->nGroups > response->nBins) response->nGroups = response->nBins;
+
+    int N = response->nSamples;
+    response->excitation = (double*)calloc((size_t)response->nGroups * N, sizeof(double));
+    if (!response->excitation) return -1;
+    for (int g = 0; g < response->nGroups; g++) {
+        double *excitation = response->excitation + (size_t)g * N;
+        int K = (response->nBins - g + response->nGroups - 1) / response->nGroups, k = 0;
+        for (int b = g; b < response->nBins; b += response->nGroups, k++) {
+            double phase = -M_PI * k * (k + 1) / K;
+            for (int n = 0; n < N; n++) {
+                excitation[n] += cos(2 * M_PI * (double)response->bins[b] * n / N + phase);
+            }
+        }
+        double peak = 0;
+        for (int n = 0; n < N; n++) peak = fmax(peak, fabs(excitation[n]));
+        for (int n = 0; n < N; n++) excitation[n] /= peak;
+    }
+    return 0;
+}
+
+/**
+ * @brief Value of the multi-sine of a group at step n, around the start value u0 of the input.
+ */
+double multisineSample(const FrequencyResponse *response, int group, int n, double u0) {
+    double peak = MULTISINE_AMPLITUDE * fmax(fabs(u0), 1.0);
+    return u0 + peak * response->excitation[(size_t)group * response->nSamples + n % response->nSamples];
+}
+
+// Writes the header of a response file: for each output and input, gain in dB and phase in degrees
+static void writeResponseHeader(FILE *file, const int *inputs, int nu, const int *outputs, int ny) {
+    fprintf(file, "frequency");
+    for (int i = 0; i < ny; i++) {
+        for (int j = 0; j < nu; j++) {
+            fprintf(file, ",dB(%s/%s),deg(%s/%s)", variable_names[outputs[i]], variable_names[inputs[j]],
+                    variable_names[outputs[i]], variable_names[inputs[j]]);
+        }
+    }
+    fprintf(file, "\n");
+}
+
+// Writes a row of the response, G holds ny rows of nu values
+static void writeResponseRow(FILE *file, double frequency, const double complex *G, int nu, int ny) {
+    fprintf(file, "%.17g", frequency);
+    for (int k = 0; k < ny * nu; k++) {
+        fprintf(file, ",%.10g,%.10g", 20 * log10(cabs(G[k])), carg(G[k]) * 180 / M_PI);
+    }
+    fprintf(file, "\n");
+}
+
+/**
+ * @brief Reduces A to Hessenberg form H = Q^T A Q by Householder reflections, with B = Q^T B
+ * and C = C Q, which leaves the transfer function unchanged. All the matrices are row-major.
+ */
+static void hessenbergReduce(int n, double *A, int nu, double *B, int ny, double *C, double *v) {
+    for (int k = 0; k + 2 < n; k++) {
+        double norm = 0;
+        for (int i = k + 1; i < n; i++) norm += A[i * n + k] * A[i * n + k];
+        norm = sqrt(norm);
+        if (norm == 0) continue;
+        double alpha = A[(k + 1) * n + k] > 0 ? -norm : norm, length = 0;
+        for (int i = k + 1; i < n; i++) v[i] = A[i * n + k];
+        v[k + 1] -= alpha;
+        for (int i = k + 1; i < n; i++) length += v[i] * v[i];
+        length = sqrt(length);
+        if (length == 0) continue;
+        for (int i = k + 1; i < n; i++) v[i] /= length;
+
+        // Rows of A and B: M -= 2 v (v^T M)
+        for (int j = 0; j < n; j++) {
+            double dot = 0;
+            for (int i = k + 1; i < n; i++) dot += v[i] * A[i * n + j];
+            for (int i = k + 1; i < n; i++) A[i * n + j] -= 2 * v[i] * dot;
+        }
+        for (int j = 0; j < nu; j++) {
+            double dot = 0;
+            for (int i = k + 1; i < n; i++) dot += v[i] * B[i * nu + j];
+            for (int i = k + 1; i < n; i++) B[i * nu + j] -= 2 * v[i] * dot;
+        }
+        // Columns of A and C: M -= 2 (M v) v^T
+        for (int i = 0; i < n; i++) {
+            double dot = 0;
+            for (int j = k + 1; j < n; j++) dot += A[i * n + j] * v[j];
+            for (int j = k + 1; j < n; j++) A[i * n + j] -= 2 * dot * v[j];
+        }
+        for (int i = 0; i < ny; i++) {
+            double dot = 0;
+            for (int j = k + 1; j < n; j++) dot += C[i * n + j] * v[j];
+            for (int j = k + 1; j < n; j++) C[i * n + j] -= 2 * dot * v[j];
+        }
+    }
+}
+
+/**
+ * @brief Solves (jw I - H) X = B for the nu columns of X at once, H being upper Hessenberg.
+ *
+ * Only the subdiagonal has to be eliminated, with partial pivoting between neighbouring rows,
+ * so the solve costs O(n^2 nu).
+ *
+ * @param M Work matrix of n * n values.
+ * @param X On entry B, on exit X, n rows of nu values.
+ * @return 0 on success, -1 if jw is an eigenvalue of H.
+ */
+static int solveShiftedHessenberg(int n, const double *H, double omega, int nu, double complex *M, double complex *X) {
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) M[i * n + j] = (i == j ? I * omega : 0) - H[i * n + j];
+    }
+    for (int k = 0; k < n; k++) {
+        if (k + 1 < n && cabs(M[(k + 1) * n + k]) > cabs(M[k * n + k])) {
+            for (int j = k; j < n; j++) {
+                double complex t = M[k * n + j]; M[k * n + j] = M[(k + 1) * n + j]; M[(k + 1) * n + j] = t;
+            }
+            for (int j = 0; j < nu; j++) {
+                double complex t = X[k * nu + j]; X[k * nu + j] = X[(k + 1) * nu + j]; X[(k + 1) * nu + j] = t;
+            }
+        }
+        if (M[k * n + k] == 0) return -1;
+        if (k + 1 < n && M[(k + 1) * n + k] != 0) {
+            double complex l = M[(k + 1) * n + k] / M[k * n + k];
+            for (int j = k + 1; j < n; j++) M[(k + 1) * n + j] -= l * M[k * n + j];
+            for (int j = 0; j < nu; j++) X[(k + 1) * nu + j] -= l * X[k * nu + j];
+        }
+    }
+    for (int k = n - 1; k >= 0; k--) {
+        for (int j = 0; j < nu; j++) {
+            double complex sum = X[k * nu + j];
+            for (int c = k + 1; c < n; c++) sum -= M[k * n + c] * X[c * nu + j];
+            X[k * nu + j] = sum / M[k * n + k];
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Writes the transfer functions of a linearization over the frequency grid.
+ *
+ * @param path The result file.
+ * @param response The frequency response, for its grid.
+ * @param J The dense Jacobian [A B; C D], rows the nx derivatives then the ny outputs, columns
+ *          the nx states then the nu inputs.
+ * @param inputs Variable index of each input.
+ * @param outputs Variable index of each output.
+ * @return 0 on success, -1 if the file cannot be written or memory is exhausted.
+ */
+int writeTransferFunctions(const char *path, const FrequencyResponse *response, int nx, int nu, int ny,
+                           const double *J, const int *inputs, const int *outputs) {
+    int nColumns = nx + nu;
+    double *A = (double*)malloc(((size_t)nx * nx + 1) * sizeof(double));
+    double *B = (double*)malloc(((size_t)nx * nu + 1) * sizeof(double));
+    double *C = (double*)malloc(((size_t)ny * nx + 1) * sizeof(double));
+    double *v = (double*)malloc((nx + 1) * sizeof(double));
+    double complex *M = (double complex*)malloc(((size_t)nx * nx + 1) * sizeof(double complex));
+    double complex *X = (double complex*)malloc(((size_t)nx * nu + 1) * sizeof(double complex));
+    double complex *G = (double complex*)malloc(((size_t)ny * nu + 1) * sizeof(double complex));
+    FILE *file = NULL;
+    int result = -1;
+
+    if (!A || !B || !C || !v || !M || !X || !G) goto done;
+    for (int i = 0; i < nx; i++) {
+        memcpy(A + (size_t)i * nx, J + (size_t)i * nColumns, nx * sizeof(double));
+        memcpy(B + (size_t)i * nu, J + (size_t)i * nColumns + nx, nu * sizeof(double));
+    }
+    for (int i = 0; i < ny; i++) memcpy(C + (size_t)i * nx, J + (size_t)(nx + i) * nColumns, nx * sizeof(double));
+    hessenbergReduce(nx, A, nu, B, ny, C, v);
+
+    file = fopen(path, "w");
+    if (!file) {
+        printf("Could not open %s\n", path);
+        goto done;
+    }
+    writeResponseHeader(file, inputs, nu, outputs, ny);
+    for (int f = 0; f < response->nFrequencies; f++) {
+        for (int k = 0; k < nx * nu; k++) X[k] = B[k];
+        if (solveShiftedHessenberg(nx, A, 2 * M_PI * response->frequencies[f], nu, M, X) != 0) {
+            printf("Pole of the linearization at %g Hz\n", response->frequencies[f]);
+            continue;
+        }
+        for (int i = 0; i < ny; i++) {
+            for (int j = 0; j < nu; j++) {
+                double complex sum = J[(size_t)(nx + i) * nColumns + nx + j];
+                for (int k = 0; k < nx; k++) sum += C[i * nx + k] * X[k * nu + j];
+                G[i * nu + j] = sum;
+            }
+        }
+        writeResponseRow(file, response->frequencies[f], G, nu, ny);
+    }
+    result = ferror(file) ? -1 : 0;
+
+done:
+    if (file && fclose(file) != 0) result = -1;
+    if (result != 0 && file) printf("Could not write %s\n", path);
+    free(A);
+    free(B);
+    free(C);
+    free(v);
+    free(M);
+    free(X);
+    free(G);
+    return result;
+}
+
+// In-place radix-2 FFT, n a power of two
+static void fft(double complex *x, int n) {
+    for (int i = 1, j = 0; i < n; i++) {
+        int bit = n >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+        if (i < j) {
+            double complex t = x[i]; x[i] = x[j]; x[j] = t;
+        }
+    }
+    for (int length = 2; length <= n; length <<= 1) {
+        double complex w = cexp(-2 * I * M_PI / length);
+        for (int i = 0; i < n; i += length) {
+            double complex wk = 1;
+            for (int k = 0; k < length / 2; k++) {
+                double complex a = x[i + k], b = x[i + k + length / 2] * wk;
+                x[i + k] = a + b;
+                x[i + k + length / 2] = a - b;
+                wk *= w;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Job shared by the threads running the multi-sine simulations.
+ */
+typedef struct {
+    const FrequencyResponse *response;
+    double complex *G;               // nBins blocks of ny rows of nu values
+    int next;                        // next simulation, input * nGroups + group
+    fmi2Status status;
+    pthread_mutex_t lock;
+} MultisineBatch;
+
+static void *multisineWorker(void *arg) {
+    MultisineBatch *batch = (MultisineBatch*)arg;
+    const FrequencyResponse *response = batch->response;
+    int N = response->nSamples, nu = response->nu, ny = response->ny;
+    double *u = (double*)malloc(N * sizeof(double));
+    double *y = (double*)malloc((size_t)N * ny * sizeof(double));
+    double complex *U = (double complex*)malloc(N * sizeof(double complex));
+    double complex *Y = (double complex*)malloc(N * sizeof(double complex));
+
+    for (;;) {
+        pthread_mutex_lock(&batch->lock);
+        int k = batch->next++;
+        pthread_mutex_unlock(&batch->lock);
+        if (k >= nu * response->nGroups) break;
+        int input = k / response->nGroups, group = k % response->nGroups;
+
+        fmi2Status status = (!u || !y || !U || !Y) ? fmi2Error
+                            : response->simulate(response->context, response, input, group, u, y);
+        if (status <= fmi2Warning) {
+            for (int n = 0; n < N; n++) U[n] = u[n];
+            fft(U, N);
+            for (int i = 0; i < ny; i++) {
+                for (int n = 0; n < N; n++) Y[n] = y[(size_t)n * ny + i];
+                fft(Y, N);
+                for (int b = group; b < response->nBins; b += response->nGroups) {
+                    batch->G[((size_t)b * ny + i) * nu + input] = Y[response->bins[b]] / U[response->bins[b]];
+                }
+            }
+        }
+
+        pthread_mutex_lock(&batch->lock);
+        if (status > batch->status) batch->status = status;
+        pthread_mutex_unlock(&batch->lock);
+    }
+
+    free(u);
+    free(y);
+    free(U);
+    free(Y);
+    return NULL;
+}
+
+/**
+ * @brief Runs the multi-sine simulations in parallel and writes the estimated responses.
+ *
+ * @return fmi2Status The worst status of the simulations, fmi2Error if the file cannot be
+ *         written or memory is exhausted.
+ */
+fmi2Status runMultisine(FrequencyResponse *response) {
+    MultisineBatch batch = {response, NULL, 0, fmi2OK};
+    batch.G = (double complex*)calloc((size_t)response->nBins * response->ny * response->nu + 1, sizeof(double complex));
+    if (!batch.G) return fmi2Error;
+
+    pthread_t threads[64];
+    int nThreads = min(min(response->nu * response->nGroups, response->maxThreads), 64), started = 0;
+    pthread_mutex_init(&batch.lock, NULL);
+    for (int t = 1; t < nThreads; t++) {
+        if (pthread_create(&threads[started], NULL, multisineWorker, &batch) == 0) started++;
+    }
+    multisineWorker(&batch);
+    for (int t = 0; t < started; t++) pthread_join(threads[t], NULL);
+    pthread_mutex_destroy(&batch.lock);
+
+    FILE *file = batch.status <= fmi2Warning ? fopen(response->output, "w") : NULL;
+    if (batch.status <= fmi2Warning) {
+        if (file) {
+            double f0 = 1.0 / (response->nSamples * response->h);
+            writeResponseHeader(file, response->inputs, response->nu, response->outputs, response->ny);
+            for (int b = 0; b < response->nBins; b++) {
+                writeResponseRow(file, response->bins[b] * f0, batch.G + (size_t)b * response->ny * response->nu,
+                                 response->nu, response->ny);
+            }
+        }
+        int failed = !file || ferror(file);
+        if ((file && fclose(file) != 0) || failed) {
+            printf("Could not write %s\n", response->output);
+            batch.status = fmi2Error;
+        }
+    }
+    free(batch.G);
+    return batch.status;
+}
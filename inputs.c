@@ -0,0 +1,287 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "headers/fmi2TypesPlatform.h"
+#include "headers/fmi2FunctionTypes.h"
+#include "headers/fmi2Functions.h"
+
+#define INPUT_MAGIC "FMUINPUT"
+#define MAX_INPUT_LINE_SIZE 65536
+
+typedef enum {
+    INPUT_LINEAR,                    // linear interpolation between the samples
+    INPUT_HOLD                       // zero-order hold, each sample time is a time event
+} InputInterpolation;
+
+/**
+ * @struct Inputs
+ * @brief Time series of Real inputs, one row per sample: the time then one value per column.
+ *
+ * CSV files are parsed into memory. Binary files are mapped and read in place, so that millions
+ * of samples cost neither a parse nor a copy. Their layout is the 8 bytes "FMUINPUT", the number
+ * of columns and the number of rows as uint64, the '\0' terminated column names padded with
+ * '\0' to a multiple of 8 bytes, then the rows of native doubles. The first column is the time.
+ */
+typedef struct {
+    const double *data;              // nRows rows of nColumns doubles
+    size_t nRows;
+    int nColumns;
+    int *columns;                    // column of each input
+    int *variables;                  // variable index of each input
+    fmi2ValueReference *vrs;
+    int nInputs;
+    int interpolation;               // InputInterpolation
+    double *parsed;                  // data of a CSV file, NULL if mapped
+    void *map;                       // mapping of a binary file
+    size_t mapSize;
+} Inputs;
+
+/**
+ * @struct InputCursor
+ * @brief Position of an instance in the input series: data[row] <= t < data[row + 1].
+ *
+ * Time only moves forward during a simulation, so the cursor advances by a few rows per step
+ * and the interpolation costs O(1) amortized. A step back, when a state is restored, costs a
+ * binary search.
+ */
+typedef struct {
+    size_t row;
+    double *values;                  // one value per input, set by a single setReal
+} InputCursor;
+
+// Maps a column name to a Real input, -1 if there is none
+static int mapInputColumn(Inputs *inputs, const char *name, int column, const ScalarVariable *variables) {
+    int i = get_variable_index(name);
+    if (i < 0 || variables[i].causality != INPUT || variables[i].type != REAL) {
+        printf("Input column '%s' is not a Real input of the model\n", name);
+        return -1;
+    }
+    inputs->columns[inputs->nInputs] = column;
+    inputs->variables[inputs->nInputs] = i;
+    inputs->vrs[inputs->nInputs++] = variables[i].valueReference;
+    return 0;
+}
+
+static int allocateInputColumns(Inputs *inputs) {
+    inputs->columns = (int*)malloc(inputs->nColumns * sizeof(int));
+    inputs->variables = (int*)malloc(inputs->nColumns * sizeof(int));
+    inputs->vrs = (fmi2ValueReference*)malloc(inputs->nColumns * sizeof(fmi2ValueReference));
+    return inputs->columns && inputs->variables && inputs->vrs ? 0 : -1;
+}
+
+// Maps a binary input file and checks its header
+static int mapInputFile(Inputs *inputs, const char *path, const ScalarVariable *variables) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        printf("Could not open %s\n", path);
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    inputs->mapSize = (size_t)st.st_size;
+    inputs->map = inputs->mapSize > 0 ? mmap(NULL, inputs->mapSize, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (inputs->map == MAP_FAILED) {
+        inputs->map = NULL;
+        printf("Could not map %s\n", path);
+        return -1;
+    }
+
+    const char *bytes = (const char*)inputs->map;
+    uint64_t header[2];
+    if (inputs->mapSize < 24) return -1;
+    memcpy(header, bytes + 8, sizeof(header));
+    if (header[0] < 2 || header[0] > INT32_MAX) return -1;
+    inputs->nColumns = (int)header[0];
+    inputs->nRows = (size_t)header[1];
+    if (allocateInputColumns(inputs) != 0) return -1;
+
+    size_t offset = 24;
+    for (int c = 0; c < inputs->nColumns; c++) {
+        const char *name = bytes + offset;
+        const char *end = (const char*)memchr(name, '\0', inputs->mapSize - offset);
+        if (!end) return -1;
+        if (c > 0 && mapInputColumn(inputs, name, c, variables) != 0) return -1;
+        offset = (size_t)(end - bytes) + 1;
+        if (offset >= inputs->mapSize) return -1;
+    }
+    // The row count comes from the file, the size of the data must not overflow
+    offset = (offset + 7) & ~(size_t)7;
+    size_t rowSize = inputs->nColumns * sizeof(double);
+    if (offset > inputs->mapSize || inputs->nColumns == 0 || inputs->nRows > (inputs->mapSize - offset) / rowSize) {
+        printf("Truncated input file %s\n", path);
+        return -1;
+    }
+    inputs->data = (const double*)(bytes + offset);
+
+    // Samples are read in increasing order, let the kernel read ahead
+    madvise(inputs->map, inputs->mapSize, MADV_SEQUENTIAL);
+    return 0;
+}
+
+// Parses a CSV input file: a header of names, then one row of numbers per sample
+static int parseInputFile(Inputs *inputs, const char *path, const ScalarVariable *variables) {
+    FILE *file = fopen(path, "r");
+    char *line = (char*)malloc(MAX_INPUT_LINE_SIZE);
+    int result = -1;
+    if (!file || !line || !fgets(line, MAX_INPUT_LINE_SIZE, file)) {
+        printf("Could not read %s\n", path);
+        goto done;
+    }
+
+    char sep = line[strcspn(line, ",;\t")];
+    if (sep == '\0') sep = ',';
+    line[strcspn(line, "\r\n")] = '\0';
+    inputs->nColumns = 1;
+    for (char *p = line; *p; p++) inputs->nColumns += *p == sep;
+    if (inputs->nColumns < 2 || allocateInputColumns(inputs) != 0) goto done;
+
+    char *name = strchr(line, sep);
+    for (int c = 1; name; c++) {
+        char *next = strchr(++name, sep);
+        if (next) *next = '\0';
+        while (*name == ' ' || *name == '"') name++;
+        size_t length = strlen(name);
+        while (length > 0 && (name[length - 1] == ' ' || name[length - 1] == '"')) name[--length] = '\0';
+        if (mapInputColumn(inputs, name, c, variables) != 0) goto done;
+        name = next;
+    }
+
+    size_t capacity = 0;
+    while (fgets(line, MAX_INPUT_LINE_SIZE, file)) {
+        if (line[0] == '\n' || line[0] == '\r' || line[0] == '#') continue;
+        if (inputs->nRows == capacity) {
+            capacity = capacity ? 2 * capacity : 1024;
+            double *parsed = (double*)realloc(inputs->parsed, capacity * inputs->nColumns * sizeof(double));
+            if (!parsed) goto done;
+            inputs->parsed = parsed;
+        }
+        double *row = inputs->parsed + inputs->nRows * inputs->nColumns;
+        char *p = line, *end;
+        for (int c = 0; c < inputs->nColumns; c++) {
+            row[c] = strtod(p, &end);
+            if (end == p) {
+                printf("Invalid value in %s, row %zu\n", path, inputs->nRows + 1);
+                goto done;
+            }
+            p = end;
+            while (*p == ' ') p++;
+            if (*p == sep) p++;
+        }
+        inputs->nRows++;
+    }
+    inputs->data = inputs->parsed;
+    result = 0;
+
+done:
+    if (file) fclose(file);
+    free(line);
+    return result;
+}
+
+/**
+ * @brief Loads the input series of a CSV file, or of a binary file starting with "FMUINPUT".
+ *
+ * The columns after the time are mapped by name to the Real inputs of the model.
+ *
+ * @return 0 on success, -1 if the file is invalid, its times decrease, or memory is exhausted.
+ */
+int loadInputs(Inputs *inputs, const char *path, const ScalarVariable *variables) {
+    char magic[8] = {0};
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        printf("Could not open %s\n", path);
+        return -1;
+    }
+    size_t n = fread(magic, 1, sizeof(magic), file);
+    fclose(file);
+
+    int result = n == sizeof(magic) && memcmp(magic, INPUT_MAGIC, sizeof(magic)) == 0
+                 ? mapInputFile(inputs, path, variables)
+                 : parseInputFile(inputs, path, variables);
+    if (result != 0 || inputs->nRows == 0) {
+        printf("Invalid input file %s\n", path);
+        return -1;
+    }
+    for (size_t k = 1; k < inputs->nRows; k++) {
+        if (inputs->data[k * inputs->nColumns] < inputs->data[(k - 1) * inputs->nColumns]) {
+            printf("Decreasing time in %s, row %zu\n", path, k + 1);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Frees the series, or unmaps the file.
+ */
+void freeInputs(Inputs *inputs) {
+    if (inputs->map) munmap(inputs->map, inputs->mapSize);
+    free(inputs->parsed);
+    free(inputs->columns);
+    free(inputs->variables);
+    free(inputs->vrs);
+    memset(inputs, 0, sizeof(Inputs));
+}
+
+// Moves the cursor to the last row at or before t, row 0 if t is before the first sample
+static void seekInputs(const Inputs *inputs, InputCursor *cursor, double t) {
+    const double *data = inputs->data;
+    size_t stride = inputs->nColumns;
+    if (cursor->row >= inputs->nRows || data[cursor->row * stride] > t) {
+        size_t low = 0, high = inputs->nRows;
+        while (high - low > 1) {
+            size_t middle = low + (high - low) / 2;
+            if (data[middle * stride] <= t) low = middle; else high = middle;
+        }
+        cursor->row = low;
+    }
+    while (cursor->row + 1 < inputs->nRows && data[(cursor->row + 1) * stride] <= t) cursor->row++;
+}
+
+/**
+ * @brief Time of the first sample after t, a time event of the held inputs.
+ *
+ * @return The breakpoint, or INFINITY if the inputs are interpolated or there is none.
+ */
+double nextInputBreakpoint(const Inputs *inputs, InputCursor *cursor, double t) {
+    if (inputs->interpolation != INPUT_HOLD) return INFINITY;
+    seekInputs(inputs, cursor, t);
+    size_t row = cursor->row;
+    while (row < inputs->nRows && inputs->data[row * inputs->nColumns] <= t) row++;
+    return row < inputs->nRows ? inputs->data[row * inputs->nColumns] : INFINITY;
+}
+
+/**
+ * @brief Sets all the inputs at time t with a single setReal.
+ *
+ * Before the first sample and after the last one, the inputs hold the nearest sample.
+ *
+ * @return fmi2Status The status of setReal, fmi2Error if memory is exhausted.
+ */
+fmi2Status applyInputs(FMU *fmu, fmi2Component component, const Inputs *inputs, InputCursor *cursor, double t) {
+    if (!cursor->values) {
+        cursor->values = (double*)malloc(inputs->nInputs * sizeof(double));
+        if (!cursor->values) return fmi2Error;
+    }
+    seekInputs(inputs, cursor, t);
+
+    const double *row = inputs->data + cursor->row * inputs->nColumns;
+    const double *next = cursor->row + 1 < inputs->nRows ? row + inputs->nColumns : row;
+    double weight = 0;
+    if (inputs->interpolation == INPUT_LINEAR && next[0] > row[0] && t > row[0]) {
+        weight = (t - row[0]) / (next[0] - row[0]);
+        if (weight > 1) weight = 1;
+    }
+    for (int k = 0; k < inputs->nInputs; k++) {
+        int c = inputs->columns[k];
+        cursor->values[k] = row[c] + weight * (next[c] - row[c]);
+    }
+    return fmu->setReal(component, inputs->vrs, inputs->nInputs, cursor->values);
+}
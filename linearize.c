@@ -0,0 +1,654 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "headers/fmi2TypesPlatform.h"
+#include "headers/fmi2FunctionTypes.h"
+#include "headers/fmi2Functions.h"
+
+#define MAX_PATH_SIZE 1024
+
+/**
+ * @struct LinearizationPattern
+ * @brief Sparsity of the Jacobian [A B; C D] of the model, read from <ModelStructure>.
+ *
+ * The known variables (columns) are the continuous states then the Real inputs, the unknowns (rows)
+ * are the state derivatives then the Real outputs. Columns which never share a row get the same
+ * color: a single directional derivative or finite difference evaluates all the columns of a color
+ * at once, so a sparse Jacobian costs as many evaluations as colors instead of columns.
+ */
+typedef struct {
+    int nx;                          // number of states
+    int nu;                          // number of Real inputs
+    int ny;                          // number of Real outputs
+    int *knownVariables;             // variable index of each column
+    int *unknownVariables;           // variable index of each row
+    fmi2ValueReference *knownVRs;
+    fmi2ValueReference *unknownVRs;
+    int *rowStart;                   // nonzeros of row r are columns[rowStart[r] .. rowStart[r+1]-1]
+    int *columns;
+    int nNonZeros;
+    int *color;                      // color of each column
+    int nColors;
+    int *colorColumnStart;           // columns of color k are colorColumns[colorColumnStart[k] ..]
+    int *colorColumns;
+    int *colorRowStart;              // rows touched by color k are colorRows[colorRowStart[k] ..]
+    int *colorRows;
+    int *colorNonZeros;              // nonzero of each of these rows evaluated by color k
+} LinearizationPattern;
+
+/**
+ * @struct LinearizationJob
+ * @brief Linearization at one operating point, run on a clone of the instance in its own thread.
+ */
+typedef struct {
+    FMU *fmu;
+    fmi2CallbackLogger logger;
+    const LinearizationPattern *pattern;
+    const char *prefix;
+    const FrequencyResponse *response; // transfer functions to evaluate, may be NULL
+    int index;                       // index of the operating point, used in the file names
+    double time;
+    double tolerance;
+    fmi2Byte *serializedState;       // state of the simulated instance at the operating point
+    size_t serializedSize;
+    fmi2CallbackFunctions callbacks; // kept alive as long as the clone
+    fmi2Status status;
+    pthread_t thread;
+    int started;
+} LinearizationJob;
+
+/**
+ * @struct Linearization
+ * @brief Operating points to linearize and the jobs linearizing them.
+ */
+typedef struct {
+    LinearizationPattern pattern;
+    double *times;                   // operating points, in increasing order
+    int nTimes;
+    int next;                        // next operating point to reach
+    const char *prefix;              // output files are <prefix>_<k>_A.mtx, _B, _C and _D
+    fmi2CallbackLogger logger;       // logger of the clones
+    const FrequencyResponse *response; // if not NULL, also <prefix>_<k>_bode.csv
+    LinearizationJob *jobs;
+    int maxThreads;
+} Linearization;
+
+/**
+ * @brief Parses a comma separated list of increasing operating points, e.g. "0.5,1,2".
+ *
+ * @return 0 on success, -1 if the list is invalid or memory is exhausted.
+ */
+int addLinearizationTimes(Linearization *linearization, const char *list) {
+    const char *p = list;
+    while (*p) {
+        char *end;
+        double time = strtod(p, &end);
+        if (end == p || (*end != ',' && *end != '\0')) return -1;
+        if (linearization->nTimes > 0 && time <= linearization->times[linearization->nTimes - 1]) return -1;
+
+        double *times = (double*)realloc(linearization->times, (linearization->nTimes + 1) * sizeof(double));
+        if (!times) return -1;
+        linearization->times = times;
+        linearization->times[linearization->nTimes++] = time;
+        p = *end == ',' ? end + 1 : end;
+    }
+    return linearization->nTimes > 0 ? 0 : -1;
+}
+
+/**
+ * @brief Frees the pattern, the jobs and the operating points.
+ *
+ * The jobs must have been finished with finishLinearization.
+ */
+void freeLinearization(Linearization *linearization) {
+    LinearizationPattern *pattern = &linearization->pattern;
+    free(pattern->knownVariables);
+    free(pattern->unknownVariables);
+    free(pattern->knownVRs);
+    free(pattern->unknownVRs);
+    free(pattern->rowStart);
+    free(pattern->columns);
+    free(pattern->color);
+    free(pattern->colorColumnStart);
+    free(pattern->colorColumns);
+    free(pattern->colorRowStart);
+    free(pattern->colorRows);
+    free(pattern->colorNonZeros);
+    for (int k = 0; linearization->jobs && k < linearization->nTimes; k++) {
+        free(linearization->jobs[k].serializedState);
+    }
+    free(linearization->jobs);
+    free(linearization->times);
+    memset(linearization, 0, sizeof(Linearization));
+}
+
+/**
+ * @brief Appends the known columns an unknown depends on to the current row of the pattern.
+ *
+ * @param mark Per column, the last row it was added to, to drop duplicated dependencies.
+ */
+static void addPatternRow(LinearizationPattern *pattern, const ModelUnknown *unknown, const int *columnOf,
+                          int *mark, int row) {
+    int nColumns = pattern->nx + pattern->nu;
+    int count = unknown->count < 0 ? nColumns : unknown->count;
+    for (int d = 0; d < count; d++) {
+        int column = unknown->count < 0 ? d : columnOf[model_dependencies[unknown->start + d]];
+        if (column < 0 || mark[column] == row) continue;
+        mark[column] = row;
+        pattern->columns[pattern->nNonZeros++] = column;
+    }
+    pattern->rowStart[row + 1] = pattern->nNonZeros;
+}
+
+/**
+ * @brief Builds the sparsity pattern and its column coloring from <ModelStructure>.
+ *
+ * @param linearization The linearization, its operating points already added.
+ * @param variables The model variables.
+ * @param nVariables The number of model variables.
+ * @return 0 on success, -1 if memory is exhausted.
+ */
+int initLinearization(Linearization *linearization, const ScalarVariable *variables, int nVariables) {
+    LinearizationPattern *pattern = &linearization->pattern;
+    int nx = model.numberOfContinuousStates;
+    int nu = 0, ny = 0;
+
+    for (int i = 0; i < nVariables; i++) {
+        if (variables[i].causality == INPUT && variables[i].type == REAL) nu++;
+    }
+    for (int k = 0; k < NOUTPUTS; k++) {
+        if (variables[model_outputs[k].variable].type == REAL) ny++;
+    }
+    int nColumns = nx + nu, nRows = nx + ny;
+    int maxNonZeros = nRows * nColumns;
+
+    pattern->nx = nx;
+    pattern->nu = nu;
+    pattern->ny = ny;
+    pattern->knownVariables = (int*)malloc((nColumns + 1) * sizeof(int));
+    pattern->unknownVariables = (int*)malloc((nRows + 1) * sizeof(int));
+    pattern->knownVRs = (fmi2ValueReference*)malloc((nColumns + 1) * sizeof(fmi2ValueReference));
+    pattern->unknownVRs = (fmi2ValueReference*)malloc((nRows + 1) * sizeof(fmi2ValueReference));
+    pattern->rowStart = (int*)calloc(nRows + 1, sizeof(int));
+    pattern->columns = (int*)malloc((maxNonZeros + 1) * sizeof(int));
+    pattern->color = (int*)malloc((nColumns + 1) * sizeof(int));
+    pattern->colorColumnStart = (int*)calloc(nColumns + 2, sizeof(int));
+    pattern->colorColumns = (int*)malloc((nColumns + 1) * sizeof(int));
+    pattern->colorRowStart = (int*)calloc(nColumns + 2, sizeof(int));
+    pattern->colorRows = (int*)malloc((maxNonZeros + 1) * sizeof(int));
+    pattern->colorNonZeros = (int*)malloc((maxNonZeros + 1) * sizeof(int));
+    linearization->jobs = (LinearizationJob*)calloc(linearization->nTimes + 1, sizeof(LinearizationJob));
+    int *columnOf = (int*)malloc((nVariables + 1) * sizeof(int));
+    int *mark = (int*)malloc((nColumns + nRows + 1) * sizeof(int));
+    int *rowsOfColumnStart = (int*)calloc(nColumns + 2, sizeof(int));
+    int *rowsOfColumn = (int*)malloc((maxNonZeros + 1) * sizeof(int));
+    if (!pattern->knownVariables || !pattern->unknownVariables || !pattern->knownVRs || !pattern->unknownVRs ||
+        !pattern->rowStart || !pattern->columns || !pattern->color || !pattern->colorColumnStart ||
+        !pattern->colorColumns || !pattern->colorRowStart || !pattern->colorRows || !pattern->colorNonZeros ||
+        !linearization->jobs || !columnOf || !mark || !rowsOfColumnStart || !rowsOfColumn) {
+        free(columnOf);
+        free(mark);
+        free(rowsOfColumnStart);
+        free(rowsOfColumn);
+        return -1;
+    }
+
+    // Columns: states in the order of x, then the Real inputs
+    for (int i = 0; i < nVariables; i++) columnOf[i] = -1;
+    for (int i = 0; i < nx; i++) {
+        pattern->knownVariables[i] = model_states[i].state;
+        pattern->unknownVariables[i] = model_states[i].derivative;
+        columnOf[model_states[i].state] = i;
+    }
+    for (int i = 0, j = nx; i < nVariables; i++) {
+        if (variables[i].causality == INPUT && variables[i].type == REAL) {
+            pattern->knownVariables[j] = i;
+            columnOf[i] = j++;
+        }
+    }
+    for (int c = 0; c < nColumns; c++) pattern->knownVRs[c] = variables[pattern->knownVariables[c]].valueReference;
+
+    // Rows: the dependencies of the derivatives, then of the Real outputs
+    for (int c = 0; c < nColumns; c++) mark[c] = -1;
+    for (int i = 0; i < nx; i++) {
+        addPatternRow(pattern, &model_derivative_dependencies[i], columnOf, mark, i);
+    }
+    for (int k = 0, r = nx; k < NOUTPUTS; k++) {
+        if (variables[model_outputs[k].variable].type != REAL) continue;
+        pattern->unknownVariables[r] = model_outputs[k].variable;
+        addPatternRow(pattern, &model_outputs[k], columnOf, mark, r++);
+    }
+    for (int r = 0; r < nRows; r++) pattern->unknownVRs[r] = variables[pattern->unknownVariables[r]].valueReference;
+
+    // Rows of each column, to find the columns sharing a row
+    for (int p = 0; p < pattern->nNonZeros; p++) rowsOfColumnStart[pattern->columns[p] + 1]++;
+    for (int c = 0; c < nColumns; c++) rowsOfColumnStart[c + 1] += rowsOfColumnStart[c];
+    for (int r = 0; r < nRows; r++) {
+        for (int p = pattern->rowStart[r]; p < pattern->rowStart[r + 1]; p++) {
+            rowsOfColumn[rowsOfColumnStart[pattern->columns[p]]++] = r;
+        }
+    }
+    for (int c = nColumns; c > 0; c--) rowsOfColumnStart[c] = rowsOfColumnStart[c - 1];
+    rowsOfColumnStart[0] = 0;
+
+    // Greedy coloring: each column takes the smallest color not used by a column sharing one of its rows
+    for (int c = 0; c < nColumns; c++) mark[c] = -1;
+    pattern->nColors = 0;
+    for (int c = 0; c < nColumns; c++) {
+        for (int q = rowsOfColumnStart[c]; q < rowsOfColumnStart[c + 1]; q++) {
+            int r = rowsOfColumn[q];
+            for (int p = pattern->rowStart[r]; p < pattern->rowStart[r + 1]; p++) {
+                if (pattern->columns[p] < c) mark[pattern->color[pattern->columns[p]]] = c;
+            }
+        }
+        int color = 0;
+        while (mark[color] == c) color++;
+        pattern->color[c] = color;
+        if (color + 1 > pattern->nColors) pattern->nColors = color + 1;
+    }
+
+    // Columns and rows of each color, a row has at most one nonzero per color
+    for (int c = 0; c < nColumns; c++) pattern->colorColumnStart[pattern->color[c] + 1]++;
+    for (int p = 0; p < pattern->nNonZeros; p++) pattern->colorRowStart[pattern->color[pattern->columns[p]] + 1]++;
+    for (int k = 0; k < pattern->nColors; k++) {
+        pattern->colorColumnStart[k + 1] += pattern->colorColumnStart[k];
+        pattern->colorRowStart[k + 1] += pattern->colorRowStart[k];
+    }
+    for (int k = 0; k < pattern->nColors; k++) mark[k] = pattern->colorColumnStart[k];
+    for (int c = 0; c < nColumns; c++) pattern->colorColumns[mark[pattern->color[c]]++] = c;
+    for (int k = 0; k < pattern->nColors; k++) mark[k] = pattern->colorRowStart[k];
+    for (int r = 0; r < nRows; r++) {
+        for (int p = pattern->rowStart[r]; p < pattern->rowStart[r + 1]; p++) {
+            int q = mark[pattern->color[pattern->columns[p]]]++;
+            pattern->colorRows[q] = r;
+            pattern->colorNonZeros[q] = p;
+        }
+    }
+
+    free(columnOf);
+    free(mark);
+    free(rowsOfColumnStart);
+    free(rowsOfColumn);
+
+    long nProcessors = sysconf(_SC_NPROCESSORS_ONLN);
+    linearization->maxThreads = nProcessors > 0 ? (int)nProcessors : 1;
+    INFO("Linearization: %d nonzeros, %d colors for %d columns\n", pattern->nNonZeros, pattern->nColors, nColumns);
+    return 0;
+}
+
+/**
+ * @brief Computes the nonzeros of the Jacobian with one directional derivative per color.
+ */
+static fmi2Status directionalJacobian(FMU *fmu, fmi2Component component, const LinearizationPattern *pattern,
+                                      double *values) {
+    int nColumns = pattern->nx + pattern->nu, nRows = pattern->nx + pattern->ny;
+    fmi2ValueReference *vKnown = (fmi2ValueReference*)malloc((nColumns + 1) * sizeof(fmi2ValueReference));
+    fmi2ValueReference *vUnknown = (fmi2ValueReference*)malloc((nRows + 1) * sizeof(fmi2ValueReference));
+    double *seed = (double*)malloc((nColumns + 1) * sizeof(double));
+    double *du = (double*)malloc((nRows + 1) * sizeof(double));
+    fmi2Status status = fmi2OK;
+
+    if (!vKnown || !vUnknown || !seed || !du) status = fmi2Error;
+    for (int k = 0; k < pattern->nColors && status <= fmi2Warning; k++) {
+        int nKnown = 0, nUnknown = 0;
+        for (int q = pattern->colorColumnStart[k]; q < pattern->colorColumnStart[k + 1]; q++) {
+            vKnown[nKnown] = pattern->knownVRs[pattern->colorColumns[q]];
+            seed[nKnown++] = 1.0;
+        }
+        for (int q = pattern->colorRowStart[k]; q < pattern->colorRowStart[k + 1]; q++) {
+            vUnknown[nUnknown++] = pattern->unknownVRs[pattern->colorRows[q]];
+        }
+        if (nUnknown == 0) continue;
+
+        fmi2Status fmi2Flag = fmu->getDirectionalDerivative(component, vUnknown, nUnknown, vKnown, nKnown, seed, du);
+        if (fmi2Flag > status) status = fmi2Flag;
+        for (int q = pattern->colorRowStart[k]; q < pattern->colorRowStart[k + 1]; q++) {
+            values[pattern->colorNonZeros[q]] = du[q - pattern->colorRowStart[k]];
+        }
+    }
+
+    free(vKnown);
+    free(vUnknown);
+    free(seed);
+    free(du);
+    return status;
+}
+
+/**
+ * @brief Evaluates the derivatives and the Real outputs, the unknowns of the Jacobian.
+ */
+static fmi2Status evaluateUnknowns(FMU *fmu, fmi2Component component, const LinearizationPattern *pattern,
+                                   double *f) {
+    fmi2Status status = fmu->getDerivatives(component, f, pattern->nx);
+    if (status > fmi2Warning || pattern->ny == 0) return status;
+    fmi2Status fmi2Flag = fmu->getReal(component, pattern->unknownVRs + pattern->nx, pattern->ny, f + pattern->nx);
+    return fmi2Flag > status ? fmi2Flag : status;
+}
+
+/**
+ * @brief Computes the nonzeros of the Jacobian with one forward difference per color.
+ *
+ * The states are perturbed with setContinuousStates and the inputs with setReal, both are
+ * restored to the operating point afterwards.
+ */
+static fmi2Status finiteDifferenceJacobian(FMU *fmu, fmi2Component component, const LinearizationPattern *pattern,
+                                           double *values) {
+    int nx = pattern->nx, nu = pattern->nu;
+    int nColumns = nx + nu, nRows = nx + pattern->ny;
+    double *v0 = (double*)malloc((nColumns + 1) * sizeof(double));   // states then inputs
+    double *v = (double*)malloc((nColumns + 1) * sizeof(double));
+    double *delta = (double*)malloc((nColumns + 1) * sizeof(double));
+    double *f0 = (double*)malloc((nRows + 1) * sizeof(double));
+    double *f = (double*)malloc((nRows + 1) * sizeof(double));
+    fmi2Status status = fmi2OK, fmi2Flag;
+
+    if (!v0 || !v || !delta || !f0 || !f) {
+        status = fmi2Error;
+        goto done;
+    }
+
+    status = fmu->getContinuousStates(component, v0, nx);
+    if (status <= fmi2Warning && nu > 0) {
+        fmi2Flag = fmu->getReal(component, pattern->knownVRs + nx, nu, v0 + nx);
+        if (fmi2Flag > status) status = fmi2Flag;
+    }
+    if (status <= fmi2Warning) {
+        fmi2Flag = evaluateUnknowns(fmu, component, pattern, f0);
+        if (fmi2Flag > status) status = fmi2Flag;
+    }
+    if (status > fmi2Warning) goto done;
+
+    // The step is exactly representable so that (v + delta) - v == delta
+    for (int c = 0; c < nColumns; c++) {
+        double step = sqrt(DBL_EPSILON) * fmax(fabs(v0[c]), 1.0);
+        delta[c] = (v0[c] + step) - v0[c];
+    }
+
+    for (int k = 0; k < pattern->nColors && status <= fmi2Warning; k++) {
+        if (pattern->colorRowStart[k] == pattern->colorRowStart[k + 1]) continue;
+
+        memcpy(v, v0, nColumns * sizeof(double));
+        for (int q = pattern->colorColumnStart[k]; q < pattern->colorColumnStart[k + 1]; q++) {
+            int c = pattern->colorColumns[q];
+            v[c] += delta[c];
+        }
+        fmi2Flag = fmu->setContinuousStates(component, v, nx);
+        if (fmi2Flag > status) status = fmi2Flag;
+        if (nu > 0) {
+            fmi2Flag = fmu->setReal(component, pattern->knownVRs + nx, nu, v + nx);
+            if (fmi2Flag > status) status = fmi2Flag;
+        }
+        fmi2Flag = evaluateUnknowns(fmu, component, pattern, f);
+        if (fmi2Flag > status) status = fmi2Flag;
+
+        for (int q = pattern->colorRowStart[k]; q < pattern->colorRowStart[k + 1]; q++) {
+            int r = pattern->colorRows[q], p = pattern->colorNonZeros[q];
+            values[p] = (f[r] - f0[r]) / delta[pattern->columns[p]];
+        }
+    }
+
+    // Back to the operating point
+    fmi2Flag = fmu->setContinuousStates(component, v0, nx);
+    if (fmi2Flag > status) status = fmi2Flag;
+    if (nu > 0) {
+        fmi2Flag = fmu->setReal(component, pattern->knownVRs + nx, nu, v0 + nx);
+        if (fmi2Flag > status) status = fmi2Flag;
+    }
+
+done:
+    free(v0);
+    free(v);
+    free(delta);
+    free(f0);
+    free(f);
+    return status;
+}
+
+/**
+ * @brief Writes one block of the Jacobian in the Matrix Market coordinate format.
+ *
+ * Only the nonzeros are written, with 1-based indices relative to the block. The names of the
+ * rows and columns are given in comments.
+ *
+ * @return 0 on success, -1 if the file cannot be written.
+ */
+static int writeMatrixMarket(const char *path, const LinearizationPattern *pattern, const double *values,
+                             char name, double time, int row0, int nRows, int column0, int nColumns) {
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        printf("Could not open %s\n", path);
+        return -1;
+    }
+
+    int count = 0;
+    for (int r = row0; r < row0 + nRows; r++) {
+        for (int p = pattern->rowStart[r]; p < pattern->rowStart[r + 1]; p++) {
+            int c = pattern->columns[p];
+            if (c >= column0 && c < column0 + nColumns && values[p] != 0) count++;
+        }
+    }
+
+    fprintf(file, "%%%%MatrixMarket matrix coordinate real general\n");
+    fprintf(file, "%% %c matrix of %s linearized at t=%.17g\n", name, model.modelName, time);
+    fprintf(file, "%% rows:");
+    for (int r = row0; r < row0 + nRows; r++) fprintf(file, " %s", variable_names[pattern->unknownVariables[r]]);
+    fprintf(file, "\n%% columns:");
+    for (int c = column0; c < column0 + nColumns; c++) fprintf(file, " %s", variable_names[pattern->knownVariables[c]]);
+    fprintf(file, "\n%d %d %d\n", nRows, nColumns, count);
+    for (int r = row0; r < row0 + nRows; r++) {
+        for (int p = pattern->rowStart[r]; p < pattern->rowStart[r + 1]; p++) {
+            int c = pattern->columns[p];
+            if (c >= column0 && c < column0 + nColumns && values[p] != 0) {
+                fprintf(file, "%d %d %.17g\n", r - row0 + 1, c - column0 + 1, values[p]);
+            }
+        }
+    }
+
+    int failed = ferror(file);
+    if (fclose(file) != 0 || failed) {
+        printf("Could not write %s\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Computes the Jacobian of an instance at its current point and writes A, B, C and D,
+ * and their transfer functions if a frequency response is given.
+ *
+ * @return fmi2Status The worst status of the FMU, fmi2Error if the files cannot be written.
+ */
+static fmi2Status linearizeInstance(FMU *fmu, fmi2Component component, const LinearizationPattern *pattern,
+                                    const char *prefix, const FrequencyResponse *response, int index, double time) {
+    double *values = (double*)calloc(pattern->nNonZeros + 1, sizeof(double));
+    if (!values) return fmi2Error;
+
+    fmi2Status status = model.providesDirectionalDerivative
+                        ? directionalJacobian(fmu, component, pattern, values)
+                        : finiteDifferenceJacobian(fmu, component, pattern, values);
+
+    int nx = pattern->nx, nu = pattern->nu, ny = pattern->ny;
+    const int blocks[4][4] = {{0, nx, 0, nx}, {0, nx, nx, nu}, {nx, ny, 0, nx}, {nx, ny, nx, nu}};
+    char path[MAX_PATH_SIZE];
+    for (int b = 0; b < 4 && status <= fmi2Warning; b++) {
+        snprintf(path, sizeof(path), "%s_%d_%c.mtx", prefix, index, 'A' + b);
+        if (writeMatrixMarket(path, pattern, values, 'A' + b, time,
+                              blocks[b][0], blocks[b][1], blocks[b][2], blocks[b][3]) != 0) {
+            status = fmi2Error;
+        }
+    }
+
+    // Transfer functions from the dense Jacobian
+    if (response && status <= fmi2Warning) {
+        int nColumns = nx + nu;
+        double *J = (double*)calloc((size_t)(nx + ny) * nColumns + 1, sizeof(double));
+        if (J) {
+            for (int r = 0; r < nx + ny; r++) {
+                for (int p = pattern->rowStart[r]; p < pattern->rowStart[r + 1]; p++) {
+                    J[(size_t)r * nColumns + pattern->columns[p]] = values[p];
+                }
+            }
+            snprintf(path, sizeof(path), "%s_%d_bode.csv", prefix, index);
+        }
+        if (!J || writeTransferFunctions(path, response, nx, nu, ny, J, pattern->knownVariables + nx,
+                                         pattern->unknownVariables + nx) != 0) {
+            status = fmi2Error;
+        }
+        free(J);
+    }
+
+    free(values);
+    return status;
+}
+
+/**
+ * @brief Thread of a job: clones the simulated instance from its serialized state and linearizes it.
+ */
+static void *linearizationWorker(void *arg) {
+    LinearizationJob *job = (LinearizationJob*)arg;
+    FMU *fmu = job->fmu;
+    fmi2EventInfo eventInfo = {0};
+    fmi2FMUstate fmuState = NULL;
+
+    job->callbacks = (fmi2CallbackFunctions){job->logger, calloc, free, NULL, fmu};
+    fmi2Component component = fmu->instantiate(model.modelName, fmi2ModelExchange, model.guid, NULL,
+                                               &job->callbacks, fmi2False, fmi2False);
+    if (!component) {
+        job->status = fmi2Error;
+        return NULL;
+    }
+
+    // Bring the clone to continuous-time mode, then overwrite its state with the simulated one
+    fmi2Status status = fmu->setupExperiment(component, job->tolerance > 0 ? fmi2True : fmi2False,
+                                             job->tolerance, job->time, fmi2False, 0);
+    if (status <= fmi2Warning) status = fmu->enterInitializationMode(component);
+    if (status <= fmi2Warning) status = fmu->exitInitializationMode(component);
+    eventInfo.newDiscreteStatesNeeded = fmi2True;
+    while (status <= fmi2Warning && eventInfo.newDiscreteStatesNeeded && !eventInfo.terminateSimulation) {
+        status = fmu->newDiscreteStates(component, &eventInfo);
+    }
+    if (status <= fmi2Warning) status = fmu->enterContinuousTimeMode(component);
+    if (status <= fmi2Warning) {
+        status = fmu->deSerializeFMUstate(component, job->serializedState, job->serializedSize, &fmuState);
+    }
+    if (status <= fmi2Warning) status = fmu->setFMUstate(component, fmuState);
+    if (fmuState) fmu->freeFMUstate(component, &fmuState);
+    if (status <= fmi2Warning) status = fmu->setTime(component, job->time);
+
+    if (status <= fmi2Warning) {
+        status = linearizeInstance(fmu, component, job->pattern, job->prefix, job->response, job->index, job->time);
+    }
+
+    fmu->terminate(component);
+    fmu->freeInstance(component);
+    job->status = status;
+    return NULL;
+}
+
+/**
+ * @brief Waits for a job and reports its failure.
+ *
+ * @return 0 if the job succeeded, -1 otherwise.
+ */
+static int joinLinearizationJob(LinearizationJob *job) {
+    if (!job->started) return 0;
+    pthread_join(job->thread, NULL);
+    job->started = 0;
+    free(job->serializedState);
+    job->serializedState = NULL;
+    if (job->status > fmi2Warning) {
+        printf("Linearization %d at t=%g failed\n", job->index, job->time);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Linearizes the simulated instance at the next operating point.
+ *
+ * If the FMU can serialize its state, the state is copied to a clone linearized by a new thread
+ * while the simulation goes on, with at most one thread per processor. Otherwise, or if the model
+ * can be instantiated only once per process, the instance is linearized in place and left at the
+ * operating point.
+ *
+ * @param fmu Pointer to the FMU structure
+ * @param component The simulated instance, in continuous-time mode
+ * @param linearization The linearization
+ * @param time The current simulation time, the next operating point
+ * @param tolerance The tolerance of the simulation, passed to the clones
+ * @return 0 on success, -1 on failure
+ */
+int linearizeAt(FMU *fmu, fmi2Component component, Linearization *linearization, double time, double tolerance) {
+    int index = linearization->next++;
+    LinearizationJob *job = &linearization->jobs[index];
+    job->fmu = fmu;
+    job->logger = linearization->logger;
+    job->pattern = &linearization->pattern;
+    job->prefix = linearization->prefix;
+    job->response = linearization->response;
+    job->index = index;
+    job->time = time;
+    job->tolerance = tolerance;
+
+    if (!model.canGetAndSetFMUstate || !model.canSerializeFMUstate || model.canBeInstantiatedOnlyOncePerProcess) {
+        job->status = linearizeInstance(fmu, component, job->pattern, job->prefix, job->response, index, time);
+        if (job->status > fmi2Warning) {
+            printf("Linearization %d at t=%g failed\n", index, time);
+            return -1;
+        }
+        return 0;
+    }
+
+    // Snapshot of the simulated instance
+    fmi2FMUstate fmuState = NULL;
+    fmi2Status status = fmu->getFMUstate(component, &fmuState);
+    if (status <= fmi2Warning) status = fmu->serializedFMUstateSize(component, fmuState, &job->serializedSize);
+    if (status <= fmi2Warning) {
+        job->serializedState = (fmi2Byte*)malloc(job->serializedSize + 1);
+        status = job->serializedState
+                 ? fmu->serializeFMUstate(component, fmuState, job->serializedState, job->serializedSize)
+                 : fmi2Error;
+    }
+    if (fmuState) fmu->freeFMUstate(component, &fmuState);
+    if (status > fmi2Warning) {
+        printf("Could not save the state at t=%g for linearization %d\n", time, index);
+        free(job->serializedState);
+        job->serializedState = NULL;
+        return -1;
+    }
+
+    // Keep at most maxThreads clones alive
+    int result = 0;
+    if (index >= linearization->maxThreads) {
+        result = joinLinearizationJob(&linearization->jobs[index - linearization->maxThreads]);
+    }
+    if (pthread_create(&job->thread, NULL, linearizationWorker, job) != 0) {
+        free(job->serializedState);
+        job->serializedState = NULL;
+        job->status = linearizeInstance(fmu, component, job->pattern, job->prefix, job->response, index, time);
+        if (job->status > fmi2Warning) {
+            printf("Linearization %d at t=%g failed\n", index, time);
+            return -1;
+        }
+        return result;
+    }
+    job->started = 1;
+    return result;
+}
+
+/**
+ * @brief Waits for all the running linearizations.
+ *
+ * @return 0 if every started linearization succeeded, -1 otherwise.
+ */
+int finishLinearization(Linearization *linearization) {
+    int result = 0;
+    for (int k = 0; linearization->jobs && k < linearization->nTimes; k++) {
+        if (joinLinearizationJob(&linearization->jobs[k]) != 0) result = -1;
+    }
+    return result;
+}
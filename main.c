@@ -1,3 +1,5 @@
+// CPU affinity of the real-time mode
+#define _GNU_SOURCE
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdarg.h>
@@ -28,12 +30,33 @@
 } while (0)
 #endif
 
-// Minimum macro
+// Pause between two getStatus rounds on the pending co-simulation slaves, in ns
+#define STATUS_POLL_INTERVAL 20000
+
+// Minimum and maximum macros
 #define min(a,b) ((a)>(b) ? (b) : (a))
+#define max(a,b) ((a)<(b) ? (b) : (a))
+
+// Simulation modules, included after the macros above which they use
+#include "parameters.c"
+#include "inputs.c"
+#include "realtime.c"
+#include "exchange.c"
+#include "results.c"
+#include "transforms.c"
+#include "monitors.c"
+#include "frequency.c"
+#include "linearize.c"
+#include "trim.c"
+#include "sensitivity.c"
+#include "adjoint.c"
+#include "calibrate.c"
+#include "ssp.c"
 
 // Structure to hold the simulation state
 typedef struct {
     fmi2Component component;
+    fmi2Type type;                   // fmi2CoSimulation for the slaves of a system, fmi2ModelExchange otherwise
     int nx;                          // number of state variables
     int nz;                          // number of state event indicators
     double *x;                       // continuous states
@@ -44,10 +67,18 @@ typedef struct {
     double h;                        // step size
     double tStart;                   // start time
     double tEnd;                     // end time
+    double tolerance;                // relative tolerance (<= 0 if undefined)
     fmi2EventInfo eventInfo;         // event info
-    ScalarVariable *variables;       // model variables
+    const ScalarVariable *variables; // model variables
     int nVariables;                  // number of variables
-    double **output;                 // output array
+    Results output;                  // recorded values, one row per step
+    Transforms *transforms;          // record-time derived signals and display units, may be NULL
+    Monitors *monitors;              // assertions checked on each recorded row, may be NULL
+    const Inputs *inputs;            // input series set at each step, may be NULL
+    InputCursor inputCursor;         // position of the instance in the input series
+    Exchange *exchange;              // inputs and outputs shared with another process, may be NULL
+    Sensitivities *sensitivities;    // forward sensitivities of the outputs, may be NULL
+    int replaying;                   // steps not recorded: adjoint replays and multi-sine runs
     int nSteps;                      // current step count
     int nTimeEvents;                 // number of time events
     int nStateEvents;                // number of state events
@@ -149,13 +180,9 @@ void cleanupSimulation(FMU *fmu, SimulationState *state) {
     if (state->z) free(state->z);
     if (state->prez) free(state->prez);
 
-    // Free output array
-    if (state->output) {
-        for (int i = 0; i < state->nVariables + 1; i++) {
-            if (state->output[i]) free(state->output[i]);
-        }
-        free(state->output);
-    }
+    // Free recorded output
+    freeResults(&state->output);
+    free(state->inputCursor.values);
 
     // Free the state structure itself
     free(state);
@@ -166,57 +193,80 @@ void cleanupSimulation(FMU *fmu, SimulationState *state) {
  * @brief Initializes the FMU simulation and returns a simulation state structure.
  *
  * @param fmu Pointer to the FMU structure
+ * @param tStart Start time for simulation
  * @param tEnd End time for simulation
  * @param h Step size
+ * @param tolerance Relative tolerance passed to setupExperiment, ignored if <= 0
+ * @param overrides Start values and parameters set by the user, may be NULL
+ * @param inputs Input series, set from tStart on, may be NULL
+ * @param type fmi2ModelExchange, or fmi2CoSimulation for a slave stepped by doStep
  * @return SimulationState* Pointer to initialized simulation state, NULL if error
  */
-SimulationState* initializeSimulation(FMU *fmu, double tStart, double tEnd, double h) {
+SimulationState* initializeSimulation(FMU *fmu, double tStart, double tEnd, double h, double tolerance,
+                                      const ParameterOverrides *overrides, const Inputs *inputs, fmi2Type type) {
     SimulationState *state = (SimulationState*)calloc(1, sizeof(SimulationState));
     if (!state) return NULL;
 
-    state->time = 0;
+    state->time = tStart;
     state->h = h;
     state->tStart = tStart;
     state->tEnd = tEnd;
+    state->tolerance = tolerance;
     state->nSteps = 0;
     state->nTimeEvents = 0;
     state->nStateEvents = 0;
     state->nStepEvents = 0;
+    state->type = type;
 
     // Setup callback functions
     fmi2CallbackFunctions callbacks = {fmuLogger, calloc, free, NULL, fmu};
 
     // Instantiate the FMU
-    state->component = fmu->instantiate(model.modelName, fmi2ModelExchange, 
+    state->component = fmu->instantiate(model.modelName, type, 
                                       model.guid, NULL, &callbacks, fmi2False, fmi2False);
     if (!state->component) {
         cleanupSimulation(fmu,state);
         return NULL;
     }
 
+    // Apply start values and user overrides before initialization
+    state->variables = get_variable_list();
+    state->nVariables = get_variable_count();
+    fmi2Status fmi2Flag = applyStartValues(fmu, state->component, state->variables,
+                                           state->nVariables, overrides);
+    if (fmi2Flag <= fmi2Warning && inputs) {
+        state->inputs = inputs;
+        fmi2Flag = applyInputs(fmu, state->component, inputs, &state->inputCursor, tStart);
+    }
+    if (fmi2Flag > fmi2Warning) {
+        cleanupSimulation(fmu,state);
+        return NULL;
+    }
+
     state->nx = model.numberOfContinuousStates;
     state->nz = model.numberOfEventIndicators;
 
-    // Allocate memory for states and indicators
-    state->x = (double*)calloc(state->nx, sizeof(double));
-    state->xdot = (double*)calloc(state->nx, sizeof(double));
+    // Allocate memory for states and indicators, sized from <ModelStructure><Derivatives>
+    if (state->nx > 0) {
+        state->x = (double*)calloc(state->nx, sizeof(double));
+        state->xdot = (double*)calloc(state->nx, sizeof(double));
+    }
     if (state->nz > 0) {
         state->z = (double*)calloc(state->nz, sizeof(double));
         state->prez = (double*)calloc(state->nz, sizeof(double));
     }
 
-    if ((!state->x || !state->xdot) || 
+    if ((state->nx > 0 && (!state->x || !state->xdot)) || 
         (state->nz > 0 && (!state->z || !state->prez))) {
         // Cleanup and return on allocation failure
         cleanupSimulation(fmu,state);
         return NULL;
     }
 
-    // Setup experiment
-    fmi2Boolean toleranceDefined = fmi2False;
-    fmi2Real tolerance = 0;
-    fmi2Status fmi2Flag = fmu->setupExperiment(state->component, toleranceDefined, 
-                                              tolerance, state->tStart, fmi2True, state->tEnd);
+    // Setup experiment, letting the FMU relax its internal solvers to the requested tolerance
+    fmi2Boolean toleranceDefined = state->tolerance > 0 ? fmi2True : fmi2False;
+    fmi2Flag = fmu->setupExperiment(state->component, toleranceDefined, 
+                                              state->tolerance, state->tStart, fmi2True, state->tEnd);
     if (fmi2Flag > fmi2Warning) {
         // Cleanup and return on setup failure
         cleanupSimulation(fmu,state);
@@ -236,8 +286,8 @@ SimulationState* initializeSimulation(FMU *fmu, double tStart, double tEnd, doub
         return NULL;
     }
 
-    // Initial event iteration
-    state->eventInfo.newDiscreteStatesNeeded = fmi2True;
+    // Initial event iteration, a co-simulation slave handles its events itself
+    state->eventInfo.newDiscreteStatesNeeded = type == fmi2ModelExchange;
     state->eventInfo.terminateSimulation = fmi2False;
     while (state->eventInfo.newDiscreteStatesNeeded && 
            !state->eventInfo.terminateSimulation) {
@@ -248,7 +298,7 @@ SimulationState* initializeSimulation(FMU *fmu, double tStart, double tEnd, doub
         }
     }
 
-    if (!state->eventInfo.terminateSimulation) {
+    if (type == fmi2ModelExchange && !state->eventInfo.terminateSimulation) {
         fmi2Flag = fmu->enterContinuousTimeMode(state->component);
         if (fmi2Flag > fmi2Warning) {
             cleanupSimulation(fmu,state);
@@ -256,26 +306,16 @@ SimulationState* initializeSimulation(FMU *fmu, double tStart, double tEnd, doub
         }
     }
 
-    // Initialize variables and output array
-    get_variable_list(&state->variables);
-    state->nVariables = get_variable_count();
-    state->output = (double**)calloc(state->nVariables, sizeof(double*));
-    for (int i = 0; i < state->nVariables; i++) {
-        state->output[i] = (double*)calloc((size_t)(tEnd/h + 10), sizeof(double));
+    // Initialize output columns and record the initial values
+    if (initResults(&state->output, state->variables, state->nVariables,
+                    (size_t)((tEnd - tStart)/h + 10)) != 0) {
+        cleanupSimulation(fmu,state);
+        return NULL;
     }
-
-    // Initialize first output values
-    for (int i = 0; i < state->nVariables; i++) {
-        if (state->variables[i].type == REAL) {
-            fmu->getReal(state->component, &state->variables[i].valueReference, 
-                        1, &state->output[i][0]);
-        } else if (state->variables[i].type == INTEGER) {
-            fmi2Integer intValue;
-            INFO("Trying to retrieve variable %s\n as integer", state->variables[i].name);
-            fmu->getInteger(state->component, &state->variables[i].valueReference, 
-                           1, &intValue);
-            state->output[i][0] = (double)intValue;
-        }
+    fmi2Flag = recordResults(fmu, state->component, &state->output);
+    if (fmi2Flag > fmi2Warning) {
+        cleanupSimulation(fmu,state);
+        return NULL;
     }
     return state;
 }
@@ -301,6 +341,12 @@ fmi2Status simulationDoStep(FMU *fmu, SimulationState *state) {
     double dt;
     fmi2Boolean timeEvent, stateEvent, stepEvent, terminateSimulation;
 
+    // Inputs written by the rig during the previous step, before the derivatives use them
+    if (state->exchange) {
+        fmi2Flag = readExchangeInputs(fmu, state->component, state->exchange);
+        if (fmi2Flag > fmi2Warning) return fmi2Flag;
+    }
+
     // Get current state and derivatives
     fmi2Flag = fmu->getContinuousStates(state->component, state->x, state->nx);
     if (fmi2Flag > fmi2Warning) return fmi2Flag;
@@ -316,10 +362,23 @@ fmi2Status simulationDoStep(FMU *fmu, SimulationState *state) {
                 state->time >= state->eventInfo.nextEventTime;
     
     if (timeEvent) state->time = state->eventInfo.nextEventTime;
+
+    // Held inputs change at their samples, which are time events too
+    if (state->inputs) {
+        double breakpoint = nextInputBreakpoint(state->inputs, &state->inputCursor, tPre);
+        if (breakpoint <= state->time) {
+            state->time = breakpoint;
+            timeEvent = fmi2True;
+        }
+    }
     dt = state->time - tPre;
     
     fmi2Flag = fmu->setTime(state->component, state->time);
     if (fmi2Flag > fmi2Warning) return fmi2Flag;
+    if (state->inputs) {
+        fmi2Flag = applyInputs(fmu, state->component, state->inputs, &state->inputCursor, state->time);
+        if (fmi2Flag > fmi2Warning) return fmi2Flag;
+    }
 
 	INFO("Time set\n");
 
@@ -327,6 +386,7 @@ fmi2Status simulationDoStep(FMU *fmu, SimulationState *state) {
     for (int i = 0; i < state->nx; i++) {
         state->x[i] += dt * state->xdot[i];
     }
+    if (state->sensitivities) advanceSensitivities(state->sensitivities, dt);
     
     fmi2Flag = fmu->setContinuousStates(state->component, state->x, state->nx);
     if (fmi2Flag > fmi2Warning) return fmi2Flag;
@@ -389,25 +449,267 @@ fmi2Status simulationDoStep(FMU *fmu, SimulationState *state) {
         if (fmi2Flag > fmi2Warning) return fmi2Flag;
     }
 
-    // Update outputs
-    for (int i = 0; i < state->nVariables; i++) {
-        if (state->variables[i].type == REAL) {
-            fmu->getReal(state->component, &state->variables[i].valueReference, 
-                        1, &state->output[i][state->nSteps]);
-			INFO("DEBUG:   %s (ref %d): %f\n", state->variables[i].name, 
-                   state->variables[i].valueReference, state->output[i][state->nSteps]);
-        } else if (state->variables[i].type == INTEGER) {
-            fmi2Integer intValue;
-            fmu->getInteger(state->component, &state->variables[i].valueReference, 
-                           1, &intValue);
-            state->output[i][state->nSteps] = (double)intValue;
-        }
+    if (state->replaying) return fmi2OK;
+
+    // Outputs go to the rig first, recording them can wait
+    if (state->exchange) {
+        fmi2Flag = publishExchangeOutputs(fmu, state->component, state->exchange, state->time);
+        if (fmi2Flag > fmi2Warning) return fmi2Flag;
+    }
+
+    // Update outputs, a monitor may stop the simulation on the recorded values
+    fmi2Flag = recordResults(fmu, state->component, &state->output);
+    if (fmi2Flag > fmi2Warning) return fmi2Flag;
+    if (state->monitors) {
+        int terminate = checkMonitors(state->monitors, &state->output, state->variables, state->time);
+        if (terminate < 0) return fmi2Error;
+        if (terminate) state->eventInfo.terminateSimulation = fmi2True;
+    }
+    if (state->transforms &&
+        applyTransforms(state->transforms, &state->output, state->variables, 0) != 0) return fmi2Error;
+    if (state->sensitivities) {
+        fmi2Flag = recordSensitivities(fmu, state->component, state->sensitivities);
+        if (fmi2Flag > fmi2Warning) return fmi2Flag;
     }
 
     state->nSteps++;
     return fmi2OK;
 }
 
+/**
+ * @brief Computes the gradient of the adjoint cost once the forward run is over.
+ *
+ * The segments between checkpoints are processed from the last to the first: the instance is
+ * restored from the checkpoint and the steps of the segment are recomputed, keeping the FMU
+ * state before each of them, then the adjoint is stepped back over the segment from these states.
+ *
+ * @param fmu Pointer to the FMU structure
+ * @param state Pointer to the simulation state, at the end of the forward run
+ * @param adjoint The adjoint, holding the checkpoints of the forward run
+ * @return fmi2Status The worst status of the FMU, fmi2Error if memory is exhausted
+ */
+fmi2Status computeGradient(FMU *fmu, SimulationState *state, Adjoint *adjoint) {
+    fmi2FMUstate *states = (fmi2FMUstate*)calloc(adjoint->interval, sizeof(fmi2FMUstate));
+    double *dt = (double*)malloc(adjoint->interval * sizeof(double));
+    if (!states || !dt) {
+        free(states);
+        free(dt);
+        return fmi2Error;
+    }
+
+    fmi2Status status = adjointTerminal(fmu, state->component, adjoint), fmi2Flag;
+    double tEnd = state->tEnd;
+    int nSteps = state->nSteps, nTimeEvents = state->nTimeEvents;
+    int nStateEvents = state->nStateEvents, nStepEvents = state->nStepEvents;
+    state->replaying = 1;
+
+    for (int c = adjoint->nCheckpoints - 1; c >= 0 && status <= fmi2Warning; c--) {
+        const Checkpoint *checkpoint = &adjoint->checkpoints[c];
+        int first = checkpoint->step;
+        int last = c + 1 < adjoint->nCheckpoints ? adjoint->checkpoints[c + 1].step : adjoint->nSteps;
+
+        // Recompute the segment from its checkpoint
+        status = restoreCheckpoint(fmu, state->component, checkpoint);
+        state->time = checkpoint->time;
+        state->eventInfo = checkpoint->eventInfo;
+        memcpy(state->z, checkpoint->z, state->nz * sizeof(double));
+        for (int n = first; n < last && status <= fmi2Warning; n++) {
+            status = fmu->getFMUstate(state->component, &states[n - first]);
+            double tPre = state->time;
+            state->tEnd = adjoint->stepEnds[n];
+            fmi2Flag = simulationDoStep(fmu, state);
+            if (fmi2Flag > status) status = fmi2Flag;
+            dt[n - first] = state->time - tPre;
+        }
+
+        // Step the adjoint back over it
+        for (int n = last - 1; n >= first && status <= fmi2Warning; n--) {
+            status = fmu->setFMUstate(state->component, states[n - first]);
+            if (status <= fmi2Warning) status = adjointStep(fmu, state->component, adjoint, dt[n - first]);
+        }
+        for (int n = 0; n < last - first; n++) {
+            if (states[n]) fmu->freeFMUstate(state->component, &states[n]);
+        }
+    }
+
+    state->replaying = 0;
+    state->tEnd = tEnd;
+    state->nSteps = nSteps;
+    state->nTimeEvents = nTimeEvents;
+    state->nStateEvents = nStateEvents;
+    state->nStepEvents = nStepEvents;
+    free(states);
+    free(dt);
+    return status;
+}
+
+/**
+ * @struct CalibrationRun
+ * @brief Experiment shared by the simulations of the calibration candidates.
+ */
+typedef struct {
+    FMU *fmu;
+    double tStart;
+    double h;
+    double tolerance;
+    const ParameterOverrides *overrides; // user overrides, the candidate values are applied after them
+    const Inputs *inputs;                // input series of the experiment, may be NULL
+    const Calibration *calibration;
+} CalibrationRun;
+
+/**
+ * @brief Simulates one calibration candidate in its own instance and samples the measured
+ * variables from the recorded results, the steps being shortened to stop at the measurement times.
+ *
+ * Matches SampleFunction, so that the candidates of an iteration can be simulated in parallel.
+ */
+static fmi2Status sampleCandidate(void *context, const double *parameters, double *samples, double *jacobian) {
+    const CalibrationRun *run = (const CalibrationRun*)context;
+    const Calibration *calibration = run->calibration;
+    const Measurements *data = &calibration->data;
+    int nP = calibration->nParameters, nSignals = data->nSignals;
+    int nUser = run->overrides ? run->overrides->count : 0;
+
+    // The candidate values come last, so they take precedence over the user overrides
+    ParameterOverrides overrides = {0};
+    overrides.items = (ParameterOverride*)malloc((nUser + nP) * sizeof(ParameterOverride));
+    char *values = (char*)malloc((size_t)nP * 32);
+    if (!overrides.items || !values) {
+        free(overrides.items);
+        free(values);
+        return fmi2Error;
+    }
+    if (nUser > 0) memcpy(overrides.items, run->overrides->items, nUser * sizeof(ParameterOverride));
+    for (int j = 0; j < nP; j++) {
+        snprintf(values + 32 * j, 32, "%.17g", parameters[j]);
+        overrides.items[nUser + j].name = (char*)variable_names[calibration->parameters[j]];
+        overrides.items[nUser + j].value = values + 32 * j;
+    }
+    overrides.count = overrides.capacity = nUser + nP;
+
+    SimulationState *state = initializeSimulation(run->fmu, run->tStart, data->times[data->nTimes - 1],
+                                                  run->h, run->tolerance, &overrides, run->inputs, fmi2ModelExchange);
+    free(overrides.items);
+    free(values);
+    if (!state) return fmi2Error;
+
+    fmi2Status status = fmi2OK, fmi2Flag;
+    Sensitivities sensitivities = {0};
+    if (jacobian) {
+        for (int j = 0; j < nP && status == fmi2OK; j++) {
+            if (addSensitivityParameter(&sensitivities, variable_names[calibration->parameters[j]], state->variables) != 0) {
+                status = fmi2Error;
+            }
+        }
+        if (status == fmi2OK && initSensitivities(&sensitivities, state->variables, state->output.capacity) != 0) {
+            status = fmi2Error;
+        }
+        if (status == fmi2OK) status = recordSensitivities(run->fmu, state->component, &sensitivities);
+        state->sensitivities = &sensitivities;
+    }
+
+    for (int n = 0; n < data->nTimes; n++) {
+        double *sample = samples + (size_t)n * nSignals;
+        state->tEnd = data->times[n];
+        while (status <= fmi2Warning && state->time < state->tEnd && !state->eventInfo.terminateSimulation) {
+            fmi2Flag = simulationDoStep(run->fmu, state);
+            if (fmi2Flag > status) status = fmi2Flag;
+        }
+
+        // Samples the model did not reach are missing, they make the cost infinite
+        if (status > fmi2Warning || state->time < state->tEnd) {
+            for (int k = 0; k < (data->nTimes - n) * nSignals; k++) sample[k] = NAN;
+            break;
+        }
+        for (int k = 0; k < nSignals; k++) {
+            sample[k] = getResultValue(&state->output, state->variables, data->signals[k], state->output.nRows - 1);
+            for (int j = 0; jacobian && j < nP; j++) {
+                jacobian[((size_t)n * nSignals + k) * nP + j] = sampleSensitivity(&sensitivities, data->signals[k], j);
+            }
+        }
+    }
+
+    state->sensitivities = NULL;
+    cleanupSimulation(run->fmu, state);
+    freeSensitivities(&sensitivities);
+    return status;
+}
+
+/**
+ * @struct ExcitationRun
+ * @brief Experiment shared by the multi-sine simulations.
+ */
+typedef struct {
+    FMU *fmu;
+    double tStart;
+    double tolerance;
+    const ParameterOverrides *overrides;
+} ExcitationRun;
+
+/**
+ * @brief Simulates two periods of a multi-sine on one input, in its own instance, and samples
+ * the input and the Real outputs over the second one.
+ *
+ * The input is set before each step, so that the outputs sampled at a step and the derivatives
+ * of the step use the same input value. Matches ExcitationFunction.
+ */
+static fmi2Status simulateExcitation(void *context, const FrequencyResponse *response, int input, int group,
+                                     double *u, double *y) {
+    const ExcitationRun *run = (const ExcitationRun*)context;
+    int N = response->nSamples, ny = response->ny;
+    SimulationState *state = initializeSimulation(run->fmu, run->tStart, run->tStart + 2 * N * response->h,
+                                                  response->h, run->tolerance, run->overrides, NULL,
+                                                  fmi2ModelExchange);
+    fmi2ValueReference *vrOutputs = (fmi2ValueReference*)malloc((ny + 1) * sizeof(fmi2ValueReference));
+    if (!state || !vrOutputs) {
+        cleanupSimulation(run->fmu, state);
+        free(vrOutputs);
+        return fmi2Error;
+    }
+    state->replaying = 1;
+    for (int i = 0; i < ny; i++) vrOutputs[i] = model_variables[response->outputs[i]].valueReference;
+
+    fmi2ValueReference vrInput = model_variables[response->inputs[input]].valueReference;
+    double u0;
+    fmi2Status status = run->fmu->getReal(state->component, &vrInput, 1, &u0), fmi2Flag;
+    for (int n = 0; n < 2 * N && status <= fmi2Warning; n++) {
+        double value = multisineSample(response, group, n, u0);
+        fmi2Flag = run->fmu->setReal(state->component, &vrInput, 1, &value);
+        if (fmi2Flag > status) status = fmi2Flag;
+        if (n >= N && status <= fmi2Warning) {
+            u[n - N] = value - u0;
+            fmi2Flag = run->fmu->getReal(state->component, vrOutputs, ny, y + (size_t)(n - N) * ny);
+            if (fmi2Flag > status) status = fmi2Flag;
+        }
+        if (state->eventInfo.terminateSimulation) status = fmi2Error;
+        if (status > fmi2Warning) break;
+
+        state->tEnd = run->tStart + (n + 1) * response->h;
+        fmi2Flag = simulationDoStep(run->fmu, state);
+        if (fmi2Flag > status) status = fmi2Flag;
+    }
+
+    cleanupSimulation(run->fmu, state);
+    free(vrOutputs);
+    return status;
+}
+
+// Prints the name of the sensitivity of output k to parameter p, "d(y)/d(p)"
+static void printSensitivityName(SimulationState *state, int column) {
+    const Sensitivities *sensitivities = state->sensitivities;
+    int k = column / sensitivities->nParameters, p = column % sensitivities->nParameters;
+    printf("d(%s)/d(%s)", variable_names[sensitivities->outputs[k]], variable_names[sensitivities->parameters[p]]);
+}
+
+// Prints the name of a variable, followed by its display unit if the results were converted to it
+static void printVariableName(SimulationState *state, int i) {
+    printf("%s", variable_names[i]);
+    if (state->transforms && state->transforms->scaled && variable_display_units[i].name &&
+        state->variables[i].type == REAL) {
+        printf(" [%s]", variable_display_units[i].name);
+    }
+}
+
 void printOutput(SimulationState *state) {
     // Print simulation summary
     INFO("Simulation from %g to %g terminated successfully\n", state->tStart, state->tEnd);
@@ -417,11 +719,21 @@ void printOutput(SimulationState *state) {
     INFO("  state events ..... %d\n", state->nStateEvents);
     INFO("  step events ...... %d\n", state->nStepEvents);
 
-    // Print the output
-    for (int j = 0; j < state->nSteps; j++) {
-        printf("Step %d: ", j);
+    // Print the output, row 0 holds the initial values
+    for (size_t j = 0; j < state->output.nRows; j++) {
+        printf("Step %zu: ", j);
         for (int i = 0; i < state->nVariables; i++) {
-            printf("%s=%f ", state->variables[i].name, state->output[i][j]);
+            printVariableName(state, i);
+            printf("=");
+            printResultValue(stdout, &state->output, state->variables, i, j);
+            printf(" ");
+        }
+        for (int s = 0; state->transforms && s < state->transforms->nSignals; s++) {
+            printf("%s=%f ", state->transforms->signals[s].name, state->transforms->signals[s].column[j]);
+        }
+        for (int c = 0; state->sensitivities && c < state->sensitivities->ny * state->sensitivities->nParameters; c++) {
+            printSensitivityName(state, c);
+            printf("=%f ", state->sensitivities->rows[j * state->sensitivities->ny * state->sensitivities->nParameters + c]);
         }
         printf("\n");
     }
@@ -431,26 +743,404 @@ void printCsv(SimulationState *state, char sep) {
     // Print headers
     printf("step%c", sep);
     for (int i = 0; i < state->nVariables; i++) {
-        printf("%s", state->variables[i].name);
+        printVariableName(state, i);
         if (i < state->nVariables - 1) {
             printf("%c", sep);
         }
     }
+    for (int s = 0; state->transforms && s < state->transforms->nSignals; s++) {
+        printf("%c%s", sep, state->transforms->signals[s].name);
+    }
+    for (int c = 0; state->sensitivities && c < state->sensitivities->ny * state->sensitivities->nParameters; c++) {
+        printf("%c", sep);
+        printSensitivityName(state, c);
+    }
     printf("\n");
     
     // Print the output
-    for (int j = 0; j < state->nSteps; j++) {
-        printf("%d%c", j, sep);
+    for (size_t j = 0; j < state->output.nRows; j++) {
+        printf("%zu%c", j, sep);
         for (int i = 0; i < state->nVariables; i++) {
-            printf("%f", state->output[i][j]);
+            printResultValue(stdout, &state->output, state->variables, i, j);
             if (i < state->nVariables - 1) {
                 printf("%c", sep);
             }
         }
+        for (int s = 0; state->transforms && s < state->transforms->nSignals; s++) {
+            printf("%c%f", sep, state->transforms->signals[s].column[j]);
+        }
+        for (int c = 0; state->sensitivities && c < state->sensitivities->ny * state->sensitivities->nParameters; c++) {
+            printf("%c%f", sep, state->sensitivities->rows[j * state->sensitivities->ny * state->sensitivities->nParameters + c]);
+        }
         printf("\n");
     }
 }
 
+/**
+ * @brief Ends the co-simulation step of a slave up to tNext, once its doStep is no longer pending.
+ *
+ * A discarded step ends the run if the slave reports that it terminated, at the last time it
+ * reached. The outputs are then recorded.
+ *
+ * @param status The status of doStep, or the one reported by getStatus if doStep was pending
+ * @return fmi2Status The status of the step, fmi2Discard if the slave refused it
+ */
+static fmi2Status finishCoSimulationStep(FMU *fmu, SimulationState *state, double tNext, fmi2Status status) {
+    if (status == fmi2Discard) {
+        fmi2Boolean terminated = fmi2False;
+        if (fmu->getBooleanStatus(state->component, fmi2Terminated, &terminated) > fmi2Warning || !terminated ||
+            fmu->getRealStatus(state->component, fmi2LastSuccessfulTime, &state->time) > fmi2Warning) {
+            return fmi2Discard;
+        }
+        state->eventInfo.terminateSimulation = fmi2True;
+    } else if (status > fmi2Warning) {
+        return status;
+    } else {
+        state->time = tNext;
+    }
+
+    fmi2Status fmi2Flag = recordResults(fmu, state->component, &state->output);
+    if (fmi2Flag > fmi2Warning) return fmi2Flag;
+    state->nSteps++;
+    return fmi2OK;
+}
+
+/**
+ * @struct SystemRun
+ * @brief Threads stepping the components of a system over each communication step.
+ *
+ * The threads live for the whole run. The master releases them at each communication point
+ * through the start barrier, they take the components one at a time from a shared index, then
+ * meet the master at the done barrier before the connections are exchanged. The master steps
+ * components too.
+ */
+typedef struct {
+    FMU *fmu;
+    System *system;
+    SimulationState **states;
+    int nThreads;                    // including the master
+    pthread_barrier_t start;
+    pthread_barrier_t done;
+    pthread_mutex_t mutex;
+    int next;                        // next component to step
+    double tNext;                    // end of the communication step
+    int stop;                        // the run is over, the threads return
+    int failed;                      // component which failed, -1 if none
+    int *nextPending;                // links the pending slaves of each thread, -1 ends a list
+} SystemRun;
+
+static void failComponent(SystemRun *run, int c) {
+    pthread_mutex_lock(&run->mutex);
+    run->failed = c;
+    pthread_mutex_unlock(&run->mutex);
+}
+
+/**
+ * @brief Steps the components taken by the thread.
+ *
+ * A slave whose doStep returns fmi2Pending computes in the background while the thread starts
+ * the next components and records the outputs of those which are done. Its status is polled
+ * with getStatus once no component is left, the only call FMI allows on it until then.
+ */
+static void stepComponents(SystemRun *run) {
+    int pending = -1;                // first pending slave of this thread
+    size_t nPending = 0, nPolls = 0;
+    for (;;) {
+        pthread_mutex_lock(&run->mutex);
+        int c = run->next++;
+        pthread_mutex_unlock(&run->mutex);
+        if (c >= run->system->nComponents) break;
+
+        SimulationState *state = run->states[c];
+        if (state->type == fmi2CoSimulation) {
+            if (state->eventInfo.terminateSimulation) continue;
+            fmi2Status status = setInputDerivatives(run->system, run->fmu, state->component, c);
+            if (status <= fmi2Warning) {
+                // An adaptive step may be rejected, the slave must keep what setFMUstate needs to roll back
+                fmi2Boolean noRollback = run->system->tolerance > 0 ? fmi2False : fmi2True;
+                status = run->fmu->doStep(state->component, state->time, run->tNext - state->time, noRollback);
+            }
+            if (status == fmi2Pending) {
+                run->nextPending[c] = pending;
+                pending = c;
+                nPending++;
+            } else if (finishCoSimulationStep(run->fmu, state, run->tNext, status) > fmi2Warning) {
+                failComponent(run, c);
+            }
+            continue;
+        }
+
+        state->tEnd = run->tNext;
+        while (state->time < run->tNext && !state->eventInfo.terminateSimulation) {
+            if (extrapolateInputs(run->system, run->fmu, state->component, c, state->time) > fmi2Warning ||
+                simulationDoStep(run->fmu, state) > fmi2Warning) {
+                failComponent(run, c);
+                break;
+            }
+        }
+    }
+
+    // The slaves left compute on their own, sleep briefly between the rounds where none is done
+    while (pending >= 0) {
+        int completed = 0;
+        for (int *link = &pending; *link >= 0;) {
+            int c = *link;
+            fmi2Status status;
+            nPolls++;
+            if (run->fmu->getStatus(run->states[c]->component, fmi2DoStepStatus, &status) > fmi2Warning) {
+                status = fmi2Error;
+            }
+            if (status == fmi2Pending) {
+                link = &run->nextPending[c];
+                continue;
+            }
+            *link = run->nextPending[c];
+            completed = 1;
+            if (finishCoSimulationStep(run->fmu, run->states[c], run->tNext, status) > fmi2Warning) {
+                failComponent(run, c);
+            }
+        }
+        if (!completed && pending >= 0) {
+            struct timespec pause = {0, STATUS_POLL_INTERVAL};
+            nanosleep(&pause, NULL);
+        }
+    }
+    if (nPending > 0) {
+        pthread_mutex_lock(&run->mutex);
+        run->system->nPendingSteps += nPending;
+        run->system->nStatusPolls += nPolls;
+        pthread_mutex_unlock(&run->mutex);
+    }
+}
+
+static void* systemWorker(void *arg) {
+    SystemRun *run = (SystemRun*)arg;
+    pthread_mutex_lock(&run->mutex);
+    pthread_mutex_unlock(&run->mutex);
+    for (;;) {
+        pthread_barrier_wait(&run->start);
+        if (run->stop) return NULL;
+        stepComponents(run);
+        pthread_barrier_wait(&run->done);
+    }
+}
+
+/**
+ * @struct ComponentSnapshot
+ * @brief State of a component at a communication point, restored when the step is rejected.
+ */
+typedef struct {
+    fmi2FMUstate fmuState;           // reused from one communication point to the next
+    double time;
+    fmi2EventInfo eventInfo;
+    double *z;
+    size_t nRows;                    // recorded rows, the rows of a rejected step are dropped
+    int nSteps;
+    int nTimeEvents;
+    int nStateEvents;
+    int nStepEvents;
+} ComponentSnapshot;
+
+static fmi2Status saveComponent(FMU *fmu, SimulationState *state, ComponentSnapshot *snapshot) {
+    if (!snapshot->z) {
+        snapshot->z = (double*)malloc((state->nz + 1) * sizeof(double));
+        if (!snapshot->z) return fmi2Error;
+    }
+    memcpy(snapshot->z, state->z, state->nz * sizeof(double));
+    snapshot->time = state->time;
+    snapshot->eventInfo = state->eventInfo;
+    snapshot->nRows = state->output.nRows;
+    snapshot->nSteps = state->nSteps;
+    snapshot->nTimeEvents = state->nTimeEvents;
+    snapshot->nStateEvents = state->nStateEvents;
+    snapshot->nStepEvents = state->nStepEvents;
+    return fmu->getFMUstate(state->component, &snapshot->fmuState);
+}
+
+static fmi2Status restoreComponent(FMU *fmu, SimulationState *state, const ComponentSnapshot *snapshot) {
+    memcpy(state->z, snapshot->z, state->nz * sizeof(double));
+    state->time = snapshot->time;
+    state->eventInfo = snapshot->eventInfo;
+    state->output.nRows = snapshot->nRows;
+    state->nSteps = snapshot->nSteps;
+    state->nTimeEvents = snapshot->nTimeEvents;
+    state->nStateEvents = snapshot->nStateEvents;
+    state->nStepEvents = snapshot->nStepEvents;
+    return fmu->setFMUstate(state->component, snapshot->fmuState);
+}
+
+/**
+ * @brief Runs the components of a system, exchanging the connected variables at each communication point.
+ *
+ * Jacobi scheme: at each communication point the outputs of all the components are copied to the
+ * connected inputs, then all the components are advanced concurrently over the communication
+ * step H with their own steps h, the inputs being held or extrapolated before each step.
+ *
+ * With a coupling tolerance, H adapts to the coupling error: the components are saved with
+ * getFMUstate at each communication point, and restored with setFMUstate to retry a rejected
+ * step with a shorter H. H stays between h and 100 times its initial value. The results of each
+ * component are printed after the run.
+ *
+ * Co-simulation slaves are advanced by one doStep per communication step. Those which compute
+ * asynchronously, doStep returning fmi2Pending, are polled with getStatus while the thread steps
+ * the other components and records their outputs.
+ *
+ * @return 0 on success, -1 if a component fails.
+ */
+int simulateSystem(FMU *fmu, System *system, double tStart, double tEnd, double h, double H, double tolerance,
+                   int csv, char sep) {
+    int n = system->nComponents, result = -1;
+    SimulationState **states = (SimulationState**)calloc(n, sizeof(SimulationState*));
+    fmi2Component *instances = (fmi2Component*)malloc(n * sizeof(fmi2Component));
+    ComponentSnapshot *snapshots = (ComponentSnapshot*)calloc(n, sizeof(ComponentSnapshot));
+    int *nextPending = (int*)malloc(n * sizeof(int));
+    if (!states || !instances || !snapshots || !nextPending) goto done;
+    if (system->coSimulation && (!model.coSimulation || !fmu->doStep || !fmu->getStatus ||
+                                 !fmu->getRealStatus || !fmu->getBooleanStatus)) {
+        printf("The model has no co-simulation interface\n");
+        goto done;
+    }
+    // The components are instances of the same model in this process
+    if (n > 1 && (system->coSimulation ? model.csCanBeInstantiatedOnlyOncePerProcess
+                                       : model.canBeInstantiatedOnlyOncePerProcess)) {
+        printf("The model can be instantiated only once per process, the system needs %d components\n", n);
+        goto done;
+    }
+    // The capabilities of the slaves are those of <CoSimulation>, not of <ModelExchange>
+    int adaptive = system->tolerance > 0;
+    int canSaveState = system->coSimulation ? model.csCanGetAndSetFMUstate : model.canGetAndSetFMUstate;
+    if (adaptive && !canSaveState) {
+        printf("The model cannot save its state, the communication step stays fixed\n");
+        adaptive = 0;
+    }
+    if (adaptive && system->coSimulation && !model.csCanHandleVariableCommunicationStepSize) {
+        printf("The model cannot vary its communication step, the communication step stays fixed\n");
+        adaptive = 0;
+    }
+    // A slave holds its inputs over the step unless it can take their derivatives
+    if (system->inputOrder > 0 && system->coSimulation && (!model.csCanInterpolateInputs || !fmu->setRealInputDerivatives)) {
+        printf("The model cannot interpolate its inputs, the inputs are held\n");
+        system->inputOrder = 0;
+    }
+    for (int c = 0; c < n; c++) {
+        states[c] = initializeSimulation(fmu, tStart, tEnd, h, tolerance, &system->components[c].parameters, NULL,
+                                         system->coSimulation ? fmi2CoSimulation : fmi2ModelExchange);
+        if (!states[c]) {
+            printf("Failed to initialize component %s\n", system->components[c].name);
+            goto done;
+        }
+        instances[c] = states[c]->component;
+    }
+
+    SystemRun run = {fmu, system, states, min(min(n, system->maxThreads), 64)};
+    run.failed = -1;
+    run.nextPending = nextPending;
+    pthread_t threads[64];
+    int started = 0;
+    pthread_mutex_init(&run.mutex, NULL);
+
+    // The threads wait for the mutex until the barriers count the ones which could be started
+    pthread_mutex_lock(&run.mutex);
+    while (started < run.nThreads - 1 && pthread_create(&threads[started], NULL, systemWorker, &run) == 0) started++;
+    run.nThreads = started + 1;
+    pthread_barrier_init(&run.start, NULL, run.nThreads);
+    pthread_barrier_init(&run.done, NULL, run.nThreads);
+    pthread_mutex_unlock(&run.mutex);
+
+    // Fixed communication points are computed from tStart, they do not drift
+    int terminated = 0;
+    double maxH = 100 * H;
+    for (long k = 1; !terminated && states[0]->time < tEnd; k++) {
+        double time = states[0]->time;
+        if (propagateConnections(system, fmu, instances, time) > fmi2Warning) {
+            printf("Failed to exchange the connections at time %g\n", time);
+            goto stop;
+        }
+        for (int c = 0; adaptive && c < n; c++) {
+            if (saveComponent(fmu, states[c], &snapshots[c]) > fmi2Warning) {
+                printf("Failed to save component %s at time %g\n", system->components[c].name, time);
+                goto stop;
+            }
+        }
+
+        for (int rejected = 0;; rejected = 1) {
+            run.tNext = adaptive ? min(time + H, tEnd) : min(tStart + k * H, tEnd);
+            run.next = 0;
+            pthread_barrier_wait(&run.start);
+            stepComponents(&run);
+            pthread_barrier_wait(&run.done);
+
+            if (run.failed >= 0) {
+                printf("Component %s failed at time %g\n", system->components[run.failed].name,
+                       states[run.failed]->time);
+                goto stop;
+            }
+            if (!adaptive) break;
+
+            // Step size control on the coupling error, of order inputOrder + 1 in H
+            double used = run.tNext - time, error;
+            if (couplingError(system, fmu, instances, used, &error) > fmi2Warning) goto stop;
+            // No growth right after a rejection, the error estimate was just wrong
+            double factor = error > 0 ? 0.9 * pow(error, -1.0 / (system->inputOrder + 1)) : 2;
+            factor = factor < 0.2 ? 0.2 : factor > (rejected ? 1 : 2) ? (rejected ? 1 : 2) : factor;
+            if (error <= 1 || used <= h * (1 + 1e-9)) {
+                system->nAccepted++;
+                if (run.tNext < tEnd) H = min(max(used * factor, h), maxH);
+                break;
+            }
+            system->nRejected++;
+            H = max(used * factor, h);
+            for (int c = 0; c < n; c++) {
+                if (restoreComponent(fmu, states[c], &snapshots[c]) > fmi2Warning) {
+                    printf("Failed to restore component %s at time %g\n", system->components[c].name, time);
+                    goto stop;
+                }
+            }
+        }
+        for (int c = 0; c < n; c++) terminated = terminated || states[c]->eventInfo.terminateSimulation;
+    }
+
+    for (int c = 0; c < n; c++) {
+        printf("# %s\n", system->components[c].name);
+        if (csv) {
+            printCsv(states[c], sep);
+        } else {
+            printOutput(states[c]);
+        }
+    }
+    if (adaptive) {
+        printf("Communication steps: %zu accepted, %zu rejected\n", system->nAccepted, system->nRejected);
+    }
+    if (system->nPendingSteps > 0) {
+        printf("Asynchronous steps: %zu pending, %zu status polls\n", system->nPendingSteps, system->nStatusPolls);
+    }
+    if (system->nLoops > 0) {
+        printf("Algebraic loops: %zu Newton iterations, %zu communication points not converged\n",
+               system->nLoopIterations, system->nLoopFailures);
+    }
+    result = 0;
+
+stop:
+    run.stop = 1;
+    if (started > 0) pthread_barrier_wait(&run.start);
+    for (int t = 0; t < started; t++) pthread_join(threads[t], NULL);
+    pthread_barrier_destroy(&run.start);
+    pthread_barrier_destroy(&run.done);
+    pthread_mutex_destroy(&run.mutex);
+
+done:
+    for (int c = 0; states && c < n; c++) {
+        if (snapshots && snapshots[c].fmuState) fmu->freeFMUstate(states[c]->component, &snapshots[c].fmuState);
+        if (snapshots) free(snapshots[c].z);
+        if (states[c]) cleanupSimulation(fmu, states[c]);
+    }
+    free(snapshots);
+    free(nextPending);
+    free(states);
+    free(instances);
+    return result;
+}
+
 /**
  * @brief Main function to initialize and run the simulation.
  *
@@ -464,64 +1154,433 @@ void printCsv(SimulationState *state, char sep) {
  */
 int main(int argc, char *argv[]) {
 
-    double tStart;
-    double tEnd;
-    double h;
+    // Defaults come from the <DefaultExperiment> of modelDescription.xml
+    double tStart = model.startTime;
+    double tEnd = model.stopTime;
+    double h = model.stepSize;
+    double tolerance = model.toleranceDefined ? model.tolerance : 0;
     int csv = 0;
     char sep = ',';
+    int nPositional = 0;
+    ParameterOverrides overrides = {0};
+    Transforms transforms = {0};
+    Monitors monitors = {0};
+    Inputs inputs = {0};
+    RealTime realTime = {0, 1, 0, 0, -1};
+    Exchange exchange = {0};
+    const char *exchangeName = NULL;
+    const char *systemFile = NULL;
+    double communicationStep = 0;
+    int systemThreads = 0;
+    int inputOrder = 0;
+    double couplingTolerance = 0;
+    int coSimulation = 0;
+    const char *inputFile = NULL;
+    int displayUnits = 0;
+    Linearization linearization = {0};
+    linearization.prefix = "linearization";
+    linearization.logger = fmuLogger;
+    Trim trim = {0};
+    Sensitivities sensitivities = {0};
+    Adjoint adjoint = {0};
+    adjoint.cost = -1;
+    adjoint.output = "gradient.csv";
+    Calibration calibration = {0};
+    calibration.output = "calibrated.txt";
+    const char *measurements = NULL;
+    FrequencyResponse frequencyResponse = {0};
+    frequencyResponse.output = "frequency_response.csv";
 
 	// Liste des paramètres à récupérer
-	// tStart, tEnd, h, --csv, sep
-
-	// Validate minimum number of arguments
-    if (argc < 4) {
-        printf("Usage: %s tStart tEnd h [--csv separator]\n", argv[0]);
-        return -1;
-    }
-
-    // Handle optional CSV arguments
-    if (argc >= 5) {
-        if (strcmp(argv[4], "--csv") == 0) {
+	// [tStart [tEnd [h]]], --tolerance tol, --set name=value, --params file, --inputs file,
+	// --input-interpolation linear|hold, --realtime [scale], --realtime-lock, --realtime-priority p,
+	// --realtime-cpu n, --shm name, --ssp file, --communication-step H,
+	// --system-threads n, --input-order 0|1|2, --coupling-tolerance tol, --co-simulation,
+	// --derive name=expr, --monitor cond,
+	// --display-units, --linearize t1[,t2...], --linearize-output prefix, --trim, --trim-free input,
+	// --trim-fix state, --sensitivity parameter, --adjoint cost, --adjoint-output file,
+	// --calibrate parameter, --data file, --calibrate-method method, --calibrate-output file,
+	// --frequency-response fmin,fmax,n, --frequency-method method, --frequency-output file, --csv [sep]
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--csv") == 0) {
             csv = 1;
             // Check if a separator is provided
-            if (argc == 6) {
-                sep = argv[5][0];  // Use the first character of the separator
+            if (i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0) {
+                sep = argv[++i][0];  // Use the first character of the separator
+            }
+        } else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+            tolerance = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--set") == 0 && i + 1 < argc) {
+            if (addParameterOverride(&overrides, argv[++i]) != 0) {
+                printf("Invalid assignment '%s', expected name=value\n", argv[i]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--params") == 0 && i + 1 < argc) {
+            if (loadParameterFile(&overrides, argv[++i]) != 0) return -1;
+        } else if (strcmp(argv[i], "--inputs") == 0 && i + 1 < argc) {
+            inputFile = argv[++i];
+        } else if (strcmp(argv[i], "--input-interpolation") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "linear") == 0) {
+                inputs.interpolation = INPUT_LINEAR;
+            } else if (strcmp(argv[i], "hold") == 0) {
+                inputs.interpolation = INPUT_HOLD;
+            } else {
+                printf("Invalid interpolation '%s', expected linear or hold\n", argv[i]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--realtime") == 0) {
+            realTime.enabled = 1;
+            // Check if a speed factor is provided
+            if (i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0) {
+                realTime.scale = atof(argv[++i]);
+            }
+        } else if (strcmp(argv[i], "--realtime-lock") == 0) {
+            realTime.lockMemory = 1;
+        } else if (strcmp(argv[i], "--realtime-priority") == 0 && i + 1 < argc) {
+            realTime.priority = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--realtime-cpu") == 0 && i + 1 < argc) {
+            realTime.cpu = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--shm") == 0 && i + 1 < argc) {
+            exchangeName = argv[++i];
+        } else if (strcmp(argv[i], "--ssp") == 0 && i + 1 < argc) {
+            systemFile = argv[++i];
+        } else if (strcmp(argv[i], "--communication-step") == 0 && i + 1 < argc) {
+            communicationStep = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--system-threads") == 0 && i + 1 < argc) {
+            systemThreads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--co-simulation") == 0) {
+            coSimulation = 1;
+        } else if (strcmp(argv[i], "--coupling-tolerance") == 0 && i + 1 < argc) {
+            couplingTolerance = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--input-order") == 0 && i + 1 < argc) {
+            inputOrder = atoi(argv[++i]);
+            if (inputOrder < 0 || inputOrder > 2) {
+                printf("Invalid input order %d, expected 0, 1 or 2\n", inputOrder);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--derive") == 0 && i + 1 < argc) {
+            if (addDerivedSignal(&transforms, argv[++i], get_variable_list()) != 0) {
+                printf("Invalid derived signal '%s', expected name=expression\n", argv[i]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--monitor") == 0 && i + 1 < argc) {
+            if (addMonitor(&monitors, argv[++i], get_variable_list()) != 0) {
+                printf("Invalid monitor '%s', expected [log:|flag:|terminate:]condition\n", argv[i]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--display-units") == 0) {
+            displayUnits = 1;
+        } else if (strcmp(argv[i], "--linearize") == 0 && i + 1 < argc) {
+            if (addLinearizationTimes(&linearization, argv[++i]) != 0) {
+                printf("Invalid operating points '%s', expected increasing times t1,t2,...\n", argv[i]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--linearize-output") == 0 && i + 1 < argc) {
+            linearization.prefix = argv[++i];
+        } else if (strcmp(argv[i], "--trim") == 0) {
+            trim.enabled = 1;
+        } else if (strcmp(argv[i], "--trim-free") == 0 && i + 1 < argc) {
+            if (addTrimFreeInput(&trim, argv[++i], get_variable_list()) != 0) {
+                printf("Invalid trim input '%s', expected a Real input\n", argv[i]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--trim-fix") == 0 && i + 1 < argc) {
+            if (addTrimFixedState(&trim, argv[++i]) != 0) {
+                printf("Invalid trim state '%s', expected a continuous state\n", argv[i]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--sensitivity") == 0 && i + 1 < argc) {
+            if (addSensitivityParameter(&sensitivities, argv[++i], get_variable_list()) != 0) {
+                printf("Invalid sensitivity parameter '%s', expected a Real parameter, input or state\n", argv[i]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--adjoint") == 0 && i + 1 < argc) {
+            if (setAdjointCost(&adjoint, argv[++i], get_variable_list()) != 0) {
+                printf("Invalid adjoint cost '%s', expected a Real output or state\n", argv[i]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--adjoint-output") == 0 && i + 1 < argc) {
+            adjoint.output = argv[++i];
+        } else if (strcmp(argv[i], "--calibrate") == 0 && i + 1 < argc) {
+            if (addCalibrationParameter(&calibration, argv[++i], get_variable_list()) != 0) {
+                printf("Invalid calibration parameter '%s', expected a Real parameter or start value\n", argv[i]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--data") == 0 && i + 1 < argc) {
+            measurements = argv[++i];
+        } else if (strcmp(argv[i], "--calibrate-method") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "lm") == 0) {
+                calibration.method = CALIBRATE_LM;
+            } else if (strcmp(argv[i], "lm-sensitivity") == 0) {
+                calibration.method = CALIBRATE_LM_SENSITIVITY;
+            } else if (strcmp(argv[i], "nelder-mead") == 0) {
+                calibration.method = CALIBRATE_NELDER_MEAD;
+            } else {
+                printf("Invalid calibration method '%s', expected lm, lm-sensitivity or nelder-mead\n", argv[i]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--calibrate-output") == 0 && i + 1 < argc) {
+            calibration.output = argv[++i];
+        } else if (strcmp(argv[i], "--frequency-response") == 0 && i + 1 < argc) {
+            if (setFrequencyGrid(&frequencyResponse, argv[++i]) != 0) {
+                printf("Invalid frequency grid '%s', expected fmin,fmax,n in Hz\n", argv[i]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--frequency-method") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "linear") == 0) {
+                frequencyResponse.method = FREQUENCY_LINEAR;
+            } else if (strcmp(argv[i], "multisine") == 0) {
+                frequencyResponse.method = FREQUENCY_MULTISINE;
+            } else {
+                printf("Invalid frequency method '%s', expected linear or multisine\n", argv[i]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--frequency-output") == 0 && i + 1 < argc) {
+            frequencyResponse.output = argv[++i];
+        } else if (strncmp(argv[i], "--", 2) != 0 && nPositional < 3) {
+            // Simulation parameters
+            switch (nPositional++) {
+                case 0: tStart = atof(argv[i]); break;
+                case 1: tEnd = atof(argv[i]); break;
+                case 2: h = atof(argv[i]); break;
             }
         } else {
-            // Invalid argument after the required three
-            printf("Usage: %s tStart tEnd h [--csv separator]\n", argv[0]);
+            printf("Usage: %s [tStart [tEnd [h]]] [--tolerance tol] [--set name=value]... [--params file]"
+                   " [--inputs file] [--input-interpolation linear|hold] [--realtime [scale]] [--realtime-lock]"
+                   " [--realtime-priority p] [--realtime-cpu n] [--shm name] [--ssp file] [--communication-step H]"
+                   " [--system-threads n] [--input-order 0|1|2]"
+                   " [--coupling-tolerance tol] [--co-simulation]"
+                   " [--derive name=expression]... [--monitor [action:]condition]... [--display-units]"
+                   " [--linearize t1[,t2...]]"
+                   " [--linearize-output prefix] [--trim] [--trim-free input]... [--trim-fix state]..."
+                   " [--sensitivity parameter]... [--adjoint cost]"
+                   " [--adjoint-output file] [--calibrate parameter]... [--data file]"
+                   " [--calibrate-method lm|lm-sensitivity|nelder-mead] [--calibrate-output file]"
+                   " [--frequency-response fmin,fmax,n] [--frequency-method linear|multisine]"
+                   " [--frequency-output file] [--csv [separator]]\n", argv[0]);
             return -1;
         }
     }
 
-    INFO("tStart: %s, tEnd: %s, h: %s\n", argv[1], argv[2], argv[3]);
+    INFO("tStart: %g, tEnd: %g, h: %g, tolerance: %g\n", tStart, tEnd, h, tolerance);
     if (csv) {
         INFO("CSV Mode enabled with separator: '%c'\n", sep);
     }
     
+    if (h <= 0 || tEnd < tStart) {
+        printf("Invalid experiment: tStart=%g tEnd=%g h=%g\n", tStart, tEnd, h);
+        return -1;
+    }
+
+    if (inputFile && loadInputs(&inputs, inputFile, get_variable_list()) != 0) {
+        freeInputs(&inputs);
+        return -1;
+    }
+
+    // Frequency responses are computed at tStart, or at the operating points if there are some
+    if (frequencyResponse.nFrequencies > 0) {
+        if (initFrequencyResponse(&frequencyResponse, get_variable_list(), get_variable_count(), h) != 0) {
+            printf("Failed to set up the frequency response\n");
+            return -1;
+        }
+        if (frequencyResponse.method == FREQUENCY_LINEAR) {
+            char start[32];
+            snprintf(start, sizeof(start), "%.17g", tStart);
+            if (linearization.nTimes == 0 && addLinearizationTimes(&linearization, start) != 0) return -1;
+            linearization.response = &frequencyResponse;
+        }
+    }
 
-    // Simulation parameters
-    tStart = atof(argv[1]);
-    tEnd = atof(argv[2]);
-    h = atof(argv[3]);
+    if (linearization.nTimes > 0 &&
+        (linearization.times[0] < tStart || linearization.times[linearization.nTimes - 1] > tEnd)) {
+        printf("Operating points must be between tStart=%g and tEnd=%g\n", tStart, tEnd);
+        return -1;
+    }
+    if (linearization.nTimes > 0 && initLinearization(&linearization, get_variable_list(), get_variable_count()) != 0) {
+        printf("Failed to build the linearization pattern\n");
+        return -1;
+    }
+
+    if (trim.enabled && initTrim(&trim, get_variable_list(), get_variable_count()) != 0) {
+        printf("Failed to set up the trim\n");
+        return -1;
+    }
+
+    if (adjoint.cost >= 0 &&
+        initAdjoint(&adjoint, get_variable_list(), get_variable_count(), (int)((tEnd - tStart) / h) + 1) != 0) {
+        printf("Failed to set up the adjoint\n");
+        return -1;
+    }
+
+    if (calibration.nParameters > 0 &&
+        (!measurements || initCalibration(&calibration, measurements, get_variable_list(), &overrides) != 0)) {
+        printf("Failed to set up the calibration, it needs --data with measurements\n");
+        return -1;
+    }
+    if (calibration.nParameters > 0 && calibration.data.times[0] < tStart) {
+        printf("Measurements must start after tStart=%g\n", tStart);
+        return -1;
+    }
+
+    if (displayUnits && addDisplayUnits(&transforms, get_variable_list(), get_variable_count()) != 0) {
+        return -1;
+    }
 
 	loadFunctions(&fmu);
 
+    // A system runs its own instances, the analyses of a single run do not apply to it
+    if (systemFile) {
+        System system = {0};
+        system.maxThreads = systemThreads;
+        system.inputOrder = inputOrder;
+        system.tolerance = couplingTolerance;
+        system.coSimulation = coSimulation;
+        int result = loadSystem(&system, systemFile, get_variable_list(), &overrides);
+        if (result == 0) {
+            result = simulateSystem(&fmu, &system, tStart, tEnd, h, communicationStep > 0 ? communicationStep : h,
+                                    tolerance, csv, sep);
+        }
+        freeSystem(&system);
+        freeParameterOverrides(&overrides);
+        return result;
+    }
+
+    // Fit the parameters first, the simulation then runs with the fitted values
+    if (calibration.nParameters > 0) {
+        CalibrationRun run = {&fmu, tStart, h, tolerance, &overrides, inputFile ? &inputs : NULL, &calibration};
+        calibration.sample = sampleCandidate;
+        calibration.context = &run;
+        if (runCalibration(&calibration) > fmi2Warning || writeCalibration(&calibration) != 0) {
+            printf("Calibration failed\n");
+            freeCalibration(&calibration);
+            return -1;
+        }
+        for (int j = 0; j < calibration.nParameters; j++) {
+            if (addRealOverride(&overrides, variable_names[calibration.parameters[j]], calibration.values[j]) != 0) {
+                printf("Failed to apply the calibrated value of %s\n", variable_names[calibration.parameters[j]]);
+                freeCalibration(&calibration);
+                return -1;
+            }
+        }
+    }
+
+    // Multi-sine simulations around the initial point, with the user and fitted values
+    if (frequencyResponse.method == FREQUENCY_MULTISINE && frequencyResponse.nFrequencies > 0) {
+        ExcitationRun run = {&fmu, tStart, tolerance, &overrides};
+        frequencyResponse.simulate = simulateExcitation;
+        frequencyResponse.context = &run;
+        if (runMultisine(&frequencyResponse) > fmi2Warning) {
+            printf("Failed to compute the frequency response\n");
+            freeFrequencyResponse(&frequencyResponse);
+            freeCalibration(&calibration);
+            return -1;
+        }
+    }
+
 	// Initialize the simulation
-	SimulationState *state = initializeSimulation(&fmu, tStart, tEnd, h);
+	SimulationState *state = initializeSimulation(&fmu, tStart, tEnd, h, tolerance, &overrides,
+                                                  inputFile ? &inputs : NULL, fmi2ModelExchange);
 	if (!state) {
 		printf("Failed to initialize simulation\n");
 		return -1;
 	}
 
-	// Run the simulation step by step
-	while (state->time < state->tEnd && !state->eventInfo.terminateSimulation) {
+    // Start from the steady state, it replaces the recorded initial values
+    if (trim.enabled) {
+        if (trimSteadyState(&fmu, state->component, &trim, h) > fmi2Warning) {
+            printf("Failed to find a steady state\n");
+            cleanupSimulation(&fmu, state);
+            return -1;
+        }
+        state->output.nRows = 0;
+        if (recordResults(&fmu, state->component, &state->output) > fmi2Warning) {
+            printf("Failed to record the steady state\n");
+            cleanupSimulation(&fmu, state);
+            return -1;
+        }
+    }
+    if (transforms.nSignals > 0 || transforms.nScaled > 0) {
+        state->transforms = &transforms;
+    }
+
+    // Monitors are checked on the initial row too, a run may be doomed from the start
+    if (monitors.nMonitors > 0) {
+        int terminate = checkMonitors(&monitors, &state->output, state->variables, state->time);
+        if (terminate < 0) {
+            cleanupSimulation(&fmu, state);
+            return -1;
+        }
+        if (terminate) state->eventInfo.terminateSimulation = fmi2True;
+        state->monitors = &monitors;
+    }
+
+    // Sensitivities start from the initial point, with the rows of the results
+    if (sensitivities.nParameters > 0) {
+        if (initSensitivities(&sensitivities, state->variables, state->output.capacity) != 0 ||
+            recordSensitivities(&fmu, state->component, &sensitivities) > fmi2Warning) {
+            printf("Failed to initialize the sensitivities\n");
+            cleanupSimulation(&fmu, state);
+            return -1;
+        }
+        state->sensitivities = &sensitivities;
+    }
+
+    // The rig sees the region once the instance is initialized
+    if (exchangeName) {
+        if (openExchange(&exchange, exchangeName, &fmu, state->component, state->variables, state->nVariables) != 0) {
+            closeExchange(&exchange);
+            cleanupSimulation(&fmu, state);
+            return -1;
+        }
+        state->exchange = &exchange;
+    }
+
+    // Everything before is set up off the clock, the pacing starts at the first step
+    if (realTime.enabled) startRealTime(&realTime, state->time);
+
+	// Run the simulation step by step, the steps are shortened to stop exactly at the operating points
+    int linearizationFailed = 0;
+	while (!state->eventInfo.terminateSimulation) {
+        while (linearization.next < linearization.nTimes && linearization.times[linearization.next] <= state->time) {
+            if (linearizeAt(&fmu, state->component, &linearization, state->time, tolerance) != 0) {
+                linearizationFailed = 1;
+            }
+        }
+        if (state->time >= tEnd) break;
+
+        state->tEnd = linearization.next < linearization.nTimes ? min(linearization.times[linearization.next], tEnd) : tEnd;
+        if (adjoint.cost >= 0 &&
+            addAdjointStep(&fmu, state->component, &adjoint, state->tEnd, state->time, &state->eventInfo,
+                           state->z, state->nz) > fmi2Warning) {
+            printf("Failed to save a checkpoint at time %g\n", state->time);
+            adjoint.cost = -1;
+        }
 		fmi2Status status = simulationDoStep(&fmu, state);
 		if (status > fmi2Warning) {
 			printf("Simulation step failed at time %g\n", state->time);
 			break;
 		}
+        if (realTime.enabled) waitRealTime(&realTime, state->time);
 	}
+    state->tEnd = tEnd;
+    if (finishLinearization(&linearization) != 0) linearizationFailed = 1;
+    if (linearizationFailed) printf("Some linearizations failed\n");
+
+    // Backward pass over the checkpoints of the run
+    if (adjoint.cost >= 0) {
+        if (computeGradient(&fmu, state, &adjoint) > fmi2Warning || writeGradient(&adjoint) != 0) {
+            printf("Failed to compute the gradient of %s\n", variable_names[adjoint.cost]);
+        }
+    }
+
+    // Transform the rows of the last incomplete block
+    if (state->transforms && applyTransforms(state->transforms, &state->output, state->variables, 1) != 0) {
+        printf("Failed to transform the results\n");
+        state->transforms = NULL;
+    }
 
     // Print the output
     if (csv) {
@@ -529,9 +1588,26 @@ int main(int argc, char *argv[]) {
     } else {
         printOutput(state);
     }
+    reportMonitors(&monitors, state->time);
+    if (realTime.enabled) reportRealTime(&realTime, h);
+    int flagged = monitors.flagged || realTime.nOverruns > 0;
 
 	// Cleanup and free resources
 	cleanupSimulation(&fmu, state);
-
-    return 0;
-}
\ No newline at end of file
+    closeExchange(&exchange);
+    freeParameterOverrides(&overrides);
+    freeTransforms(&transforms);
+    freeMonitors(&monitors);
+    freeLinearization(&linearization);
+    freeTrim(&trim);
+    freeSensitivities(&sensitivities);
+    freeAdjoint(&adjoint);
+    freeCalibration(&calibration);
+    freeInputs(&inputs);
+    freeFrequencyResponse(&frequencyResponse);
+
+    // A failed operating point is an error, as a failed trim. A run flagged by a monitor or late
+    // in real time fails, so that batch scripts can skip it
+    if (linearizationFailed) return -1;
+    return flagged ? 1 : 0;
+}
\ No newline at end of file
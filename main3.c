@@ -0,0 +1,463 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+// Headers from the FMI standard
+#include "headers/fmi3PlatformTypes.h"
+#include "headers/fmi3FunctionTypes.h"
+#include "headers/fmi3Functions.h"
+
+// Headers from the FMU file
+#include "fmu/sources/config.h"
+#include "fmu/sources/model.h"
+
+// Other necessary files
+#include "fmi3.c"
+#include "modelDescription.c"
+
+
+// If DEBUG is defined, INFO will print messages to the console
+#ifndef DEBUG
+#define INFO(message, ...)
+#else
+#define INFO(message, ...) do { \
+	char buffer[256]; \
+	snprintf(buffer, sizeof(buffer), message, ##__VA_ARGS__); \
+	printf("%s", buffer); \
+} while (0)
+#endif
+
+// Minimum macro
+#define min(a,b) ((a)>(b) ? (b) : (a))
+
+// Simulation modules, included after the macros above which they use
+#include "results3.c"
+
+// Structure to hold the simulation state of an FMI 3.0 Model Exchange FMU
+typedef struct {
+    fmi3Instance instance;
+    int nx;                          // number of state variables (array elements included)
+    int nz;                          // number of state event indicators
+    double *x;                       // continuous states
+    double *xdot;                    // derivatives
+    double *z;                       // state event indicators
+    double *prez;                    // previous state event indicators
+    double time;                     // current simulation time
+    double h;                        // step size
+    double tStart;                   // start time
+    double tEnd;                     // end time
+    double tolerance;                // relative tolerance (<= 0 if undefined)
+    fmi3Boolean terminateSimulation; // set by updateDiscreteStates or completedIntegratorStep
+    fmi3Boolean nextEventTimeDefined;
+    fmi3Float64 nextEventTime;
+    const ModelVariable *variables;  // model variables
+    int nVariables;                  // number of variables
+    Results output;                  // recorded values, one row per step
+    int nSteps;                      // current step count
+    int nTimeEvents;                 // number of time events
+    int nStateEvents;                // number of state events
+    int nStepEvents;                 // number of step events
+} SimulationState;
+
+// Initialize the FMU structure, which contains function pointers for FMI operations
+FMU3 fmu;
+
+/**
+ * @brief Converts an fmi3Status enum value to its corresponding string representation.
+ *
+ * @param status The fmi3Status value to be converted to a string.
+ * @return A string representing the given fmi3Status value.
+ */
+char * fmi3StatusToString(fmi3Status status) {
+	switch (status) {
+		case fmi3OK: return "OK";
+		case fmi3Warning: return "Warning";
+		case fmi3Discard: return "Discard";
+		case fmi3Error: return "Error";
+		case fmi3Fatal: return "Fatal";
+		default: return "?";
+	}
+}
+
+/**
+ * @brief Logs messages from the FMU.
+ *
+ * FMI 3.0 passes an already formatted message and no instance name, the model name is used instead.
+ *
+ * @param instanceEnvironment The instance environment (unused in this function).
+ * @param status The status of the FMU, represented as an fmi3Status enum.
+ * @param category The category of the message. If NULL, it defaults to "?".
+ * @param message The message to be logged.
+ */
+void fmuLogger(fmi3InstanceEnvironment instanceEnvironment, fmi3Status status,
+               fmi3String category, fmi3String message) {
+	if (category == NULL) category = "?";
+	printf("%s %s (%s): %s\n", fmi3StatusToString(status), model.modelName, category, message ? message : "");
+}
+
+/**
+ * @brief Frees all resources associated with the simulation state.
+ *
+ * @param fmu Pointer to the FMU3 structure
+ * @param state Pointer to the simulation state to be freed
+ */
+void cleanupSimulation(FMU3 *fmu, SimulationState *state) {
+    if (!state) return;
+
+    // Terminate the FMU
+    if (state->instance) {
+        fmu->terminate(state->instance);
+        fmu->freeInstance(state->instance);
+    }
+
+    // Free state variables
+    if (state->x) free(state->x);
+    if (state->xdot) free(state->xdot);
+    if (state->z) free(state->z);
+    if (state->prez) free(state->prez);
+
+    // Free recorded output
+    freeResults(&state->output);
+
+    // Free the state structure itself
+    free(state);
+}
+
+/**
+ * @brief Runs the event iteration of the Event Mode, then enters Continuous-Time Mode.
+ *
+ * @param fmu Pointer to the FMU3 structure
+ * @param state Pointer to the simulation state
+ * @return fmi3Status The first status worse than fmi3Warning, fmi3OK otherwise
+ */
+static fmi3Status updateDiscreteStates(FMU3 *fmu, SimulationState *state) {
+    fmi3Status fmi3Flag;
+    fmi3Boolean discreteStatesNeedUpdate = fmi3True;
+    fmi3Boolean nominalsChanged, valuesChanged;
+
+    state->terminateSimulation = fmi3False;
+    while (discreteStatesNeedUpdate && !state->terminateSimulation) {
+        fmi3Flag = fmu->updateDiscreteStates(state->instance, &discreteStatesNeedUpdate,
+                                             &state->terminateSimulation, &nominalsChanged, &valuesChanged,
+                                             &state->nextEventTimeDefined, &state->nextEventTime);
+        if (fmi3Flag > fmi3Warning) return fmi3Flag;
+    }
+
+    if (state->terminateSimulation) return fmi3OK;
+
+    return fmu->enterContinuousTimeMode(state->instance);
+}
+
+/**
+ * @brief Initializes the FMU simulation and returns a simulation state structure.
+ *
+ * @param fmu Pointer to the FMU3 structure
+ * @param tStart Start time for simulation
+ * @param tEnd End time for simulation
+ * @param h Step size
+ * @param tolerance Relative tolerance passed to enterInitializationMode, ignored if <= 0
+ * @return SimulationState* Pointer to initialized simulation state, NULL if error
+ */
+SimulationState* initializeSimulation(FMU3 *fmu, double tStart, double tEnd, double h, double tolerance) {
+    SimulationState *state = (SimulationState*)calloc(1, sizeof(SimulationState));
+    if (!state) return NULL;
+
+    state->time = tStart;
+    state->h = h;
+    state->tStart = tStart;
+    state->tEnd = tEnd;
+    state->tolerance = tolerance;
+
+    // Instantiate the FMU, the start values are applied by the FMU itself
+    state->instance = fmu->instantiateModelExchange(model.modelName, model.instantiationToken, NULL,
+                                                    fmi3False, fmi3False, NULL, fmuLogger);
+    if (!state->instance) {
+        cleanupSimulation(fmu,state);
+        return NULL;
+    }
+
+    state->variables = get_variable_list();
+    state->nVariables = get_variable_count();
+    state->nx = model.numberOfContinuousStates;
+    state->nz = model.numberOfEventIndicators;
+
+    // Allocate memory for states and indicators, sized from <ModelStructure>
+    if (state->nx > 0) {
+        state->x = (double*)calloc(state->nx, sizeof(double));
+        state->xdot = (double*)calloc(state->nx, sizeof(double));
+    }
+    if (state->nz > 0) {
+        state->z = (double*)calloc(state->nz, sizeof(double));
+        state->prez = (double*)calloc(state->nz, sizeof(double));
+    }
+
+    if ((state->nx > 0 && (!state->x || !state->xdot)) ||
+        (state->nz > 0 && (!state->z || !state->prez))) {
+        cleanupSimulation(fmu,state);
+        return NULL;
+    }
+
+    // Initialize the FMU, the experiment is given to enterInitializationMode in FMI 3.0
+    fmi3Boolean toleranceDefined = state->tolerance > 0 ? fmi3True : fmi3False;
+    fmi3Status fmi3Flag = fmu->enterInitializationMode(state->instance, toleranceDefined, state->tolerance,
+                                                       state->tStart, fmi3True, state->tEnd);
+    if (fmi3Flag > fmi3Warning) {
+        cleanupSimulation(fmu,state);
+        return NULL;
+    }
+
+    // Leaving Initialization Mode enters Event Mode
+    fmi3Flag = fmu->exitInitializationMode(state->instance);
+    if (fmi3Flag > fmi3Warning) {
+        cleanupSimulation(fmu,state);
+        return NULL;
+    }
+
+    fmi3Flag = updateDiscreteStates(fmu, state);
+    if (fmi3Flag > fmi3Warning) {
+        cleanupSimulation(fmu,state);
+        return NULL;
+    }
+
+    if (state->nz > 0) {
+        fmi3Flag = fmu->getEventIndicators(state->instance, state->z, state->nz);
+        if (fmi3Flag > fmi3Warning) {
+            cleanupSimulation(fmu,state);
+            return NULL;
+        }
+    }
+
+    // Initialize output blocks and record the initial values
+    if (initResults(&state->output, state->variables, state->nVariables,
+                    (size_t)((tEnd - tStart)/h + 10)) != 0) {
+        cleanupSimulation(fmu,state);
+        return NULL;
+    }
+    fmi3Flag = recordResults(fmu, state->instance, &state->output);
+    if (fmi3Flag > fmi3Warning) {
+        cleanupSimulation(fmu,state);
+        return NULL;
+    }
+    return state;
+}
+
+/**
+ * @brief Performs one simulation step (forward Euler) and updates the simulation state.
+ *
+ * @param fmu Pointer to the FMU3 structure
+ * @param state Pointer to the simulation state
+ * @return fmi3Status Status of the simulation step
+ */
+fmi3Status simulationDoStep(FMU3 *fmu, SimulationState *state) {
+	if (state->time >= state->tEnd || state->terminateSimulation) {
+        INFO("Simulation already terminated\n");
+		return fmi3Discard;
+    }
+
+    fmi3Status fmi3Flag;
+    double tPre = state->time;
+    double dt;
+    fmi3Boolean timeEvent, stateEvent, stepEvent, terminateSimulation;
+
+    // Get current state and derivatives
+    fmi3Flag = fmu->getContinuousStates(state->instance, state->x, state->nx);
+    if (fmi3Flag > fmi3Warning) return fmi3Flag;
+
+    fmi3Flag = fmu->getContinuousStateDerivatives(state->instance, state->xdot, state->nx);
+    if (fmi3Flag > fmi3Warning) return fmi3Flag;
+
+    // Advance time
+    state->time = min(state->time + state->h, state->tEnd);
+    timeEvent = state->nextEventTimeDefined && state->time >= state->nextEventTime;
+
+    if (timeEvent) state->time = state->nextEventTime;
+    dt = state->time - tPre;
+
+    fmi3Flag = fmu->setTime(state->instance, state->time);
+    if (fmi3Flag > fmi3Warning) return fmi3Flag;
+
+    // Perform one step (forward Euler)
+    for (int i = 0; i < state->nx; i++) {
+        state->x[i] += dt * state->xdot[i];
+    }
+
+    fmi3Flag = fmu->setContinuousStates(state->instance, state->x, state->nx);
+    if (fmi3Flag > fmi3Warning) return fmi3Flag;
+
+    // Check for state event
+    for (int i = 0; i < state->nz; i++) {
+        state->prez[i] = state->z[i];
+    }
+
+    if (state->nz > 0) {
+        fmi3Flag = fmu->getEventIndicators(state->instance, state->z, state->nz);
+        if (fmi3Flag > fmi3Warning) return fmi3Flag;
+    }
+
+    stateEvent = fmi3False;
+    for (int i = 0; i < state->nz; i++) {
+        stateEvent = stateEvent || (state->prez[i] * state->z[i] < 0);
+    }
+
+    // Check for step event
+    fmi3Flag = fmu->completedIntegratorStep(state->instance, fmi3True, &stepEvent, &terminateSimulation);
+    if (fmi3Flag > fmi3Warning) return fmi3Flag;
+
+    if (terminateSimulation) {
+        state->terminateSimulation = fmi3True;
+        return fmi3OK;
+    }
+
+    // Handle events
+    if (timeEvent || stateEvent || stepEvent) {
+        fmi3Flag = fmu->enterEventMode(state->instance);
+        if (fmi3Flag > fmi3Warning) return fmi3Flag;
+
+        if (timeEvent) state->nTimeEvents++;
+        if (stateEvent) state->nStateEvents++;
+        if (stepEvent) state->nStepEvents++;
+
+        fmi3Flag = updateDiscreteStates(fmu, state);
+        if (fmi3Flag > fmi3Warning) return fmi3Flag;
+        if (state->terminateSimulation) return fmi3OK;
+    }
+
+    // Update outputs
+    fmi3Flag = recordResults(fmu, state->instance, &state->output);
+    if (fmi3Flag > fmi3Warning) return fmi3Flag;
+
+    state->nSteps++;
+    return fmi3OK;
+}
+
+// Prints the name of element k of variable i, arrays are flattened in row-major order
+static void printElementName(const SimulationState *state, int i, unsigned int k) {
+    if (state->variables[i].nElements == 1) {
+        printf("%s", variable_names[i]);
+    } else {
+        printf("%s[%u]", variable_names[i], k);
+    }
+}
+
+void printOutput(SimulationState *state) {
+    INFO("Simulation from %g to %g terminated successfully\n", state->tStart, state->tEnd);
+    INFO("  steps ............ %d\n", state->nSteps);
+    INFO("  fixed step size .. %g\n", state->h);
+    INFO("  time events ...... %d\n", state->nTimeEvents);
+    INFO("  state events ..... %d\n", state->nStateEvents);
+    INFO("  step events ...... %d\n", state->nStepEvents);
+
+    // Print the output, row 0 holds the initial values
+    for (size_t j = 0; j < state->output.nRows; j++) {
+        printf("Step %zu: ", j);
+        for (int i = 0; i < state->nVariables; i++) {
+            for (unsigned int k = 0; k < state->variables[i].nElements; k++) {
+                printElementName(state, i, k);
+                printf("=");
+                printResultValue(stdout, &state->output, state->variables, i, k, j);
+                printf(" ");
+            }
+        }
+        printf("\n");
+    }
+}
+
+void printCsv(SimulationState *state, char sep) {
+    // Print headers, one column per array element
+    printf("step");
+    for (int i = 0; i < state->nVariables; i++) {
+        for (unsigned int k = 0; k < state->variables[i].nElements; k++) {
+            printf("%c", sep);
+            printElementName(state, i, k);
+        }
+    }
+    printf("\n");
+
+    // Print the output
+    for (size_t j = 0; j < state->output.nRows; j++) {
+        printf("%zu", j);
+        for (int i = 0; i < state->nVariables; i++) {
+            for (unsigned int k = 0; k < state->variables[i].nElements; k++) {
+                printf("%c", sep);
+                printResultValue(stdout, &state->output, state->variables, i, k, j);
+            }
+        }
+        printf("\n");
+    }
+}
+
+/**
+ * @brief Main function of the FMI 3.0 Model Exchange simulator.
+ *
+ * Same command line as the FMI 2.0 simulator, except for the start value overrides.
+ *
+ * @param argc The number of command-line arguments.
+ * @param argv The array of command-line arguments.
+ *
+ * @return Returns 0 upon successful completion.
+ */
+int main(int argc, char *argv[]) {
+
+    // Defaults come from the <DefaultExperiment> of modelDescription.xml
+    double tStart = model.startTime;
+    double tEnd = model.stopTime;
+    double h = model.stepSize;
+    double tolerance = model.toleranceDefined ? model.tolerance : 0;
+    int csv = 0;
+    char sep = ',';
+    int nPositional = 0;
+
+	// Liste des paramètres à récupérer
+	// [tStart [tEnd [h]]], --tolerance tol, --csv [sep]
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--csv") == 0) {
+            csv = 1;
+            if (i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0) {
+                sep = argv[++i][0];
+            }
+        } else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+            tolerance = atof(argv[++i]);
+        } else if (strncmp(argv[i], "--", 2) != 0 && nPositional < 3) {
+            switch (nPositional++) {
+                case 0: tStart = atof(argv[i]); break;
+                case 1: tEnd = atof(argv[i]); break;
+                case 2: h = atof(argv[i]); break;
+            }
+        } else {
+            printf("Usage: %s [tStart [tEnd [h]]] [--tolerance tol] [--csv [separator]]\n", argv[0]);
+            return -1;
+        }
+    }
+
+    if (h <= 0 || tEnd < tStart) {
+        printf("Invalid experiment: tStart=%g tEnd=%g h=%g\n", tStart, tEnd, h);
+        return -1;
+    }
+
+	loadFunctions3(&fmu);
+
+	SimulationState *state = initializeSimulation(&fmu, tStart, tEnd, h, tolerance);
+	if (!state) {
+		printf("Failed to initialize simulation\n");
+		return -1;
+	}
+
+	// Run the simulation step by step
+	while (state->time < state->tEnd && !state->terminateSimulation) {
+		fmi3Status status = simulationDoStep(&fmu, state);
+		if (status > fmi3Warning) {
+			printf("Simulation step failed at time %g\n", state->time);
+			break;
+		}
+	}
+
+    if (csv) {
+        printCsv(state, sep);
+    } else {
+        printOutput(state);
+    }
+
+	cleanupSimulation(&fmu, state);
+
+    return 0;
+}
\ No newline at end of file
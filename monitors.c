@@ -0,0 +1,136 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "headers/fmi2TypesPlatform.h"
+#include "headers/fmi2FunctionTypes.h"
+#include "headers/fmi2Functions.h"
+
+typedef enum {
+    MONITOR_LOG,                     // print the violations
+    MONITOR_FLAG,                    // print them and make the run fail
+    MONITOR_TERMINATE                // stop the simulation at the first one
+} MonitorAction;
+
+/**
+ * @struct Monitor
+ * @brief A condition which must hold at every recorded row, e.g. "T < 400".
+ */
+typedef struct {
+    char *condition;
+    int action;                      // MonitorAction
+    size_t nViolations;              // recorded rows where the condition was false
+    double firstViolation;           // time of the first of them
+    int violated;                    // the condition is false on the last checked row
+} Monitor;
+
+/**
+ * @struct Monitors
+ * @brief Runtime assertions checked as soon as each row is recorded.
+ *
+ * The conditions are compiled once with the derived signal parser into the bytecode of a
+ * Transforms, unnamed signal k being the condition of monitor k, and evaluated on the last
+ * recorded row only, in the units of the model.
+ */
+typedef struct {
+    Transforms code;
+    Monitor *monitors;
+    int nMonitors;
+    double *values;                  // value of each condition on the last checked row
+    double *stack;
+    int flagged;                     // a flag or terminate monitor was violated
+    int terminated;                  // the simulation was stopped by a monitor
+} Monitors;
+
+/**
+ * @brief Compiles a monitor "[log:|flag:|terminate:]condition", flag by default.
+ *
+ * The condition is an expression of the variables, as for --derive, usually a comparison.
+ *
+ * @return 0 on success, -1 if the condition is invalid or memory is exhausted.
+ */
+int addMonitor(Monitors *monitors, const char *specification, const ScalarVariable *variables) {
+    static const char *actions[] = {"log:", "flag:", "terminate:"};
+    int action = MONITOR_FLAG;
+    for (int a = 0; a < 3; a++) {
+        if (strncmp(specification, actions[a], strlen(actions[a])) == 0) {
+            action = a;
+            specification += strlen(actions[a]);
+        }
+    }
+
+    // Unnamed, a later condition reads the model variables whatever their names
+    if (addUnnamedSignal(&monitors->code, specification, variables) != 0) return -1;
+
+    Monitor *list = (Monitor*)realloc(monitors->monitors, (monitors->nMonitors + 1) * sizeof(Monitor));
+    if (!list) return -1;
+    monitors->monitors = list;
+    Monitor *monitor = &monitors->monitors[monitors->nMonitors++];
+    memset(monitor, 0, sizeof(Monitor));
+    monitor->condition = strdup(specification);
+    monitor->action = action;
+    return monitor->condition ? 0 : -1;
+}
+
+/**
+ * @brief Frees the memory held by the monitors.
+ */
+void freeMonitors(Monitors *monitors) {
+    for (int k = 0; k < monitors->nMonitors; k++) free(monitors->monitors[k].condition);
+    free(monitors->monitors);
+    free(monitors->values);
+    free(monitors->stack);
+    freeTransforms(&monitors->code);
+    memset(monitors, 0, sizeof(Monitors));
+}
+
+/**
+ * @brief Checks the monitors on the last recorded row.
+ *
+ * Must be called right after recordResults, before the display unit conversion. A violation is
+ * printed when the condition becomes false, not at every row while it stays false.
+ *
+ * @param monitors The monitors.
+ * @param results The recorded results.
+ * @param variables The model variables.
+ * @param time The time of the last row.
+ * @return 1 if the simulation must be terminated, 0 otherwise, -1 if memory is exhausted.
+ */
+int checkMonitors(Monitors *monitors, const Results *results, const ScalarVariable *variables, double time) {
+    if (!monitors->values) {
+        monitors->values = (double*)malloc((monitors->nMonitors + 1) * sizeof(double));
+        monitors->stack = (double*)malloc((monitors->code.maxDepth + 1) * sizeof(double));
+        if (!monitors->values || !monitors->stack) return -1;
+    }
+
+    int terminate = 0;
+    for (int k = 0; k < monitors->nMonitors; k++) {
+        Monitor *monitor = &monitors->monitors[k];
+        monitors->values[k] = evaluateSignal(&monitors->code, k, results, variables, results->nRows - 1,
+                                             monitors->values, monitors->stack);
+        int violated = monitors->values[k] == 0;
+        if (violated && !monitor->violated) {
+            printf("Monitor '%s' violated at t=%g\n", monitor->condition, time);
+        }
+        if (violated) {
+            if (monitor->nViolations++ == 0) monitor->firstViolation = time;
+            if (monitor->action != MONITOR_LOG) monitors->flagged = 1;
+            if (monitor->action == MONITOR_TERMINATE) terminate = 1;
+        }
+        monitor->violated = violated;
+    }
+    if (terminate) monitors->terminated = 1;
+    return terminate;
+}
+
+/**
+ * @brief Prints a summary of the violated monitors.
+ */
+void reportMonitors(const Monitors *monitors, double time) {
+    for (int k = 0; k < monitors->nMonitors; k++) {
+        const Monitor *monitor = &monitors->monitors[k];
+        if (monitor->nViolations == 0) continue;
+        printf("Monitor '%s': %zu violations, first at t=%g\n", monitor->condition, monitor->nViolations,
+               monitor->firstViolation);
+    }
+    if (monitors->terminated) printf("Simulation terminated by a monitor at t=%g\n", time);
+}
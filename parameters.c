@@ -0,0 +1,302 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "headers/fmi2TypesPlatform.h"
+#include "headers/fmi2FunctionTypes.h"
+#include "headers/fmi2Functions.h"
+
+#define MAX_LINE_SIZE 1024
+
+/**
+ * @struct ParameterOverride
+ * @brief A "name=value" assignment given by the user for a start value or a parameter.
+ */
+typedef struct {
+    char *name;
+    char *value;
+} ParameterOverride;
+
+/**
+ * @struct ParameterOverrides
+ * @brief Growable list of overrides collected from the command line and parameter files.
+ */
+typedef struct {
+    ParameterOverride *items;
+    int count;
+    int capacity;
+} ParameterOverrides;
+
+// Appends the override name=value, the strings being copied
+static int appendOverride(ParameterOverrides *overrides, const char *name, size_t nameLength,
+                          const char *value, size_t valueLength) {
+    if (overrides->count == overrides->capacity) {
+        int capacity = overrides->capacity ? 2 * overrides->capacity : 16;
+        ParameterOverride *items = (ParameterOverride*)realloc(overrides->items, capacity * sizeof(ParameterOverride));
+        if (!items) return -1;
+        overrides->items = items;
+        overrides->capacity = capacity;
+    }
+
+    ParameterOverride *item = &overrides->items[overrides->count];
+    item->name = strndup(name, nameLength);
+    item->value = strndup(value, valueLength);
+    if (!item->name || !item->value) {
+        free(item->name);
+        free(item->value);
+        return -1;
+    }
+    overrides->count++;
+    return 0;
+}
+
+/**
+ * @brief Adds a "name=value" assignment to the override list.
+ *
+ * Leading and trailing blanks around the name and the value are removed.
+ * A later assignment of the same name takes precedence over an earlier one.
+ *
+ * @param overrides The override list to append to.
+ * @param assignment A string of the form "name=value".
+ * @return 0 on success, -1 if the assignment is malformed or memory is exhausted.
+ */
+int addParameterOverride(ParameterOverrides *overrides, const char *assignment) {
+    const char *equal = strchr(assignment, '=');
+    if (!equal || equal == assignment) return -1;
+
+    const char *nameStart = assignment;
+    const char *nameEnd = equal;
+    const char *valueStart = equal + 1;
+    const char *valueEnd = assignment + strlen(assignment);
+    while (nameStart < nameEnd && (*nameStart == ' ' || *nameStart == '\t')) nameStart++;
+    while (nameEnd > nameStart && (nameEnd[-1] == ' ' || nameEnd[-1] == '\t')) nameEnd--;
+    while (valueStart < valueEnd && (*valueStart == ' ' || *valueStart == '\t')) valueStart++;
+    while (valueEnd > valueStart && (valueEnd[-1] == ' ' || valueEnd[-1] == '\t' ||
+                                     valueEnd[-1] == '\r' || valueEnd[-1] == '\n')) valueEnd--;
+    if (nameStart == nameEnd) return -1;
+    return appendOverride(overrides, nameStart, nameEnd - nameStart, valueStart, valueEnd - valueStart);
+}
+
+/**
+ * @brief Adds the Real value of a variable to the override list, with all its digits.
+ *
+ * @param overrides The override list to append to.
+ * @param name The name of the variable.
+ * @param value Its value.
+ * @return 0 on success, -1 if memory is exhausted.
+ */
+int addRealOverride(ParameterOverrides *overrides, const char *name, double value) {
+    char text[32];
+    int length = snprintf(text, sizeof(text), "%.17g", value);
+    return appendOverride(overrides, name, strlen(name), text, (size_t)length);
+}
+
+/**
+ * @brief Reads overrides from a file containing one "name=value" assignment per line.
+ *
+ * Empty lines and lines starting with '#' are ignored.
+ *
+ * @param overrides The override list to append to.
+ * @param path Path of the parameter file.
+ * @return 0 on success, -1 if the file cannot be read or contains a malformed line.
+ */
+int loadParameterFile(ParameterOverrides *overrides, const char *path) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        printf("Cannot open parameter file %s\n", path);
+        return -1;
+    }
+
+    char line[MAX_LINE_SIZE];
+    int lineNumber = 0;
+    while (fgets(line, sizeof(line), file)) {
+        lineNumber++;
+        char *p = line;
+        while (*p == ' ' || *p == '\t') p++;
+        if (*p == '#' || *p == '\n' || *p == '\r' || *p == '\0') continue;
+        if (addParameterOverride(overrides, p) != 0) {
+            printf("Invalid assignment in %s at line %d\n", path, lineNumber);
+            fclose(file);
+            return -1;
+        }
+    }
+
+    fclose(file);
+    return 0;
+}
+
+/**
+ * @brief Frees the memory held by an override list.
+ *
+ * @param overrides The override list to free.
+ */
+void freeParameterOverrides(ParameterOverrides *overrides) {
+    for (int i = 0; i < overrides->count; i++) {
+        free(overrides->items[i].name);
+        free(overrides->items[i].value);
+    }
+    free(overrides->items);
+    overrides->items = NULL;
+    overrides->count = 0;
+    overrides->capacity = 0;
+}
+
+/**
+ * @brief Tells whether a variable may be set between instantiation and initialization.
+ *
+ * FMI 2.0 allows setting non-constant variables with initial="exact" or "approx", and inputs.
+ */
+static int isSettableBeforeInitialization(const ScalarVariable *var) {
+    if (var->variability == CONSTANT) return 0;
+    return var->initial == EXACT || var->initial == APPROX || var->causality == INPUT;
+}
+
+/**
+ * @brief Applies the start values of the model description and the user overrides to an instance.
+ *
+ * Names are resolved once through the generated name index, the values are then grouped by type and
+ * applied with a single setReal, setInteger, setBoolean and setString call each.
+ * Must be called after instantiate and before exitInitializationMode.
+ *
+ * @param fmu Pointer to the FMU structure
+ * @param component The FMU instance
+ * @param variables The model variables
+ * @param nVariables The number of model variables
+ * @param overrides The user overrides, may be NULL
+ * @return fmi2Status The worst status returned by the FMU, fmi2Error if an override is invalid
+ */
+fmi2Status applyStartValues(FMU *fmu, fmi2Component component, const ScalarVariable *variables, int nVariables,
+                            const ParameterOverrides *overrides) {
+    fmi2Status status = fmi2OK;
+    fmi2Status fmi2Flag;
+    int nReal = 0, nInteger = 0, nBoolean = 0, nString = 0;
+
+    // Position of each variable in its typed batch, -1 if it is not part of a batch
+    int *slot = (int*)malloc(nVariables * sizeof(int));
+    fmi2ValueReference *vrReal = (fmi2ValueReference*)malloc(nVariables * sizeof(fmi2ValueReference));
+    fmi2ValueReference *vrInteger = (fmi2ValueReference*)malloc(nVariables * sizeof(fmi2ValueReference));
+    fmi2ValueReference *vrBoolean = (fmi2ValueReference*)malloc(nVariables * sizeof(fmi2ValueReference));
+    fmi2ValueReference *vrString = (fmi2ValueReference*)malloc(nVariables * sizeof(fmi2ValueReference));
+    fmi2Real *realValues = (fmi2Real*)malloc(nVariables * sizeof(fmi2Real));
+    fmi2Integer *integerValues = (fmi2Integer*)malloc(nVariables * sizeof(fmi2Integer));
+    fmi2Boolean *booleanValues = (fmi2Boolean*)malloc(nVariables * sizeof(fmi2Boolean));
+    fmi2String *stringValues = (fmi2String*)malloc(nVariables * sizeof(fmi2String));
+
+    if (nVariables > 0 && (!slot || !vrReal || !vrInteger || !vrBoolean || !vrString ||
+                           !realValues || !integerValues || !booleanValues || !stringValues)) {
+        status = fmi2Error;
+        goto cleanup;
+    }
+
+    // Start values from the model description
+    for (int i = 0; i < nVariables; i++) {
+        const ScalarVariable *var = &variables[i];
+        slot[i] = -1;
+        if (!var->hasStart || !isSettableBeforeInitialization(var)) continue;
+        switch (var->type) {
+            case REAL:
+                slot[i] = nReal;
+                vrReal[nReal] = var->valueReference;
+                realValues[nReal++] = variable_starts[i].realValue;
+                break;
+            case INTEGER:
+            case ENUMERATION:
+                slot[i] = nInteger;
+                vrInteger[nInteger] = var->valueReference;
+                integerValues[nInteger++] = variable_starts[i].intValue;
+                break;
+            case BOOLEAN:
+                slot[i] = nBoolean;
+                vrBoolean[nBoolean] = var->valueReference;
+                booleanValues[nBoolean++] = variable_starts[i].intValue ? fmi2True : fmi2False;
+                break;
+            case STRING:
+                slot[i] = nString;
+                vrString[nString] = var->valueReference;
+                stringValues[nString++] = variable_starts[i].stringValue;
+                break;
+        }
+    }
+
+    // User overrides replace the start value of their variable
+    for (int k = 0; overrides && k < overrides->count; k++) {
+        const ParameterOverride *item = &overrides->items[k];
+        int i = get_variable_index(item->name);
+        if (i < 0) {
+            printf("Unknown variable %s\n", item->name);
+            status = fmi2Error;
+            goto cleanup;
+        }
+
+        const ScalarVariable *var = &variables[i];
+        if (!isSettableBeforeInitialization(var)) {
+            printf("Variable %s cannot be set before initialization\n", item->name);
+            status = fmi2Error;
+            goto cleanup;
+        }
+
+        char *end = NULL;
+        switch (var->type) {
+            case REAL:
+                if (slot[i] < 0) { slot[i] = nReal++; vrReal[slot[i]] = var->valueReference; }
+                realValues[slot[i]] = strtod(item->value, &end);
+                break;
+            case INTEGER:
+            case ENUMERATION:
+                if (slot[i] < 0) { slot[i] = nInteger++; vrInteger[slot[i]] = var->valueReference; }
+                integerValues[slot[i]] = (fmi2Integer)strtol(item->value, &end, 10);
+                break;
+            case BOOLEAN:
+                if (slot[i] < 0) { slot[i] = nBoolean++; vrBoolean[slot[i]] = var->valueReference; }
+                if (strcmp(item->value, "true") == 0 || strcmp(item->value, "1") == 0) {
+                    booleanValues[slot[i]] = fmi2True;
+                } else if (strcmp(item->value, "false") == 0 || strcmp(item->value, "0") == 0) {
+                    booleanValues[slot[i]] = fmi2False;
+                } else {
+                    end = item->value;
+                }
+                break;
+            case STRING:
+                if (slot[i] < 0) { slot[i] = nString++; vrString[slot[i]] = var->valueReference; }
+                stringValues[slot[i]] = item->value;
+                break;
+        }
+
+        if (end && (end == item->value || *end != '\0')) {
+            printf("Invalid value '%s' for variable %s\n", item->value, item->name);
+            status = fmi2Error;
+            goto cleanup;
+        }
+    }
+
+    INFO("Applying %d real, %d integer, %d boolean and %d string start values\n",
+         nReal, nInteger, nBoolean, nString);
+
+    if (nReal > 0) {
+        fmi2Flag = fmu->setReal(component, vrReal, nReal, realValues);
+        if (fmi2Flag > status) status = fmi2Flag;
+    }
+    if (nInteger > 0) {
+        fmi2Flag = fmu->setInteger(component, vrInteger, nInteger, integerValues);
+        if (fmi2Flag > status) status = fmi2Flag;
+    }
+    if (nBoolean > 0) {
+        fmi2Flag = fmu->setBoolean(component, vrBoolean, nBoolean, booleanValues);
+        if (fmi2Flag > status) status = fmi2Flag;
+    }
+    if (nString > 0) {
+        fmi2Flag = fmu->setString(component, vrString, nString, stringValues);
+        if (fmi2Flag > status) status = fmi2Flag;
+    }
+
+cleanup:
+    free(slot);
+    free(vrReal);
+    free(vrInteger);
+    free(vrBoolean);
+    free(vrString);
+    free(realValues);
+    free(integerValues);
+    free(booleanValues);
+    free(stringValues);
+    return status;
+}
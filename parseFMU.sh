@@ -3,15 +3,21 @@
 # On va parser tout le fichier xml et le mettre dans un fichier C.
 output_file="modelDescription.c"
 
+# Les FMU 3.0 ont leur propre analyseur (variables Float64, Int32... et tableaux)
+if grep -q 'fmiVersion="3' ./fmu/modelDescription.xml; then
+    exec bash "$(dirname "$0")/parseFMU3.sh"
+fi
+
 # Le début du fichier C
 cat <<EOT > "$output_file"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-typedef enum { INTEGER, REAL, BOOLEAN, STRING } VarType;
-typedef enum { INDEPENDENT, PARAMETER, LOCAL, OUTPUT } Causality;
+typedef enum { INTEGER, REAL, BOOLEAN, STRING, ENUMERATION } VarType;
+typedef enum { INDEPENDENT, PARAMETER, LOCAL, OUTPUT, INPUT, CALCULATED_PARAMETER } Causality;
 typedef enum { CONSTANT, FIXED, TUNABLE, DISCRETE, CONTINUOUS } Variability;
-typedef enum { EXACT, APPROX, CALCULATED } Initial;
+typedef enum { EXACT, APPROX, CALCULATED, NO_INITIAL } Initial;
 EOT
 
 # On doit commencer par parser le tag TypeDefinitions pour créer une enum pour chaque type
@@ -49,52 +55,83 @@ typedef struct {
 	char *guid;
 	int numberOfEventIndicators;
 	int numberOfContinuousStates;
+	double startTime;
+	double stopTime;
+	double stepSize;
+	double tolerance;
+	int toleranceDefined;
+	int providesDirectionalDerivative;
+	int canGetAndSetFMUstate;
+	int canSerializeFMUstate;
+	int canBeInstantiatedOnlyOncePerProcess;
+	int coSimulation;
+	int csProvidesDirectionalDerivative;
+	int csCanGetAndSetFMUstate;
+	int csCanSerializeFMUstate;
+	int csCanBeInstantiatedOnlyOncePerProcess;
+	int csCanHandleVariableCommunicationStepSize;
+	int csCanInterpolateInputs;
+	int csMaxOutputDerivativeOrder;
 } ModelDescription;
 
+// Hot metadata of a variable, read at every step by the recording and setting code
 typedef struct {
-    char *name;
     unsigned int valueReference;
-	Causality causality;
-	Variability variability;
-	Initial initial;
-    char *description;
-    VarType type;
-    union {
-        int intValue;
-        double realValue;
-    } start;
-    union {
-        int intMin;
-        double realMin;
-    } min;
-    union {
-        int intMax;
-        double realMax;
-    } max;
+    unsigned char type;              // VarType
+    unsigned char causality;         // Causality
+    unsigned char variability;       // Variability
+    unsigned char initial;           // Initial
+    unsigned char hasStart;
 } ScalarVariable;
 
+typedef union {
+    int intValue;
+    double realValue;
+    const char *stringValue;
+} VariableValue;
 
-void initialize(ScalarVariable *var, char *name, int valueReference, char *description,
-                VarType type, void *start, void *min, void *max) {
-    var->name = name;
-    var->valueReference = valueReference;
-    var->description = description;
-    var->type = type;
-    if (type == INTEGER) {
-        var->start.intValue = start ? *(int*)start : 0;
-        var->min.intMin = min ? *(int*)min : 0;
-        var->max.intMax = max ? *(int*)max : 0;
-    } else {
-        var->start.realValue = start ? *(double*)start : 0.0;
-        var->min.realMin = min ? *(double*)min : 0.0;
-        var->max.realMax = max ? *(double*)max : 0.0;
-    }
-}
-
-int get_variable_list(ScalarVariable **variables) {
+// Display unit of a Real variable: value in the display unit = factor * value + offset
+typedef struct {
+    const char *name;                // NULL if the variable has no display unit
+    double factor;
+    double offset;
+} DisplayUnit;
 EOT
 
 
+# Unités d'affichage de <UnitDefinitions>, indexées par "unité|unité d'affichage" :
+# <Unit name="m/s"><DisplayUnit name="km/h" factor="3.6"/></Unit>
+declare -A display_factor
+declare -A display_offset
+units=$(xmllint --noblanks ./fmu/modelDescription.xml | xmllint --xpath '//UnitDefinitions/Unit' - 2>/dev/null \
+        | grep -oP '<Unit\b[^>]*?(/>|>.*?</Unit>)')
+while IFS= read -r unit; do
+    [ -z "$unit" ] && continue
+    unit_name=$(echo "$unit" | grep -oP '^<Unit\s[^>]*?name="\K[^"]+')
+    while IFS= read -r display; do
+        [ -z "$display" ] && continue
+        display_name=$(echo "$display" | grep -oP '\sname="\K[^"]+')
+        factor=$(echo "$display" | grep -oP '\sfactor="\K[^"]+' || echo "")
+        offset=$(echo "$display" | grep -oP '\soffset="\K[^"]+' || echo "")
+        display_factor["$unit_name|$display_name"]=${factor:-1.0}
+        display_offset["$unit_name|$display_name"]=${offset:-0.0}
+    done <<< "$(echo "$unit" | grep -oP '<DisplayUnit\b[^>]*>')"
+done <<< "$units"
+
+# Unité et unité d'affichage des types déclarés, utilisées si la variable ne les redéfinit pas :
+# <SimpleType name="Velocity"><Real unit="m/s" displayUnit="km/h"/></SimpleType>
+declare -A type_unit
+declare -A type_display_unit
+simple_types=$(xmllint --noblanks ./fmu/modelDescription.xml | xmllint --xpath '//TypeDefinitions/SimpleType' - 2>/dev/null \
+               | grep -oP '<SimpleType\b.*?</SimpleType>')
+while IFS= read -r simple_type; do
+    [ -z "$simple_type" ] && continue
+    type_name=$(echo "$simple_type" | grep -oP '^<SimpleType\s[^>]*?name="\K[^"]+')
+    type_unit[$type_name]=$(echo "$simple_type" | grep -oP '<Real\b[^>]*\sunit="\K[^"]+' || echo "")
+    type_display_unit[$type_name]=$(echo "$simple_type" | grep -oP '<Real\b[^>]*\sdisplayUnit="\K[^"]+' || echo "")
+done <<< "$simple_types"
+
+
 # La première étape est de parser les ScalarVariable
 # Puis de les mettre dans une structure C
 # Basiquement, on réunit les deux autres fichiers sh en un seul pour cette étape, en utilisant xmllint
@@ -120,12 +157,23 @@ lines=$(xmllint --xpath "//ScalarVariable" ./fmu/modelDescription.xml --format |
 
 # On va utiliser grep pour extraire ces informations
 
+# Échappe une chaîne pour un littéral C, comme les noms dans perfectHash.awk
+c_escape() {
+    printf '%s' "$1" | sed 's/\\/\\\\/g; s/"/\\"/g'
+}
+
 # On fait une boucle for pour parser chaque ligne
 #echo "$lines"
 
 counter=0
-temp_output=""
-numberOfContinuousStates=0
+hot_rows=""
+description_rows=""
+start_rows=""
+min_rows=""
+max_rows=""
+display_rows=""
+names=""
+declare -a derivative_of
 
 while IFS= read -r line; do
 	
@@ -174,51 +222,107 @@ while IFS= read -r line; do
 	# declaredType (s'il existe, sinon on met une chaine vide)
 	declaredType=$(echo $line | grep -oP 'declaredType="\K[^"]+' || echo "")
 
+	# derivative (index, à partir de 1, de la variable dont celle-ci est la dérivée)
+	derivative=$(echo $line | grep -oP '\sderivative="\K[^"]+' || echo "")
+
+	# unit et displayUnit (s'ils existent, sinon ceux du declaredType)
+	unit=$(echo $line | grep -oP '\sunit="\K[^"]+' || echo "")
+	displayUnit=$(echo $line | grep -oP '\sdisplayUnit="\K[^"]+' || echo "")
+	if [ -n "$declaredType" ]; then
+		unit=${unit:-${type_unit[$declaredType]}}
+		displayUnit=${displayUnit:-${type_display_unit[$declaredType]}}
+	fi
+
 
 	valueReference=${valueReference:-0}
-    description=${description:-NULL}
     type_enum="REAL"
-    type_var="double"
-    start_val=${start:0}
-	min_val=${min:0}
-	max_val=${max:0}
 
-    # Possibility : REAL CHAR BOOLEAN
-
-    # Adjust types and defaults based on type
+    # Causality, variability et initial vers les enums C (valeurs par défaut de la norme FMI 2.0)
+    case $causality in
+        (parameter) causality_enum="PARAMETER";;
+        (calculatedParameter) causality_enum="CALCULATED_PARAMETER";;
+        (input) causality_enum="INPUT";;
+        (output) causality_enum="OUTPUT";;
+        (independent) causality_enum="INDEPENDENT";;
+        (*) causality_enum="LOCAL";;
+    esac
+    case $variability in
+        (constant) variability_enum="CONSTANT";;
+        (fixed) variability_enum="FIXED";;
+        (tunable) variability_enum="TUNABLE";;
+        (discrete) variability_enum="DISCRETE";;
+        (*) variability_enum="CONTINUOUS";;
+    esac
+    case $initial in
+        (exact) initial_enum="EXACT";;
+        (approx) initial_enum="APPROX";;
+        (calculated) initial_enum="CALCULATED";;
+        (*)
+            # Sans attribut initial, un paramètre est "exact" et une variable dérivée est "calculated"
+            case $causality_enum in
+                (PARAMETER) initial_enum="EXACT";;
+                (CALCULATED_PARAMETER|OUTPUT|LOCAL) initial_enum="CALCULATED";;
+                (*) initial_enum="NO_INITIAL";;
+            esac
+            if [ "$variability_enum" = "CONSTANT" ]; then
+                initial_enum="EXACT"
+            fi;;
+    esac
+
+    # Adjust types based on type, Enumeration is exchanged as an Integer but keeps its own type
     if [ "$type" = "Integer" ]; then
         type_enum="INTEGER"
-        type_var="int"
-        start_val=${start:-0}
-        min_val=${min:-0}
-        max_val=${max:-0}
-    else
-        start_val=${start:-0.0}
-        min_val=${min:-0.0}
-        max_val=${max:-0.0}
+    elif [ "$type" = "Enumeration" ]; then
+        type_enum="ENUMERATION"
+    elif [ "$type" = "Boolean" ]; then
+        type_enum="BOOLEAN"
+        case $start in
+            (true) start="1";;
+            (false) start="0";;
+        esac
+        min=""
+        max=""
+    elif [ "$type" = "String" ]; then
+        type_enum="STRING"
+        if [ -n "$start" ]; then
+            start=$(printf '"%s"' "$(c_escape "$start")")
+        fi
+        min=""
+        max=""
     fi
 
-	    # Generate C code to initialize each variable
-    temp_output+=$(cat <<EOT
-    {
-        ScalarVariable var;
-        char *name = "$name";
-        char *description = "$description";
-        const unsigned int valueReference = $valueReference;
-        VarType type = $type_enum;
-        ${type_var} start = ${start_val};
-        ${type_var} min = ${min_val};
-        ${type_var} max = ${max_val};
-        initialize(&var, name, valueReference, description, type, &start, &min, &max);
-        (*variables)[$counter] = var;
-    }
-EOT
-)
-    temp_output+="\n"
-    counter=$((counter + 1))
-    if [ "$variability" = "continuous" ] && [ "$causality" = "output" ]; then
-        numberOfContinuousStates=$((numberOfContinuousStates + 1))
+    # Les valeurs absentes valent {0} et hasStart vaut 0
+    has_start=0
+    start_init="{0}"; min_init="{0}"; max_init="{0}"
+    value_field="realValue"
+    case $type_enum in
+        (STRING) value_field="stringValue";;
+        (INTEGER|BOOLEAN|ENUMERATION) value_field="intValue";;
+    esac
+    if [ -n "$start" ]; then has_start=1; start_init="{.${value_field} = ${start}}"; fi
+    if [ -n "$min" ]; then min_init="{.${value_field} = ${min}}"; fi
+    if [ -n "$max" ]; then max_init="{.${value_field} = ${max}}"; fi
+
+    # Une ligne par variable dans chaque table statique
+    hot_rows+="    {$valueReference, $type_enum, $causality_enum, $variability_enum, $initial_enum, $has_start},"$'\n'
+    if [ -n "$description" ]; then
+        description_rows+="    \"$(c_escape "$description")\","$'\n'
+    else
+        description_rows+="    NULL,"$'\n'
     fi
+    # Conversion vers l'unité d'affichage, seulement pour les Real dont l'unité la définit
+    display_key="$unit|$displayUnit"
+    if [ "$type_enum" = "REAL" ] && [ -n "$displayUnit" ] && [ -n "${display_factor[$display_key]}" ]; then
+        display_rows+="    {\"$(c_escape "$displayUnit")\", ${display_factor[$display_key]}, ${display_offset[$display_key]}},"$'\n'
+    else
+        display_rows+="    {NULL, 1.0, 0.0},"$'\n'
+    fi
+    start_rows+="    $start_init,"$'\n'
+    min_rows+="    $min_init,"$'\n'
+    max_rows+="    $max_init,"$'\n'
+    names+="$name"$'\n'
+    derivative_of[$counter]=$derivative
+    counter=$((counter + 1))
 
 	# On affiche les informations pour le debug
 	#echo "name=$name, valueReference=$valueReference, causality=$causality, variability=$variability, initial=$initial, description=$description, type=$type, start=$start, min=$min, max=$max, reinit=$reinit, declaredType=$declaredType"
@@ -226,14 +330,22 @@ EOT
 done <<< "$lines"
 
 
-echo "    (*variables) = (ScalarVariable*)calloc($counter, sizeof(ScalarVariable));" >> "$output_file"
-
-# Append the generated code to the output file
-echo -e "$temp_output" >> "$output_file"
-
-# End of the function
-echo "    return 0;" >> "$output_file"
-echo "}" >> "$output_file"
+# Les tables sont statiques et constantes : rien à faire au démarrage, elles sont en .rodata.
+# Les champs lus à chaque pas (model_variables) sont séparés des chaînes et des valeurs de départ.
+# Les tables qui ne servent pas encore sont marquées unused, pour éviter les avertissements.
+size=$((counter > 0 ? counter : 1))
+empty_value="    {0},"$'\n'
+empty_string="    NULL,"$'\n'
+empty_display="    {NULL, 1.0, 0.0},"$'\n'
+{
+    printf 'static const ScalarVariable model_variables[%d] = {\n%s};\n\n' "$size" "${hot_rows:-$empty_value}"
+    printf 'static const char *const variable_descriptions[%d] __attribute__((unused)) = {\n%s};\n\n' "$size" "${description_rows:-$empty_string}"
+    printf 'static const VariableValue variable_starts[%d] = {\n%s};\n\n' "$size" "${start_rows:-$empty_value}"
+    printf 'static const VariableValue variable_mins[%d] __attribute__((unused)) = {\n%s};\n\n' "$size" "${min_rows:-$empty_value}"
+    printf 'static const VariableValue variable_maxs[%d] __attribute__((unused)) = {\n%s};\n\n' "$size" "${max_rows:-$empty_value}"
+    printf 'static const DisplayUnit variable_display_units[%d] = {\n%s};\n\n' "$size" "${display_rows:-$empty_display}"
+    printf 'const ScalarVariable *get_variable_list() {\n    return model_variables;\n}\n\n'
+} >> "$output_file"
 
 # Function to get the number of variables
 echo "//TODO: Choose between this two :" >> "$output_file"
@@ -244,6 +356,94 @@ echo "}" >> "$output_file"
 #Constant number of variables
 echo "#define NVARIABLES $counter" >> "$output_file"
 
+# Index des noms de variables (hachage parfait minimal) pour des recherches par nom en O(1)
+echo -n "$names" | LC_ALL=C awk -f "$(dirname "$0")/perfectHash.awk" >> "$output_file" || exit 1
+
+
+# Les états continus sont donnés par <ModelStructure><Derivatives> : chaque Unknown est la dérivée
+# d'un état (attribut derivative de sa ScalarVariable), dans l'ordre du vecteur d'état x.
+# Les index de la norme commencent à 1, ceux des tables C à 0.
+derivatives=$(xmllint --xpath '//ModelStructure/Derivatives/Unknown' ./fmu/modelDescription.xml 2>/dev/null | grep -oP '<Unknown\b[^>]*>')
+outputs=$(xmllint --xpath '//ModelStructure/Outputs/Unknown' ./fmu/modelDescription.xml 2>/dev/null | grep -oP '<Unknown\b[^>]*>')
+
+# Dépendances d'un Unknown (structure creuse des jacobiennes) : une ligne {variable, début, nombre}
+# qui renvoie aux index de model_dependencies ; sans attribut dependencies, l'Unknown dépend de
+# toutes les variables connues et le nombre vaut -1.
+dependency_rows=""
+nDependencies=0
+unknown_entry=""
+parse_unknown() {
+    local index=$(echo "$1" | grep -oP '\sindex="\K[^"]+')
+    local start=$nDependencies
+    local count=-1
+    if echo "$1" | grep -qP '\sdependencies="'; then
+        count=0
+        for dependency in $(echo "$1" | grep -oP '\sdependencies="\K[^"]*'); do
+            dependency_rows+=" $((dependency - 1)),"
+            nDependencies=$((nDependencies + 1))
+            count=$((count + 1))
+        done
+    fi
+    unknown_entry="    {$((index - 1)), $start, $count},"$'\n'
+}
+
+numberOfContinuousStates=0
+state_rows=""
+derivative_dependency_rows=""
+while IFS= read -r unknown; do
+    [ -z "$unknown" ] && continue
+    index=$(echo "$unknown" | grep -oP '\sindex="\K[^"]+')
+    state=${derivative_of[$((index - 1))]}
+    if [ -z "$state" ]; then
+        echo "Error: the derivative $index in ModelStructure has no derivative attribute" >&2
+        exit 1
+    fi
+    state_rows+="    {$((state - 1)), $((index - 1))},"$'\n'
+    parse_unknown "$unknown"
+    derivative_dependency_rows+="$unknown_entry"
+    numberOfContinuousStates=$((numberOfContinuousStates + 1))
+done <<< "$derivatives"
+
+numberOfOutputs=0
+output_rows=""
+while IFS= read -r unknown; do
+    [ -z "$unknown" ] && continue
+    parse_unknown "$unknown"
+    output_rows+="$unknown_entry"
+    numberOfOutputs=$((numberOfOutputs + 1))
+done <<< "$outputs"
+
+cat <<EOT >> "$output_file"
+
+// Continuous state i: variable index of x[i] and of its derivative xdot[i]
+typedef struct {
+    int state;
+    int derivative;
+} ContinuousState;
+
+EOT
+empty_state="    {-1, -1},"$'\n'
+printf 'const ContinuousState model_states[%d] = {\n%s};\n\n' "$((numberOfContinuousStates > 0 ? numberOfContinuousStates : 1))" "${state_rows:-$empty_state}" >> "$output_file"
+
+cat <<EOT >> "$output_file"
+// Unknown of <ModelStructure>: variable index and its dependencies model_dependencies[start..start+count-1],
+// count is -1 if the unknown depends on all the states and inputs
+typedef struct {
+    int variable;
+    int start;
+    int count;
+} ModelUnknown;
+
+EOT
+empty_unknown="    {-1, 0, 0},"$'\n'
+{
+    printf 'const int model_dependencies[%d] = {%s };\n\n' "$((nDependencies > 0 ? nDependencies : 1))" "${dependency_rows:- 0}"
+    printf '// Dependencies of the derivatives, in the order of model_states\n'
+    printf 'const ModelUnknown model_derivative_dependencies[%d] = {\n%s};\n\n' "$((numberOfContinuousStates > 0 ? numberOfContinuousStates : 1))" "${derivative_dependency_rows:-$empty_unknown}"
+    printf 'const ModelUnknown model_outputs[%d] = {\n%s};\n' "$((numberOfOutputs > 0 ? numberOfOutputs : 1))" "${output_rows:-$empty_unknown}"
+    printf '#define NOUTPUTS %d\n\n' "$numberOfOutputs"
+} >> "$output_file"
+
 
 # On va maintenant parser le <fmiModelDescription> pour extraire les informations qui nous intéressent
 model=$(xmllint --xpath '/*' ./fmu/modelDescription.xml | sed -n 's/\(<fmiModelDescription[^>]*>\).*/\1/p')
@@ -260,10 +460,52 @@ version=$(echo $model | grep -oP 'fmiVersion="\K[^"]+')
 modelName=$(echo $model | grep -oP 'modelName="\K[^"]+')
 description=$(echo $model | grep -oP 'description="\K[^"]+')
 guid=$(echo $model | grep -oP 'guid="\K[^"]+')
-numberOfEventIndicators=$(echo $model | grep -oP 'numberOfEventIndicators="\K[^"]+')
+numberOfEventIndicators=$(echo $model | grep -oP 'numberOfEventIndicators="\K[^"]+' || echo "")
+numberOfEventIndicators=${numberOfEventIndicators:-0}
 
 #La descriptio
 
+# On parse ensuite le <DefaultExperiment> (optionnel) pour les valeurs par défaut de la simulation
+experiment=$(xmllint --xpath '//DefaultExperiment' ./fmu/modelDescription.xml 2>/dev/null)
+startTime=$(echo $experiment | grep -oP 'startTime="\K[^"]+' || echo "")
+stopTime=$(echo $experiment | grep -oP 'stopTime="\K[^"]+' || echo "")
+stepSize=$(echo $experiment | grep -oP 'stepSize="\K[^"]+' || echo "")
+tolerance=$(echo $experiment | grep -oP 'tolerance="\K[^"]+' || echo "")
+
+# Capacités de l'interface Model Exchange, utilisées par la linéarisation (false par défaut)
+model_exchange=$(xmllint --xpath '//ModelExchange' ./fmu/modelDescription.xml 2>/dev/null | grep -oP '^<ModelExchange\b[^>]*>')
+capability() {
+    if echo "$model_exchange" | grep -qP "\\s$1=\"(true|1)\""; then echo 1; else echo 0; fi
+}
+providesDirectionalDerivative=$(capability providesDirectionalDerivative)
+canGetAndSetFMUstate=$(capability canGetAndSetFMUstate)
+canSerializeFMUstate=$(capability canSerializeFMUstate)
+canBeInstantiatedOnlyOncePerProcess=$(capability canBeInstantiatedOnlyOncePerProcess)
+
+# Présence et capacités de l'interface Co-Simulation, que peuvent utiliser les composants d'un système SSP
+co_simulation=$(xmllint --xpath '//CoSimulation' ./fmu/modelDescription.xml 2>/dev/null | grep -oP '^<CoSimulation\b[^>]*>')
+if [ -n "$co_simulation" ]; then coSimulation=1; else coSimulation=0; fi
+cs_capability() {
+    if echo "$co_simulation" | grep -qP "\\s$1=\"(true|1)\""; then echo 1; else echo 0; fi
+}
+csProvidesDirectionalDerivative=$(cs_capability providesDirectionalDerivative)
+csCanGetAndSetFMUstate=$(cs_capability canGetAndSetFMUstate)
+csCanSerializeFMUstate=$(cs_capability canSerializeFMUstate)
+csCanBeInstantiatedOnlyOncePerProcess=$(cs_capability canBeInstantiatedOnlyOncePerProcess)
+csCanHandleVariableCommunicationStepSize=$(cs_capability canHandleVariableCommunicationStepSize)
+csCanInterpolateInputs=$(cs_capability canInterpolateInputs)
+csMaxOutputDerivativeOrder=$(echo "$co_simulation" | grep -oP '\smaxOutputDerivativeOrder="\K[0-9]+' || echo 0)
+
+# Valeurs par défaut si les attributs sont absents
+toleranceDefined=1
+if [ -z "$tolerance" ]; then
+    tolerance="0.0"
+    toleranceDefined=0
+fi
+startTime=${startTime:-0.0}
+stopTime=${stopTime:-1.0}
+stepSize=${stepSize:-1e-3}
+
 # On affiche les informations pour le debug
 #echo "version=$version, modelName=$modelName, description=$description, guid=$guid, numberOfEventIndicators=$numberOfEventIndicators"
 
@@ -271,10 +513,27 @@ numberOfEventIndicators=$(echo $model | grep -oP 'numberOfEventIndicators="\K[^"
 cat <<EOT >> "$output_file"
 ModelDescription model = {
     .version = $version,
-    .modelName = "$modelName",
-    .description = "$description",
+    .modelName = "$(c_escape "$modelName")",
+    .description = "$(c_escape "$description")",
     .guid = "$guid",
     .numberOfEventIndicators = $numberOfEventIndicators,
-    .numberOfContinuousStates = $numberOfContinuousStates
+    .numberOfContinuousStates = $numberOfContinuousStates,
+    .startTime = $startTime,
+    .stopTime = $stopTime,
+    .stepSize = $stepSize,
+    .tolerance = $tolerance,
+    .toleranceDefined = $toleranceDefined,
+    .providesDirectionalDerivative = $providesDirectionalDerivative,
+    .canGetAndSetFMUstate = $canGetAndSetFMUstate,
+    .canSerializeFMUstate = $canSerializeFMUstate,
+    .canBeInstantiatedOnlyOncePerProcess = $canBeInstantiatedOnlyOncePerProcess,
+    .coSimulation = $coSimulation,
+    .csProvidesDirectionalDerivative = $csProvidesDirectionalDerivative,
+    .csCanGetAndSetFMUstate = $csCanGetAndSetFMUstate,
+    .csCanSerializeFMUstate = $csCanSerializeFMUstate,
+    .csCanBeInstantiatedOnlyOncePerProcess = $csCanBeInstantiatedOnlyOncePerProcess,
+    .csCanHandleVariableCommunicationStepSize = $csCanHandleVariableCommunicationStepSize,
+    .csCanInterpolateInputs = $csCanInterpolateInputs,
+    .csMaxOutputDerivativeOrder = $csMaxOutputDerivativeOrder
 };
 EOT
\ No newline at end of file
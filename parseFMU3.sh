@@ -0,0 +1,248 @@
+#!/bin/bash
+
+# Équivalent de parseFMU.sh pour les FMU 3.0 : on parse le modelDescription.xml et on le met dans un fichier C.
+# En FMI 3.0 les variables sont typées par largeur (<Float64>, <Int32>...) et peuvent être des tableaux
+# (balises <Dimension>) : un tableau n'a qu'un seul valueReference pour tous ses éléments.
+output_file="modelDescription.c"
+xml=./fmu/modelDescription.xml
+
+# Le début du fichier C
+cat <<EOT > "$output_file"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum { FLOAT64, INT32, BOOLEAN } VarType;
+typedef enum { INDEPENDENT, STRUCTURAL_PARAMETER, PARAMETER, LOCAL, OUTPUT, INPUT, CALCULATED_PARAMETER } Causality;
+typedef enum { CONSTANT, FIXED, TUNABLE, DISCRETE, CONTINUOUS } Variability;
+typedef enum { EXACT, APPROX, CALCULATED, NO_INITIAL } Initial;
+
+typedef struct {
+	int version;
+	char *modelName;
+	char *description;
+	char *instantiationToken;
+	int numberOfEventIndicators;
+	int numberOfContinuousStates;
+	double startTime;
+	double stopTime;
+	double stepSize;
+	double tolerance;
+	int toleranceDefined;
+} ModelDescription;
+
+// Hot metadata of a variable, an array variable has a single value reference for all its elements
+typedef struct {
+    unsigned int valueReference;
+    unsigned int nElements;          // product of the <Dimension> sizes, 1 for a scalar
+    unsigned char type;              // VarType
+    unsigned char causality;         // Causality
+    unsigned char variability;       // Variability
+    unsigned char initial;           // Initial
+} ModelVariable;
+EOT
+
+
+# On met chaque enfant de <ModelVariables> sur une ligne : --noblanks retire les retours à la ligne
+# entre les balises, puis on découpe sur les balises de variables (auto-fermantes ou avec des <Dimension>).
+lines=$(xmllint --noblanks "$xml" | xmllint --xpath '//ModelVariables/*' - 2>/dev/null \
+        | grep -oP '<([A-Za-z0-9]+)\b[^>]*?(/>|>.*?</\1>)')
+
+# Premier passage : les valeurs de départ, pour résoudre les <Dimension valueReference="..."/>
+# qui désignent un paramètre structurel
+declare -A start_of
+while IFS= read -r line; do
+    [ -z "$line" ] && continue
+    valueReference=$(echo "$line" | grep -oP '^<[^>]*\svalueReference="\K[^"]+')
+    start=$(echo "$line" | grep -oP '^<[^>]*\sstart="\K[^"]+' || echo "")
+    if [ -n "$valueReference" ] && [ -n "$start" ]; then
+        start_of[$valueReference]=$start
+    fi
+done <<< "$lines"
+
+# Second passage : une ligne par variable enregistrable dans les tables C.
+# Seules les variables Float64, Int32 et Boolean sont gardées, les autres types (Float32, Int8..UInt64,
+# String, Binary, Clock) ne sont pas encore enregistrés par le simulateur.
+counter=0
+hot_rows=""
+description_rows=""
+names=""
+declare -A index_of
+declare -A elements_of
+declare -a derivative_of
+
+while IFS= read -r line; do
+    [ -z "$line" ] && continue
+
+    tag=$(echo "$line" | grep -oP '^<\K[A-Za-z0-9]+')
+    case $tag in
+        (Float64) type_enum="FLOAT64";;
+        (Int32) type_enum="INT32";;
+        (Boolean) type_enum="BOOLEAN";;
+        (*) continue;;
+    esac
+
+    # Les attributs sont lus dans la balise ouvrante seulement, pas dans les <Dimension>
+    head=$(echo "$line" | grep -oP '^<[^>]*>')
+    name=$(echo "$head" | grep -oP '\sname="\K[^"]+')
+    valueReference=$(echo "$head" | grep -oP '\svalueReference="\K[^"]+')
+    causality=$(echo "$head" | grep -oP '\scausality="\K[^"]+' || echo "")
+    variability=$(echo "$head" | grep -oP '\svariability="\K[^"]+' || echo "")
+    initial=$(echo "$head" | grep -oP '\sinitial="\K[^"]+' || echo "")
+    description=$(echo "$head" | grep -oP '\sdescription="\K[^"]+' || echo "")
+    # derivative (valueReference de l'état dont cette variable est la dérivée)
+    derivative=$(echo "$head" | grep -oP '\sderivative="\K[^"]+' || echo "")
+
+    # Nombre d'éléments : produit des tailles des <Dimension>, fixes (start) ou données par un paramètre structurel
+    nElements=1
+    for dimension in $(echo "$line" | grep -oP '<Dimension\s[^>]*>' | tr ' ' '\n' | grep -oP '^(start|valueReference)="[^"]+"'); do
+        size=""
+        case $dimension in
+            (start=*) size=$(echo "$dimension" | grep -oP '"\K[^"]+');;
+            (valueReference=*) size=${start_of[$(echo "$dimension" | grep -oP '"\K[^"]+')]};;
+        esac
+        if [ -z "$size" ]; then
+            echo "Error: the size of a dimension of $name is unknown" >&2
+            exit 1
+        fi
+        nElements=$((nElements * size))
+    done
+
+    # Causality, variability et initial vers les enums C (valeurs par défaut de la norme FMI 3.0)
+    case $causality in
+        (parameter) causality_enum="PARAMETER";;
+        (structuralParameter) causality_enum="STRUCTURAL_PARAMETER";;
+        (calculatedParameter) causality_enum="CALCULATED_PARAMETER";;
+        (input) causality_enum="INPUT";;
+        (output) causality_enum="OUTPUT";;
+        (independent) causality_enum="INDEPENDENT";;
+        (*) causality_enum="LOCAL";;
+    esac
+    case $variability in
+        (constant) variability_enum="CONSTANT";;
+        (fixed) variability_enum="FIXED";;
+        (tunable) variability_enum="TUNABLE";;
+        (discrete) variability_enum="DISCRETE";;
+        (continuous) variability_enum="CONTINUOUS";;
+        # Sans attribut variability, seules les variables Float64 sont continues
+        (*) if [ "$type_enum" = "FLOAT64" ]; then variability_enum="CONTINUOUS"; else variability_enum="DISCRETE"; fi;;
+    esac
+    case $initial in
+        (exact) initial_enum="EXACT";;
+        (approx) initial_enum="APPROX";;
+        (calculated) initial_enum="CALCULATED";;
+        (*)
+            case $causality_enum in
+                (PARAMETER|STRUCTURAL_PARAMETER) initial_enum="EXACT";;
+                (CALCULATED_PARAMETER|OUTPUT|LOCAL) initial_enum="CALCULATED";;
+                (*) initial_enum="NO_INITIAL";;
+            esac
+            if [ "$variability_enum" = "CONSTANT" ]; then
+                initial_enum="EXACT"
+            fi;;
+    esac
+
+    hot_rows+="    {$valueReference, $nElements, $type_enum, $causality_enum, $variability_enum, $initial_enum},"$'\n'
+    if [ -n "$description" ]; then
+        description_rows+="    \"$description\","$'\n'
+    else
+        description_rows+="    NULL,"$'\n'
+    fi
+    names+="$name"$'\n'
+    index_of[$valueReference]=$counter
+    elements_of[$valueReference]=$nElements
+    derivative_of[$counter]=$derivative
+    counter=$((counter + 1))
+done <<< "$lines"
+
+
+# Les tables sont statiques et constantes, comme pour FMI 2.0
+size=$((counter > 0 ? counter : 1))
+empty_value="    {0},"$'\n'
+empty_string="    NULL,"$'\n'
+{
+    printf 'static const ModelVariable model_variables[%d] = {\n%s};\n\n' "$size" "${hot_rows:-$empty_value}"
+    printf 'const char *const variable_descriptions[%d] = {\n%s};\n\n' "$size" "${description_rows:-$empty_string}"
+    printf 'const ModelVariable *get_variable_list() {\n    return model_variables;\n}\n\n'
+    printf 'int get_variable_count() {\n    return %d;\n}\n' "$counter"
+    printf '#define NVARIABLES %d\n' "$counter"
+} >> "$output_file"
+
+# Index des noms de variables (hachage parfait minimal), le même que pour FMI 2.0
+echo -n "$names" | LC_ALL=C awk -f "$(dirname "$0")/perfectHash.awk" >> "$output_file" || exit 1
+
+
+# Les états continus sont donnés par les <ContinuousStateDerivative> de <ModelStructure>, dans l'ordre
+# du vecteur d'état x ; un tableau de dérivées apporte autant d'états que d'éléments.
+numberOfContinuousStates=0
+nStateBlocks=0
+state_rows=""
+for valueReference in $(xmllint --xpath '//ModelStructure/ContinuousStateDerivative/@valueReference' "$xml" 2>/dev/null | grep -oP 'valueReference="\K[^"]+'); do
+    index=${index_of[$valueReference]}
+    state=${derivative_of[${index:-0}]}
+    if [ -z "$index" ] || [ -z "$state" ] || [ -z "${index_of[$state]}" ]; then
+        echo "Error: the derivative $valueReference in ModelStructure is not a Float64 variable with a derivative attribute" >&2
+        exit 1
+    fi
+    state_rows+="    {${index_of[$state]}, $index},"$'\n'
+    numberOfContinuousStates=$((numberOfContinuousStates + ${elements_of[$valueReference]}))
+    nStateBlocks=$((nStateBlocks + 1))
+done
+
+# Même chose pour les indicateurs d'événements, qui ne sont plus un attribut de <fmiModelDescription>
+numberOfEventIndicators=0
+for valueReference in $(xmllint --xpath '//ModelStructure/EventIndicator/@valueReference' "$xml" 2>/dev/null | grep -oP 'valueReference="\K[^"]+'); do
+    numberOfEventIndicators=$((numberOfEventIndicators + ${elements_of[$valueReference]:-1}))
+done
+
+cat <<EOT >> "$output_file"
+
+// Continuous state block: variable index of a state (scalar or array) and of its derivative
+typedef struct {
+    int state;
+    int derivative;
+} ContinuousState;
+
+EOT
+empty_state="    {-1, -1},"$'\n'
+printf 'const ContinuousState model_states[%d] = {\n%s};\n\n' "$((nStateBlocks > 0 ? nStateBlocks : 1))" "${state_rows:-$empty_state}" >> "$output_file"
+
+
+# On parse ensuite <fmiModelDescription> et le <DefaultExperiment> (optionnel)
+model=$(xmllint --xpath '/*' "$xml" | sed -n 's/\(<fmiModelDescription[^>]*>\).*/\1/p')
+version=$(echo $model | grep -oP 'fmiVersion="\K[^".]+')
+modelName=$(echo $model | grep -oP 'modelName="\K[^"]+')
+description=$(echo $model | grep -oP '\sdescription="\K[^"]+' || echo "")
+instantiationToken=$(echo $model | grep -oP 'instantiationToken="\K[^"]+')
+
+experiment=$(xmllint --xpath '//DefaultExperiment' "$xml" 2>/dev/null)
+startTime=$(echo $experiment | grep -oP 'startTime="\K[^"]+' || echo "")
+stopTime=$(echo $experiment | grep -oP 'stopTime="\K[^"]+' || echo "")
+stepSize=$(echo $experiment | grep -oP 'stepSize="\K[^"]+' || echo "")
+tolerance=$(echo $experiment | grep -oP 'tolerance="\K[^"]+' || echo "")
+
+# Valeurs par défaut si les attributs sont absents
+toleranceDefined=1
+if [ -z "$tolerance" ]; then
+    tolerance="0.0"
+    toleranceDefined=0
+fi
+startTime=${startTime:-0.0}
+stopTime=${stopTime:-1.0}
+stepSize=${stepSize:-1e-3}
+
+cat <<EOT >> "$output_file"
+ModelDescription model = {
+    .version = $version,
+    .modelName = "$modelName",
+    .description = "$description",
+    .instantiationToken = "$instantiationToken",
+    .numberOfEventIndicators = $numberOfEventIndicators,
+    .numberOfContinuousStates = $numberOfContinuousStates,
+    .startTime = $startTime,
+    .stopTime = $stopTime,
+    .stepSize = $stepSize,
+    .tolerance = $tolerance,
+    .toleranceDefined = $toleranceDefined
+};
+EOT
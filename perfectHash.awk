@@ -0,0 +1,169 @@
+# Génère un hachage parfait minimal (CHD, "compress, hash and displace") des noms de variables.
+#
+# Entrée : un nom de variable par ligne, dans l'ordre de get_variable_list().
+# Sortie : les tables C statiques et la fonction get_variable_index(), à ajouter à modelDescription.c.
+#
+# Chaque nom a trois hachages polynomiaux modulo un nombre premier : b (choix du seau), f et g.
+# Les seaux sont placés du plus gros au plus petit ; pour chacun on cherche un déplacement (d0, d1)
+# tel que (f + d0 * g + d1) mod n tombe sur une case libre pour tous ses noms.
+# Les calculs restent exacts en double car h * multiplicateur + c < 2^53.
+#
+# Doit être lancé avec LC_ALL=C pour que chaque octet soit un caractère.
+
+function name_hash(s, multiplier, h,    i, len) {
+    len = length(s)
+    for (i = 1; i <= len; i++) {
+        h = (h * multiplier + ord[substr(s, i, 1)]) % PRIME
+    }
+    return h
+}
+
+# Nom sous forme de chaîne littérale C
+function c_string(s) {
+    gsub(/\\/, "&&", s)
+    gsub(/"/, "\\\"", s)
+    return "\"" s "\""
+}
+
+# Essaie de placer tous les noms du seau avec le déplacement (d0, d1)
+function try_place(bucket, d0, d1,    j, k, pos, ok) {
+    ok = 1
+    for (j = 0; j < bucket_size[bucket]; j++) {
+        k = bucket_keys[bucket, j]
+        pos = (f[k] + d0 * g[k] + d1) % n
+        if (pos in slot || pos in taken) { ok = 0; break }
+        taken[pos] = 1
+    }
+    for (pos in taken) delete taken[pos]
+    if (!ok) return 0
+    for (j = 0; j < bucket_size[bucket]; j++) {
+        k = bucket_keys[bucket, j]
+        slot[(f[k] + d0 * g[k] + d1) % n] = k
+    }
+    return 1
+}
+
+# Construit le hachage pour une graine donnée, retourne 0 si un seau ne peut pas être placé
+function build(seed,    k, b, size, maxSize, order, nOrder, i, bucket, d0, d1, placed, cursor) {
+    for (k in slot) delete slot[k]
+    for (b = 0; b < r; b++) { bucket_size[b] = 0; disp0[b] = 0; disp1[b] = 0 }
+
+    for (k = 0; k < n; k++) {
+        b = name_hash(name[k], 65599 + 2 * seed, 0) % r
+        f[k] = name_hash(name[k], 31 + 2 * seed, 5381) % n
+        g[k] = name_hash(name[k], 131 + 2 * seed, 7) % n
+        bucket_keys[b, bucket_size[b]++] = k
+    }
+
+    # Tri des seaux par taille décroissante (tri par dénombrement)
+    maxSize = 0
+    for (b = 0; b < r; b++) {
+        if (bucket_size[b] > maxSize) maxSize = bucket_size[b]
+        bucket_count[bucket_size[b]]++
+        bucket_by_size[bucket_size[b], bucket_count[bucket_size[b]] - 1] = b
+    }
+    nOrder = 0
+    for (size = maxSize; size >= 1; size--) {
+        for (i = 0; i < bucket_count[size]; i++) order[nOrder++] = bucket_by_size[size, i]
+    }
+    for (size = 0; size <= maxSize; size++) bucket_count[size] = 0
+
+    cursor = 0
+    for (i = 0; i < nOrder; i++) {
+        bucket = order[i]
+        if (bucket_size[bucket] == 1) {
+            # Les seaux d'un seul nom viennent en dernier : on prend directement la prochaine case libre
+            while (cursor in slot) cursor++
+            k = bucket_keys[bucket, 0]
+            slot[cursor] = k
+            disp0[bucket] = 0
+            disp1[bucket] = (cursor - f[k] + n) % n
+            continue
+        }
+        placed = 0
+        for (d0 = 0; d0 < n && !placed; d0++) {
+            for (d1 = 0; d1 < n; d1++) {
+                if (try_place(bucket, d0, d1)) {
+                    disp0[bucket] = d0
+                    disp1[bucket] = d1
+                    placed = 1
+                    break
+                }
+            }
+        }
+        if (!placed) return 0
+    }
+    return 1
+}
+
+BEGIN {
+    PRIME = 4294967291
+    for (i = 1; i < 256; i++) ord[sprintf("%c", i)] = i
+    n = 0
+}
+
+{
+    name[n++] = $0
+}
+
+END {
+    r = int((n + 1) / 2)
+    if (r < 1) r = 1
+
+    seed = 0
+    if (n > 0) {
+        while (!build(seed)) {
+            # Seuls des noms en double empêchent la construction pour toutes les graines
+            if (++seed == 64) {
+                print "perfectHash.awk: cannot build the name index, are variable names unique?" > "/dev/stderr"
+                exit 1
+            }
+        }
+    }
+
+    printf "\n// Minimal perfect hash of the variable names, generated by perfectHash.awk\n"
+    printf "#define VARIABLE_HASH_SEED %d\n", seed
+    printf "#define VARIABLE_HASH_BUCKETS %d\n", r
+    printf "#define VARIABLE_HASH_SIZE %d\n\n", n
+
+    printf "static const char *const variable_names[%d] = {\n", (n > 0 ? n : 1)
+    for (k = 0; k < n; k++) printf "    %s,\n", c_string(name[k])
+    if (n == 0) printf "    NULL\n"
+    printf "};\n\n"
+
+    printf "static const unsigned int variable_hash_displacements[%d][2] = {\n", r
+    for (b = 0; b < r; b++) printf "    {%d, %d},\n", disp0[b], disp1[b]
+    printf "};\n\n"
+
+    printf "static const int variable_hash_slots[%d] = {\n", (n > 0 ? n : 1)
+    for (k = 0; k < n; k++) printf "    %d,\n", slot[k]
+    if (n == 0) printf "    -1\n"
+    printf "};\n\n"
+
+    if (n == 0) {
+        print "// Index of the variable called name in get_variable_list(), -1 if there is no such variable"
+        print "int get_variable_index(const char *name) {"
+        print "    return -1;"
+        print "}"
+        exit
+    }
+
+    print "static unsigned long long variable_name_hash(const char *name, unsigned long long multiplier,"
+    print "                                             unsigned long long h) {"
+    print "    for (const unsigned char *p = (const unsigned char*)name; *p; p++) {"
+    print "        h = (h * multiplier + *p) % 4294967291ULL;"
+    print "    }"
+    print "    return h;"
+    print "}"
+    print ""
+    print "// Index of the variable called name in get_variable_list(), -1 if there is no such variable"
+    print "int get_variable_index(const char *name) {"
+    print "    unsigned long long b = variable_name_hash(name, 65599 + 2 * VARIABLE_HASH_SEED, 0) % VARIABLE_HASH_BUCKETS;"
+    print "    unsigned long long f = variable_name_hash(name, 31 + 2 * VARIABLE_HASH_SEED, 5381) % VARIABLE_HASH_SIZE;"
+    print "    unsigned long long g = variable_name_hash(name, 131 + 2 * VARIABLE_HASH_SEED, 7) % VARIABLE_HASH_SIZE;"
+    print "    unsigned long long pos = (f + variable_hash_displacements[b][0] * g"
+    print "                              + variable_hash_displacements[b][1]) % VARIABLE_HASH_SIZE;"
+    print "    int index = variable_hash_slots[pos];"
+    print "    return strcmp(variable_names[index], name) == 0 ? index : -1;"
+    print "}"
+}
@@ -0,0 +1,135 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+#define REALTIME_BINS 24             // wake-up latency histogram, bin k counts [2^(k-1), 2^k) us
+
+/**
+ * @struct RealTime
+ * @brief Paces the simulation on the wall clock, model time t being due at start + (t - tStart) / scale.
+ *
+ * The deadlines are absolute, so a late step does not shift the following ones and the schedule
+ * does not drift. A step which ends after its deadline is an overrun. Otherwise the thread sleeps
+ * until the deadline with clock_nanosleep(TIMER_ABSTIME), and the delay of its wake-up, the jitter
+ * seen by the hardware in the loop, is added to a histogram.
+ */
+typedef struct {
+    int enabled;
+    double scale;                    // model seconds per wall clock second, 1 by default
+    int lockMemory;                  // mlockall, no page fault during the run
+    int priority;                    // SCHED_FIFO priority, 0 to keep the default scheduler
+    int cpu;                         // CPU the process is pinned to, -1 if none
+    double tStart;
+    struct timespec start;           // wall clock time of tStart, CLOCK_MONOTONIC
+    struct timespec stepStart;       // wall clock time at which the current step started
+    size_t nSteps;
+    size_t nOverruns;
+    double maxOverrun;               // latest end of a step after its deadline, in seconds
+    double maxStep;                  // longest step, in seconds
+    double sumStep;
+    double maxJitter;                // latest wake-up after a deadline, in seconds
+    size_t histogram[REALTIME_BINS];
+} RealTime;
+
+static double elapsedSeconds(const struct timespec *from, const struct timespec *to) {
+    return (double)(to->tv_sec - from->tv_sec) + 1e-9 * (double)(to->tv_nsec - from->tv_nsec);
+}
+
+static struct timespec addSeconds(struct timespec time, double seconds) {
+    long long ns = (long long)(seconds * 1e9 + 0.5);
+    time.tv_sec += (time_t)(ns / 1000000000LL);
+    time.tv_nsec += (long)(ns % 1000000000LL);
+    if (time.tv_nsec >= 1000000000L) {
+        time.tv_sec++;
+        time.tv_nsec -= 1000000000L;
+    }
+    return time;
+}
+
+/**
+ * @brief Locks the memory, sets the scheduler and the CPU, then starts the clock at model time tStart.
+ *
+ * The privileges which are missing, usually CAP_SYS_NICE or CAP_IPC_LOCK, are reported and the run
+ * goes on without them.
+ */
+void startRealTime(RealTime *realTime, double tStart) {
+    if (realTime->scale <= 0) realTime->scale = 1;
+    if (realTime->lockMemory && mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        printf("Warning: mlockall failed: %s\n", strerror(errno));
+    }
+    if (realTime->cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(realTime->cpu, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+            printf("Warning: could not pin to CPU %d: %s\n", realTime->cpu, strerror(errno));
+        }
+    }
+    if (realTime->priority > 0) {
+        struct sched_param param = {0};
+        param.sched_priority = realTime->priority;
+        if (sched_setscheduler(0, SCHED_FIFO, &param) != 0) {
+            printf("Warning: SCHED_FIFO priority %d refused: %s\n", realTime->priority, strerror(errno));
+        }
+    }
+    realTime->tStart = tStart;
+    clock_gettime(CLOCK_MONOTONIC, &realTime->start);
+    realTime->stepStart = realTime->start;
+}
+
+/**
+ * @brief Ends the step which reached model time t: counts an overrun, or sleeps until its deadline.
+ */
+void waitRealTime(RealTime *realTime, double time) {
+    struct timespec now, deadline = addSeconds(realTime->start, (time - realTime->tStart) / realTime->scale);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    double step = elapsedSeconds(&realTime->stepStart, &now);
+    realTime->nSteps++;
+    realTime->sumStep += step;
+    if (step > realTime->maxStep) realTime->maxStep = step;
+
+    double late = elapsedSeconds(&deadline, &now);
+    if (late > 0) {
+        realTime->nOverruns++;
+        if (late > realTime->maxOverrun) realTime->maxOverrun = late;
+        realTime->stepStart = now;
+        return;
+    }
+
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double jitter = elapsedSeconds(&deadline, &now);
+    if (jitter > realTime->maxJitter) realTime->maxJitter = jitter;
+    int bin = 0;
+    for (double us = jitter * 1e6; us >= 1 && bin < REALTIME_BINS - 1; us /= 2) bin++;
+    realTime->histogram[bin]++;
+    realTime->stepStart = now;
+}
+
+/**
+ * @brief Prints the overruns, the step times against the budget h / scale and the jitter histogram.
+ */
+void reportRealTime(const RealTime *realTime, double h) {
+    double budget = h / realTime->scale;
+    printf("Real time: %zu steps, %zu overruns", realTime->nSteps, realTime->nOverruns);
+    if (realTime->nOverruns > 0) printf(", up to %.1f us late", 1e6 * realTime->maxOverrun);
+    printf("\n");
+    if (realTime->nSteps == 0) return;
+    printf("Step time: mean %.1f us, max %.1f us, budget %.1f us (%.0f%% used at worst)\n",
+           1e6 * realTime->sumStep / realTime->nSteps, 1e6 * realTime->maxStep, 1e6 * budget,
+           100 * realTime->maxStep / budget);
+    printf("Wake-up jitter: max %.1f us\n", 1e6 * realTime->maxJitter);
+    for (int k = 0; k < REALTIME_BINS; k++) {
+        if (realTime->histogram[k] == 0) continue;
+        if (k == 0) {
+            printf("  [0, 1) us: %zu\n", realTime->histogram[k]);
+        } else {
+            printf("  [%ld, %ld) us: %zu\n", 1L << (k - 1), 1L << k, realTime->histogram[k]);
+        }
+    }
+}
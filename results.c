@@ -0,0 +1,380 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "headers/fmi2TypesPlatform.h"
+#include "headers/fmi2FunctionTypes.h"
+#include "headers/fmi2Functions.h"
+
+/**
+ * @struct StringPool
+ * @brief Interned strings, each distinct string is stored once and referred to by an id.
+ *
+ * The characters live in one growable buffer, an open addressing hash table maps a string to its id.
+ */
+typedef struct {
+    char *chars;                     // all strings, '\0' terminated, one after the other
+    size_t charsSize;
+    size_t charsCapacity;
+    size_t *offsets;                 // offset of each string in chars, indexed by id
+    unsigned int count;
+    unsigned int capacity;
+    unsigned int *table;             // hash table of ids + 1, 0 for an empty slot
+    unsigned int tableSize;          // power of two
+} StringPool;
+
+/**
+ * @struct Results
+ * @brief Recorded values of all the model variables, in compact columns of their own type.
+ *
+ * Each variable owns one column in the block of its type: doubles for Real, fmi2Integer for
+ * Integer and Enumeration, one bit per row for Boolean and a string pool id for String.
+ * The value references of each type are gathered so a row is fetched with one call per type.
+ */
+typedef struct {
+    int nReal;
+    int nInteger;
+    int nBoolean;
+    int nString;
+    fmi2ValueReference *realVRs;
+    fmi2ValueReference *integerVRs;
+    fmi2ValueReference *booleanVRs;
+    fmi2ValueReference *stringVRs;
+    int *column;                     // column of each variable in the block of its type
+    double **realColumns;
+    fmi2Integer **integerColumns;
+    unsigned char **booleanColumns;  // bit-packed, row j is bit (j % 8) of byte j / 8
+    unsigned int **stringColumns;    // ids in strings
+    StringPool strings;
+    double *realBuffer;              // one row, as returned by getReal
+    fmi2Integer *integerBuffer;
+    fmi2Boolean *booleanBuffer;
+    fmi2String *stringBuffer;
+    size_t nRows;
+    size_t capacity;                 // allocated rows per column
+} Results;
+
+static unsigned int hashString(const char *s) {
+    unsigned int h = 2166136261u;
+    for (const unsigned char *p = (const unsigned char*)s; *p; p++) {
+        h = (h ^ *p) * 16777619u;
+    }
+    return h;
+}
+
+/**
+ * @brief Returns the id of a string in the pool, adding a copy of it if it is not there yet.
+ *
+ * @param pool The string pool.
+ * @param s The string to intern, NULL is interned as an empty string.
+ * @return The id of the string, (unsigned int)-1 if memory is exhausted.
+ */
+unsigned int internString(StringPool *pool, const char *s) {
+    if (!s) s = "";
+
+    // Keep the hash table at most half full
+    if (2 * (pool->count + 1) > pool->tableSize) {
+        unsigned int tableSize = pool->tableSize ? 2 * pool->tableSize : 64;
+        unsigned int *table = (unsigned int*)calloc(tableSize, sizeof(unsigned int));
+        if (!table) return (unsigned int)-1;
+        for (unsigned int id = 0; id < pool->count; id++) {
+            unsigned int slot = hashString(pool->chars + pool->offsets[id]) & (tableSize - 1);
+            while (table[slot]) slot = (slot + 1) & (tableSize - 1);
+            table[slot] = id + 1;
+        }
+        free(pool->table);
+        pool->table = table;
+        pool->tableSize = tableSize;
+    }
+
+    unsigned int slot = hashString(s) & (pool->tableSize - 1);
+    while (pool->table[slot]) {
+        unsigned int id = pool->table[slot] - 1;
+        if (strcmp(pool->chars + pool->offsets[id], s) == 0) return id;
+        slot = (slot + 1) & (pool->tableSize - 1);
+    }
+
+    size_t length = strlen(s) + 1;
+    if (pool->charsSize + length > pool->charsCapacity) {
+        size_t charsCapacity = pool->charsCapacity ? 2 * pool->charsCapacity : 4096;
+        while (charsCapacity < pool->charsSize + length) charsCapacity *= 2;
+        char *chars = (char*)realloc(pool->chars, charsCapacity);
+        if (!chars) return (unsigned int)-1;
+        pool->chars = chars;
+        pool->charsCapacity = charsCapacity;
+    }
+    if (pool->count == pool->capacity) {
+        unsigned int capacity = pool->capacity ? 2 * pool->capacity : 64;
+        size_t *offsets = (size_t*)realloc(pool->offsets, capacity * sizeof(size_t));
+        if (!offsets) return (unsigned int)-1;
+        pool->offsets = offsets;
+        pool->capacity = capacity;
+    }
+
+    memcpy(pool->chars + pool->charsSize, s, length);
+    pool->offsets[pool->count] = pool->charsSize;
+    pool->charsSize += length;
+    pool->table[slot] = pool->count + 1;
+    return pool->count++;
+}
+
+/**
+ * @brief Returns the string with the given id.
+ */
+const char* getInternedString(const StringPool *pool, unsigned int id) {
+    return pool->chars + pool->offsets[id];
+}
+
+/**
+ * @brief Frees the memory held by a string pool.
+ */
+void freeStringPool(StringPool *pool) {
+    free(pool->chars);
+    free(pool->offsets);
+    free(pool->table);
+    memset(pool, 0, sizeof(StringPool));
+}
+
+/**
+ * @brief Reallocates every column of the results to hold capacity rows.
+ *
+ * @return 0 on success, -1 if memory is exhausted.
+ */
+static int growResults(Results *results, size_t capacity) {
+    size_t oldBytes = (results->capacity + 7) / 8;
+    size_t newBytes = (capacity + 7) / 8;
+
+    for (int k = 0; k < results->nReal; k++) {
+        double *column = (double*)realloc(results->realColumns[k], capacity * sizeof(double));
+        if (!column) return -1;
+        results->realColumns[k] = column;
+    }
+    for (int k = 0; k < results->nInteger; k++) {
+        fmi2Integer *column = (fmi2Integer*)realloc(results->integerColumns[k], capacity * sizeof(fmi2Integer));
+        if (!column) return -1;
+        results->integerColumns[k] = column;
+    }
+    for (int k = 0; k < results->nBoolean; k++) {
+        unsigned char *column = (unsigned char*)realloc(results->booleanColumns[k], newBytes);
+        if (!column) return -1;
+        memset(column + oldBytes, 0, newBytes - oldBytes);
+        results->booleanColumns[k] = column;
+    }
+    for (int k = 0; k < results->nString; k++) {
+        unsigned int *column = (unsigned int*)realloc(results->stringColumns[k], capacity * sizeof(unsigned int));
+        if (!column) return -1;
+        results->stringColumns[k] = column;
+    }
+
+    results->capacity = capacity;
+    return 0;
+}
+
+/**
+ * @brief Frees the memory held by the results.
+ */
+void freeResults(Results *results) {
+    for (int k = 0; results->realColumns && k < results->nReal; k++) free(results->realColumns[k]);
+    for (int k = 0; results->integerColumns && k < results->nInteger; k++) free(results->integerColumns[k]);
+    for (int k = 0; results->booleanColumns && k < results->nBoolean; k++) free(results->booleanColumns[k]);
+    for (int k = 0; results->stringColumns && k < results->nString; k++) free(results->stringColumns[k]);
+    free(results->realColumns);
+    free(results->integerColumns);
+    free(results->booleanColumns);
+    free(results->stringColumns);
+    free(results->realVRs);
+    free(results->integerVRs);
+    free(results->booleanVRs);
+    free(results->stringVRs);
+    free(results->column);
+    free(results->realBuffer);
+    free(results->integerBuffer);
+    free(results->booleanBuffer);
+    free(results->stringBuffer);
+    freeStringPool(&results->strings);
+    memset(results, 0, sizeof(Results));
+}
+
+/**
+ * @brief Sorts the variables into typed columns and allocates the results.
+ *
+ * @param results The results to initialize.
+ * @param variables The model variables.
+ * @param nVariables The number of model variables.
+ * @param capacity The expected number of rows, the columns grow if more are recorded.
+ * @return 0 on success, -1 if memory is exhausted.
+ */
+int initResults(Results *results, const ScalarVariable *variables, int nVariables, size_t capacity) {
+    memset(results, 0, sizeof(Results));
+
+    results->column = (int*)malloc((nVariables > 0 ? nVariables : 1) * sizeof(int));
+    if (!results->column) return -1;
+
+    for (int i = 0; i < nVariables; i++) {
+        switch (variables[i].type) {
+            case REAL: results->column[i] = results->nReal++; break;
+            case INTEGER:
+            case ENUMERATION: results->column[i] = results->nInteger++; break;
+            case BOOLEAN: results->column[i] = results->nBoolean++; break;
+            case STRING: results->column[i] = results->nString++; break;
+        }
+    }
+
+    results->realVRs = (fmi2ValueReference*)malloc((results->nReal + 1) * sizeof(fmi2ValueReference));
+    results->integerVRs = (fmi2ValueReference*)malloc((results->nInteger + 1) * sizeof(fmi2ValueReference));
+    results->booleanVRs = (fmi2ValueReference*)malloc((results->nBoolean + 1) * sizeof(fmi2ValueReference));
+    results->stringVRs = (fmi2ValueReference*)malloc((results->nString + 1) * sizeof(fmi2ValueReference));
+    results->realColumns = (double**)calloc(results->nReal + 1, sizeof(double*));
+    results->integerColumns = (fmi2Integer**)calloc(results->nInteger + 1, sizeof(fmi2Integer*));
+    results->booleanColumns = (unsigned char**)calloc(results->nBoolean + 1, sizeof(unsigned char*));
+    results->stringColumns = (unsigned int**)calloc(results->nString + 1, sizeof(unsigned int*));
+    results->realBuffer = (double*)malloc((results->nReal + 1) * sizeof(double));
+    results->integerBuffer = (fmi2Integer*)malloc((results->nInteger + 1) * sizeof(fmi2Integer));
+    results->booleanBuffer = (fmi2Boolean*)malloc((results->nBoolean + 1) * sizeof(fmi2Boolean));
+    results->stringBuffer = (fmi2String*)malloc((results->nString + 1) * sizeof(fmi2String));
+    if (!results->realVRs || !results->integerVRs || !results->booleanVRs || !results->stringVRs ||
+        !results->realColumns || !results->integerColumns || !results->booleanColumns || !results->stringColumns ||
+        !results->realBuffer || !results->integerBuffer || !results->booleanBuffer || !results->stringBuffer) {
+        freeResults(results);
+        return -1;
+    }
+
+    for (int i = 0; i < nVariables; i++) {
+        switch (variables[i].type) {
+            case REAL: results->realVRs[results->column[i]] = variables[i].valueReference; break;
+            case INTEGER:
+            case ENUMERATION: results->integerVRs[results->column[i]] = variables[i].valueReference; break;
+            case BOOLEAN: results->booleanVRs[results->column[i]] = variables[i].valueReference; break;
+            case STRING: results->stringVRs[results->column[i]] = variables[i].valueReference; break;
+        }
+    }
+
+    if (growResults(results, capacity > 0 ? capacity : 1) != 0) {
+        freeResults(results);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Fetches the current value of every variable and appends them as a new row.
+ *
+ * Values are fetched with one getReal, getInteger, getBoolean and getString call each.
+ *
+ * @param fmu Pointer to the FMU structure
+ * @param component The FMU instance
+ * @param results The results to append to
+ * @return fmi2Status The worst status returned by the FMU, fmi2Error if memory is exhausted
+ */
+fmi2Status recordResults(FMU *fmu, fmi2Component component, Results *results) {
+    fmi2Status status = fmi2OK;
+    fmi2Status fmi2Flag;
+    size_t row = results->nRows;
+
+    if (row == results->capacity && growResults(results, 2 * results->capacity) != 0) {
+        return fmi2Error;
+    }
+
+    if (results->nReal > 0) {
+        fmi2Flag = fmu->getReal(component, results->realVRs, results->nReal, results->realBuffer);
+        if (fmi2Flag > status) status = fmi2Flag;
+        for (int k = 0; k < results->nReal; k++) {
+            results->realColumns[k][row] = results->realBuffer[k];
+        }
+    }
+
+    if (results->nInteger > 0) {
+        fmi2Flag = fmu->getInteger(component, results->integerVRs, results->nInteger, results->integerBuffer);
+        if (fmi2Flag > status) status = fmi2Flag;
+        for (int k = 0; k < results->nInteger; k++) {
+            results->integerColumns[k][row] = results->integerBuffer[k];
+        }
+    }
+
+    if (results->nBoolean > 0) {
+        fmi2Flag = fmu->getBoolean(component, results->booleanVRs, results->nBoolean, results->booleanBuffer);
+        if (fmi2Flag > status) status = fmi2Flag;
+        unsigned char mask = (unsigned char)(1u << (row % 8));
+        for (int k = 0; k < results->nBoolean; k++) {
+            if (results->booleanBuffer[k]) {
+                results->booleanColumns[k][row / 8] |= mask;
+            } else {
+                results->booleanColumns[k][row / 8] &= (unsigned char)~mask;
+            }
+        }
+    }
+
+    if (results->nString > 0) {
+        fmi2Flag = fmu->getString(component, results->stringVRs, results->nString, results->stringBuffer);
+        if (fmi2Flag > status) status = fmi2Flag;
+        for (int k = 0; k < results->nString; k++) {
+            // Strings returned by the FMU are only valid until the next call, keep our own copy
+            unsigned int id = internString(&results->strings, fmi2Flag > fmi2Warning ? "" : results->stringBuffer[k]);
+            if (id == (unsigned int)-1) return fmi2Error;
+            results->stringColumns[k][row] = id;
+        }
+    }
+
+    results->nRows++;
+    return status;
+}
+
+/**
+ * @brief Returns the recorded value of a numeric variable as a double.
+ *
+ * Strings have no numeric value, their pool id is returned.
+ *
+ * @param results The recorded results.
+ * @param variables The model variables.
+ * @param i The index of the variable.
+ * @param row The row to read.
+ */
+double getResultValue(const Results *results, const ScalarVariable *variables, int i, size_t row) {
+    int k = results->column[i];
+    switch (variables[i].type) {
+        case REAL: return results->realColumns[k][row];
+        case INTEGER:
+        case ENUMERATION: return (double)results->integerColumns[k][row];
+        case BOOLEAN: return (double)((results->booleanColumns[k][row / 8] >> (row % 8)) & 1);
+        case STRING: return (double)results->stringColumns[k][row];
+    }
+    return 0;
+}
+
+/**
+ * @brief Prints the recorded value of a variable in its own format.
+ *
+ * Reals are printed with "%f", Integers and Enumerations as integers, Booleans as 0 or 1
+ * and Strings between double quotes.
+ *
+ * @param file The stream to print to.
+ * @param results The recorded results.
+ * @param variables The model variables.
+ * @param i The index of the variable.
+ * @param row The row to print.
+ */
+void printResultValue(FILE *file, const Results *results, const ScalarVariable *variables, int i, size_t row) {
+    int k = results->column[i];
+    switch (variables[i].type) {
+        case REAL:
+            fprintf(file, "%f", results->realColumns[k][row]);
+            break;
+        case INTEGER:
+        case ENUMERATION:
+            fprintf(file, "%d", results->integerColumns[k][row]);
+            break;
+        case BOOLEAN:
+            fprintf(file, "%d", (results->booleanColumns[k][row / 8] >> (row % 8)) & 1);
+            break;
+        case STRING: {
+            // Quoted as in CSV, an embedded quote is doubled
+            const char *s = getInternedString(&results->strings, results->stringColumns[k][row]);
+            fputc('"', file);
+            for (; *s; s++) {
+                if (*s == '"') fputc('"', file);
+                fputc(*s, file);
+            }
+            fputc('"', file);
+            break;
+        }
+    }
+}
@@ -0,0 +1,211 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "headers/fmi3PlatformTypes.h"
+#include "headers/fmi3FunctionTypes.h"
+#include "headers/fmi3Functions.h"
+
+/**
+ * @struct Results
+ * @brief Recorded values of all the FMI 3.0 model variables, one contiguous block per type and row.
+ *
+ * The variables of each type are gathered so a row is fetched with one getFloat64, getInt32 and
+ * getBoolean call, written directly into the results: a row of a type is the concatenation of the
+ * elements of its variables in model order, an array variable being one contiguous block.
+ * Rows are stored one after the other, unlike the columns of the FMI 2.0 results, because a single
+ * get of an array already returns all its elements for the current row.
+ */
+typedef struct {
+    size_t nFloat64;                 // number of Float64 value references
+    size_t nInt32;
+    size_t nBoolean;
+    size_t nFloat64Values;           // number of Float64 elements in a row
+    size_t nInt32Values;
+    size_t nBooleanValues;
+    fmi3ValueReference *float64VRs;
+    fmi3ValueReference *int32VRs;
+    fmi3ValueReference *booleanVRs;
+    size_t *offset;                  // offset of the first element of each variable in a row of its type
+    fmi3Float64 *float64Rows;        // nRows rows of nFloat64Values elements
+    fmi3Int32 *int32Rows;
+    fmi3Boolean *booleanRows;
+    size_t nRows;
+    size_t capacity;                 // allocated rows
+} Results;
+
+/**
+ * @brief Grows the rows of the results to hold capacity rows.
+ *
+ * @return 0 on success, -1 if memory is exhausted.
+ */
+static int growResults(Results *results, size_t capacity) {
+    fmi3Float64 *float64Rows = (fmi3Float64*)realloc(results->float64Rows,
+                                                     (capacity * results->nFloat64Values + 1) * sizeof(fmi3Float64));
+    if (!float64Rows) return -1;
+    results->float64Rows = float64Rows;
+
+    fmi3Int32 *int32Rows = (fmi3Int32*)realloc(results->int32Rows,
+                                               (capacity * results->nInt32Values + 1) * sizeof(fmi3Int32));
+    if (!int32Rows) return -1;
+    results->int32Rows = int32Rows;
+
+    fmi3Boolean *booleanRows = (fmi3Boolean*)realloc(results->booleanRows,
+                                                     (capacity * results->nBooleanValues + 1) * sizeof(fmi3Boolean));
+    if (!booleanRows) return -1;
+    results->booleanRows = booleanRows;
+
+    results->capacity = capacity;
+    return 0;
+}
+
+/**
+ * @brief Frees the memory held by the results.
+ */
+void freeResults(Results *results) {
+    free(results->float64VRs);
+    free(results->int32VRs);
+    free(results->booleanVRs);
+    free(results->offset);
+    free(results->float64Rows);
+    free(results->int32Rows);
+    free(results->booleanRows);
+    memset(results, 0, sizeof(Results));
+}
+
+/**
+ * @brief Sorts the variables into typed blocks and allocates the results.
+ *
+ * @param results The results to initialize.
+ * @param variables The model variables.
+ * @param nVariables The number of model variables.
+ * @param capacity The expected number of rows, the results grow if more are recorded.
+ * @return 0 on success, -1 if memory is exhausted.
+ */
+int initResults(Results *results, const ModelVariable *variables, int nVariables, size_t capacity) {
+    memset(results, 0, sizeof(Results));
+
+    results->offset = (size_t*)malloc((nVariables > 0 ? nVariables : 1) * sizeof(size_t));
+    results->float64VRs = (fmi3ValueReference*)malloc((nVariables + 1) * sizeof(fmi3ValueReference));
+    results->int32VRs = (fmi3ValueReference*)malloc((nVariables + 1) * sizeof(fmi3ValueReference));
+    results->booleanVRs = (fmi3ValueReference*)malloc((nVariables + 1) * sizeof(fmi3ValueReference));
+    if (!results->offset || !results->float64VRs || !results->int32VRs || !results->booleanVRs) {
+        freeResults(results);
+        return -1;
+    }
+
+    for (int i = 0; i < nVariables; i++) {
+        switch (variables[i].type) {
+            case FLOAT64:
+                results->float64VRs[results->nFloat64++] = variables[i].valueReference;
+                results->offset[i] = results->nFloat64Values;
+                results->nFloat64Values += variables[i].nElements;
+                break;
+            case INT32:
+                results->int32VRs[results->nInt32++] = variables[i].valueReference;
+                results->offset[i] = results->nInt32Values;
+                results->nInt32Values += variables[i].nElements;
+                break;
+            case BOOLEAN:
+                results->booleanVRs[results->nBoolean++] = variables[i].valueReference;
+                results->offset[i] = results->nBooleanValues;
+                results->nBooleanValues += variables[i].nElements;
+                break;
+        }
+    }
+
+    if (growResults(results, capacity > 0 ? capacity : 1) != 0) {
+        freeResults(results);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Fetches the current value of every variable and appends them as a new row.
+ *
+ * Values are fetched with one getFloat64, getInt32 and getBoolean call each, whatever the size
+ * of the arrays.
+ *
+ * @param fmu Pointer to the FMU3 structure
+ * @param instance The FMU instance
+ * @param results The results to append to
+ * @return fmi3Status The worst status returned by the FMU, fmi3Error if memory is exhausted
+ */
+fmi3Status recordResults(FMU3 *fmu, fmi3Instance instance, Results *results) {
+    fmi3Status status = fmi3OK;
+    fmi3Status fmi3Flag;
+    size_t row = results->nRows;
+
+    if (row == results->capacity && growResults(results, 2 * results->capacity) != 0) {
+        return fmi3Error;
+    }
+
+    if (results->nFloat64 > 0) {
+        fmi3Flag = fmu->getFloat64(instance, results->float64VRs, results->nFloat64,
+                                   results->float64Rows + row * results->nFloat64Values, results->nFloat64Values);
+        if (fmi3Flag > status) status = fmi3Flag;
+    }
+
+    if (results->nInt32 > 0) {
+        fmi3Flag = fmu->getInt32(instance, results->int32VRs, results->nInt32,
+                                 results->int32Rows + row * results->nInt32Values, results->nInt32Values);
+        if (fmi3Flag > status) status = fmi3Flag;
+    }
+
+    if (results->nBoolean > 0) {
+        fmi3Flag = fmu->getBoolean(instance, results->booleanVRs, results->nBoolean,
+                                   results->booleanRows + row * results->nBooleanValues, results->nBooleanValues);
+        if (fmi3Flag > status) status = fmi3Flag;
+    }
+
+    results->nRows++;
+    return status;
+}
+
+/**
+ * @brief Returns the recorded elements of a variable in a row, a contiguous block of nElements values.
+ *
+ * The returned pointer must be cast to the type of the variable (fmi3Float64, fmi3Int32 or fmi3Boolean)
+ * and is only valid until the next recordResults.
+ *
+ * @param results The recorded results.
+ * @param variables The model variables.
+ * @param i The index of the variable.
+ * @param row The row to read.
+ */
+const void* getResultBlock(const Results *results, const ModelVariable *variables, int i, size_t row) {
+    switch (variables[i].type) {
+        case FLOAT64: return results->float64Rows + row * results->nFloat64Values + results->offset[i];
+        case INT32: return results->int32Rows + row * results->nInt32Values + results->offset[i];
+        case BOOLEAN: return results->booleanRows + row * results->nBooleanValues + results->offset[i];
+    }
+    return NULL;
+}
+
+/**
+ * @brief Prints one recorded element of a variable in its own format.
+ *
+ * Float64 values are printed with "%f", Int32 as integers and Booleans as 0 or 1.
+ *
+ * @param file The stream to print to.
+ * @param results The recorded results.
+ * @param variables The model variables.
+ * @param i The index of the variable.
+ * @param element The element to print, 0 for a scalar.
+ * @param row The row to print.
+ */
+void printResultValue(FILE *file, const Results *results, const ModelVariable *variables, int i,
+                      size_t element, size_t row) {
+    const void *block = getResultBlock(results, variables, i, row);
+    switch (variables[i].type) {
+        case FLOAT64:
+            fprintf(file, "%f", ((const fmi3Float64*)block)[element]);
+            break;
+        case INT32:
+            fprintf(file, "%d", ((const fmi3Int32*)block)[element]);
+            break;
+        case BOOLEAN:
+            fprintf(file, "%d", ((const fmi3Boolean*)block)[element] ? 1 : 0);
+            break;
+    }
+}
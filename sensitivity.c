@@ -0,0 +1,288 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include "headers/fmi2TypesPlatform.h"
+#include "headers/fmi2FunctionTypes.h"
+#include "headers/fmi2Functions.h"
+
+/**
+ * @struct Sensitivities
+ * @brief Forward sensitivities of the Real outputs to a set of parameters.
+ *
+ * For each parameter p the state sensitivity s = dx/dp follows ds/dt = df/dx s + df/dp, integrated
+ * with the same steps as the states. Both right-hand sides and the output sensitivities
+ * dy/dp = dg/dx s + dg/dp are one directional derivative per parameter, seeded with s for the
+ * states and 1 for an input. In continuous-time mode the knowns of a directional derivative are
+ * the states and the inputs only, so df/dp and dg/dp of a parameter are a forward difference
+ * over setReal, added to the directional derivative along s. A parameter may also be a state, its
+ * sensitivity is then the one to its initial value: s starts as a unit vector and there is no
+ * parameter seed.
+ */
+typedef struct {
+    int *parameters;                 // variable index of each parameter
+    int nParameters;
+    int *stateOf;                    // index in x of a parameter which is a state, -1 otherwise
+    int nx;
+    int ny;                          // number of Real outputs
+    int *outputs;                    // variable index of each Real output
+    fmi2ValueReference *knownVRs;    // states, then the parameter of the current column
+    fmi2ValueReference *unknownVRs;  // derivatives, then the Real outputs
+    double *s;                       // nParameters columns of nx state sensitivities
+    double *sdot;                    // their derivatives at the last recorded point
+    double *seed;
+    double *du;
+    double *dp;                      // df/dp then dg/dp of a parameter, by a forward difference
+    double *base;                    // FD only: states then parameter, derivatives then outputs
+    double *rows;                    // recorded dy/dp, one row of ny * nParameters values per step
+    size_t nRows;
+    size_t capacity;
+} Sensitivities;
+
+/**
+ * @brief Adds a Real parameter, a Real input held at its value, or a continuous state for the
+ * sensitivity to its initial value.
+ *
+ * @return 0 on success, -1 if the name is not a Real parameter, input or state, or memory is exhausted.
+ */
+int addSensitivityParameter(Sensitivities *sensitivities, const char *name, const ScalarVariable *variables) {
+    int i = get_variable_index(name);
+    if (i < 0 || variables[i].type != REAL) return -1;
+    int k = 0;
+    while (k < model.numberOfContinuousStates && model_states[k].state != i) k++;
+    if (variables[i].causality != PARAMETER && variables[i].causality != INPUT &&
+        k == model.numberOfContinuousStates) return -1;
+
+    int *parameters = (int*)realloc(sensitivities->parameters, (sensitivities->nParameters + 1) * sizeof(int));
+    if (!parameters) return -1;
+    sensitivities->parameters = parameters;
+    sensitivities->parameters[sensitivities->nParameters++] = i;
+    return 0;
+}
+
+/**
+ * @brief Frees the memory held by the sensitivities.
+ */
+void freeSensitivities(Sensitivities *sensitivities) {
+    free(sensitivities->parameters);
+    free(sensitivities->stateOf);
+    free(sensitivities->outputs);
+    free(sensitivities->knownVRs);
+    free(sensitivities->unknownVRs);
+    free(sensitivities->s);
+    free(sensitivities->sdot);
+    free(sensitivities->seed);
+    free(sensitivities->du);
+    free(sensitivities->dp);
+    free(sensitivities->base);
+    free(sensitivities->rows);
+    memset(sensitivities, 0, sizeof(Sensitivities));
+}
+
+/**
+ * @brief Allocates the sensitivities of the parameters added so far, all starting at zero.
+ *
+ * The derivatives with respect to a parameter are finite differences, which set it during the
+ * simulation: it must be tunable. Most FMUs accept a tunable parameter in continuous-time mode,
+ * although FMI 2.0 only requires it in event mode.
+ *
+ * @param sensitivities The sensitivities, parameters already added.
+ * @param variables The model variables.
+ * @param capacity The expected number of rows, the results grow if more are recorded.
+ * @return 0 on success, -1 on error.
+ */
+int initSensitivities(Sensitivities *sensitivities, const ScalarVariable *variables, size_t capacity) {
+    int nx = model.numberOfContinuousStates, nP = sensitivities->nParameters;
+    int ny = 0;
+    for (int k = 0; k < NOUTPUTS; k++) {
+        if (variables[model_outputs[k].variable].type == REAL) ny++;
+    }
+    sensitivities->nx = nx;
+    sensitivities->ny = ny;
+    sensitivities->capacity = capacity > 0 ? capacity : 1;
+
+    sensitivities->stateOf = (int*)malloc((nP + 1) * sizeof(int));
+    sensitivities->outputs = (int*)malloc((ny + 1) * sizeof(int));
+    sensitivities->knownVRs = (fmi2ValueReference*)malloc((nx + 1) * sizeof(fmi2ValueReference));
+    sensitivities->unknownVRs = (fmi2ValueReference*)malloc((nx + ny + 1) * sizeof(fmi2ValueReference));
+    sensitivities->s = (double*)calloc((size_t)nx * nP + 1, sizeof(double));
+    sensitivities->sdot = (double*)calloc((size_t)nx * nP + 1, sizeof(double));
+    sensitivities->seed = (double*)malloc((nx + 1) * sizeof(double));
+    sensitivities->du = (double*)malloc((nx + ny + 1) * sizeof(double));
+    sensitivities->dp = (double*)malloc((nx + ny + 1) * sizeof(double));
+    sensitivities->base = (double*)malloc((2 * nx + ny + 2) * sizeof(double));
+    sensitivities->rows = (double*)malloc((sensitivities->capacity * ny * nP + 1) * sizeof(double));
+    if (!sensitivities->stateOf || !sensitivities->outputs || !sensitivities->knownVRs ||
+        !sensitivities->unknownVRs || !sensitivities->s || !sensitivities->sdot || !sensitivities->seed ||
+        !sensitivities->du || !sensitivities->dp || !sensitivities->base || !sensitivities->rows) {
+        return -1;
+    }
+
+    for (int i = 0; i < nx; i++) {
+        sensitivities->knownVRs[i] = variables[model_states[i].state].valueReference;
+        sensitivities->unknownVRs[i] = variables[model_states[i].derivative].valueReference;
+    }
+    for (int k = 0, j = 0; k < NOUTPUTS; k++) {
+        if (variables[model_outputs[k].variable].type != REAL) continue;
+        sensitivities->outputs[j] = model_outputs[k].variable;
+        sensitivities->unknownVRs[nx + j++] = variables[model_outputs[k].variable].valueReference;
+    }
+
+    for (int p = 0; p < nP; p++) {
+        int i = sensitivities->parameters[p];
+        sensitivities->stateOf[p] = -1;
+        for (int k = 0; k < nx; k++) {
+            if (model_states[k].state == i) sensitivities->stateOf[p] = k;
+        }
+        if (sensitivities->stateOf[p] >= 0) {
+            sensitivities->s[(size_t)p * nx + sensitivities->stateOf[p]] = 1.0;
+        } else if (variables[i].causality == PARAMETER && variables[i].variability != TUNABLE) {
+            printf("The sensitivity to the parameter %s needs a tunable parameter\n", variable_names[i]);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Evaluates the derivatives and the Real outputs of the sensitivities.
+ */
+static fmi2Status evaluateSensitivityUnknowns(FMU *fmu, fmi2Component component, const Sensitivities *sensitivities,
+                                              double *f) {
+    fmi2Status status = fmu->getDerivatives(component, f, sensitivities->nx);
+    if (status > fmi2Warning || sensitivities->ny == 0) return status;
+    fmi2Status fmi2Flag = fmu->getReal(component, sensitivities->unknownVRs + sensitivities->nx,
+                                       sensitivities->ny, f + sensitivities->nx);
+    return fmi2Flag > status ? fmi2Flag : status;
+}
+
+/**
+ * @brief Directional derivative of the derivatives and outputs along (s, 1) by a forward difference.
+ *
+ * The states and the parameter are moved along the direction, then restored. Without direction,
+ * only the parameter is moved.
+ */
+static fmi2Status sensitivityDifference(FMU *fmu, fmi2Component component, Sensitivities *sensitivities,
+                                        int p, const double *direction, double *du) {
+    int nx = sensitivities->nx, nf = nx + sensitivities->ny;
+    int hasParameter = sensitivities->stateOf[p] < 0;
+    fmi2ValueReference vr = model_variables[sensitivities->parameters[p]].valueReference;
+    double *x0 = sensitivities->base, *f0 = sensitivities->base + nx + 1;
+    double *x = sensitivities->seed;
+    fmi2Status status, fmi2Flag;
+
+    status = fmu->getContinuousStates(component, x0, nx);
+    if (status <= fmi2Warning && hasParameter) {
+        fmi2Flag = fmu->getReal(component, &vr, 1, x0 + nx);
+        if (fmi2Flag > status) status = fmi2Flag;
+    }
+    if (status <= fmi2Warning) {
+        fmi2Flag = evaluateSensitivityUnknowns(fmu, component, sensitivities, f0);
+        if (fmi2Flag > status) status = fmi2Flag;
+    }
+    if (status > fmi2Warning) return status;
+
+    // Step relative to the size of the point and of the direction
+    double size = hasParameter ? fmax(fabs(x0[nx]), 1.0) : 1.0, length = hasParameter ? 1.0 : 0.0;
+    for (int k = 0; k < nx; k++) {
+        size = fmax(size, fabs(x0[k]));
+        if (direction) length = fmax(length, fabs(direction[k]));
+    }
+    if (length == 0) {
+        memset(du, 0, nf * sizeof(double));
+        return status;
+    }
+    double delta = sqrt(DBL_EPSILON) * size / length;
+
+    if (direction) {
+        for (int k = 0; k < nx; k++) x[k] = x0[k] + delta * direction[k];
+        fmi2Flag = fmu->setContinuousStates(component, x, nx);
+        if (fmi2Flag > status) status = fmi2Flag;
+    }
+    if (hasParameter) {
+        double value = x0[nx] + delta;
+        fmi2Flag = fmu->setReal(component, &vr, 1, &value);
+        if (fmi2Flag > status) status = fmi2Flag;
+    }
+    fmi2Flag = evaluateSensitivityUnknowns(fmu, component, sensitivities, du);
+    if (fmi2Flag > status) status = fmi2Flag;
+    for (int k = 0; k < nf; k++) du[k] = (du[k] - f0[k]) / delta;
+
+    if (direction) {
+        fmi2Flag = fmu->setContinuousStates(component, x0, nx);
+        if (fmi2Flag > status) status = fmi2Flag;
+    }
+    if (hasParameter) {
+        fmi2Flag = fmu->setReal(component, &vr, 1, x0 + nx);
+        if (fmi2Flag > status) status = fmi2Flag;
+    }
+    return status;
+}
+
+/**
+ * @brief Records dy/dp at the current point and computes ds/dt for the next step.
+ *
+ * Called after each recordResults, so the sensitivity rows match the result rows.
+ *
+ * @param fmu Pointer to the FMU structure
+ * @param component The instance, in continuous-time mode
+ * @param sensitivities The sensitivities
+ * @return fmi2Status The worst status returned by the FMU, fmi2Error if memory is exhausted
+ */
+fmi2Status recordSensitivities(FMU *fmu, fmi2Component component, Sensitivities *sensitivities) {
+    int nx = sensitivities->nx, ny = sensitivities->ny, nP = sensitivities->nParameters;
+    size_t width = (size_t)ny * nP;
+    fmi2Status status = fmi2OK, fmi2Flag;
+
+    if (sensitivities->nRows == sensitivities->capacity) {
+        double *rows = (double*)realloc(sensitivities->rows, (2 * sensitivities->capacity * width + 1) * sizeof(double));
+        if (!rows) return fmi2Error;
+        sensitivities->rows = rows;
+        sensitivities->capacity *= 2;
+    }
+    double *row = sensitivities->rows + sensitivities->nRows * width;
+
+    for (int p = 0; p < nP && status <= fmi2Warning; p++) {
+        double *s = sensitivities->s + (size_t)p * nx;
+        if (model.providesDirectionalDerivative) {
+            // Only the states and the inputs are knowns of a directional derivative, not the parameters
+            int nKnown = nx, isParameter = sensitivities->stateOf[p] < 0 &&
+                                          model_variables[sensitivities->parameters[p]].causality == PARAMETER;
+            memcpy(sensitivities->seed, s, nx * sizeof(double));
+            if (sensitivities->stateOf[p] < 0 && !isParameter) {
+                sensitivities->knownVRs[nx] = model_variables[sensitivities->parameters[p]].valueReference;
+                sensitivities->seed[nx] = 1.0;
+                nKnown++;
+            }
+            fmi2Flag = fmu->getDirectionalDerivative(component, sensitivities->unknownVRs, nx + ny,
+                                                     sensitivities->knownVRs, nKnown, sensitivities->seed,
+                                                     sensitivities->du);
+            if (isParameter && fmi2Flag <= fmi2Warning) {
+                fmi2Status parameterFlag = sensitivityDifference(fmu, component, sensitivities, p, NULL,
+                                                                 sensitivities->dp);
+                if (parameterFlag > fmi2Flag) fmi2Flag = parameterFlag;
+                for (int k = 0; k < nx + ny; k++) sensitivities->du[k] += sensitivities->dp[k];
+            }
+        } else {
+            fmi2Flag = sensitivityDifference(fmu, component, sensitivities, p, s, sensitivities->du);
+        }
+        if (fmi2Flag > status) status = fmi2Flag;
+
+        memcpy(sensitivities->sdot + (size_t)p * nx, sensitivities->du, nx * sizeof(double));
+        for (int k = 0; k < ny; k++) row[(size_t)k * nP + p] = sensitivities->du[nx + k];
+    }
+
+    sensitivities->nRows++;
+    return status;
+}
+
+/**
+ * @brief Advances the state sensitivities over a step of the states, s += dt ds/dt.
+ */
+void advanceSensitivities(Sensitivities *sensitivities, double dt) {
+    size_t n = (size_t)sensitivities->nx * sensitivities->nParameters;
+    for (size_t k = 0; k < n; k++) {
+        sensitivities->s[k] += dt * sensitivities->sdot[k];
+    }
+}
@@ -0,0 +1,842 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include "headers/fmi2TypesPlatform.h"
+#include "headers/fmi2FunctionTypes.h"
+#include "headers/fmi2Functions.h"
+
+#define SYSTEM_STRUCTURE "SystemStructure.ssd"
+#define STRINGIFY_(name) #name
+#define STRINGIFY(name) STRINGIFY_(name)
+#define MODEL_FILE STRINGIFY(MODEL_IDENTIFIER)   // name of the model fmusim is built with
+#define LOOP_MAX_ITERATIONS 20
+#define LOOP_TOLERANCE 1e-10         // relative residual of the loop variables
+
+/**
+ * @struct SystemComponent
+ * @brief A component of an SSP system: an instance of the model with its parameter bindings.
+ */
+typedef struct {
+    char *name;
+    ParameterOverrides parameters;   // bindings of the SSD, then the --set and --params of the user
+} SystemComponent;
+
+/**
+ * @struct SystemConnection
+ * @brief Connection from the output of a component to the input of another, as variable indices.
+ */
+typedef struct {
+    int source;
+    int sourceVariable;
+    int target;
+    int targetVariable;
+} SystemConnection;
+
+/**
+ * @struct System
+ * @brief Connected instances of the model, read from an SSP archive or its SystemStructure.ssd.
+ *
+ * The connections are resolved once into a flat table. Component c reads its connected outputs
+ * with one getReal into values[outputStart[c]..], each output being read once whatever the
+ * number of inputs it feeds. Component c then gathers its inputs from values through inputSlots
+ * and sets them with one setReal. No name is looked up during the simulation.
+ */
+typedef struct {
+    SystemComponent *components;
+    int nComponents;
+    SystemConnection *connections;
+    int nConnections;
+    int *outputStart;                // nComponents + 1 offsets into outputVrs and values
+    fmi2ValueReference *outputVrs;
+    double *values;
+    int *inputStart;                 // nComponents + 1 offsets into inputVrs, inputSlots and inputs
+    fmi2ValueReference *inputVrs;
+    int *inputSlots;                 // index in values of the output connected to each input
+    double *inputs;
+    int inputOrder;                  // 0 inputs held, 1 linear or 2 quadratic extrapolation
+    int *derivativeStart;            // nComponents + 1 offsets into derivativeVrs and derivativeSlots
+    fmi2ValueReference *derivativeVrs;   // derivatives of the connected outputs which are states
+    int *derivativeSlots;            // index in values of the output of each of them
+    double *slopes;                  // derivative of each output at the communication point, NAN if unknown
+    double *curvatures;              // second derivative of each output
+    double *history;                 // outputs at the two previous communication points
+    double historyTimes[2];
+    int nHistory;
+    double communicationTime;        // time of the last exchange, origin of the extrapolation
+    double *inputSlopes;             // first and second derivatives of each input
+    double *inputCurvatures;
+    fmi2Integer *firstOrders;        // derivative orders 1 then 2 of the outputs or inputs of a slave
+    fmi2Integer *secondOrders;
+    double *extrapolated;
+    double tolerance;                // coupling error of the adaptive communication step, 0 if fixed
+    double *next;                    // connected outputs at the end of a communication step
+    size_t nAccepted;
+    size_t nRejected;
+    int *loops;                      // connections in an algebraic loop
+    int *loopInputs;                 // index in inputVrs of the input of each of them
+    fmi2ValueReference *loopOutputVrs;   // output connected to each of them
+    int nLoops;
+    double *loopValues;              // Newton iterate, the values of the loop inputs
+    double *loopResiduals;
+    double *loopJacobian;            // nLoops x nLoops, row-major
+    size_t nLoopIterations;
+    size_t nLoopFailures;            // communication points where a loop did not converge
+    char *archive;                   // SSP archive, NULL if the SSD was given directly
+    char *directory;                 // directory of the SSD, for the .ssv files it refers to
+    int maxThreads;                  // threads stepping the components, one per processor by default
+    int coSimulation;                // components instantiated as co-simulation slaves, stepped by doStep
+    size_t nPendingSteps;            // doStep calls which returned fmi2Pending
+    size_t nStatusPolls;             // getStatus calls while they were computing
+} System;
+
+// Pipe from unzip -p archive name, run without a shell so that no name is interpreted
+static FILE* openArchiveMember(const char *archive, const char *name, pid_t *pid) {
+    int fds[2];
+    if (pipe(fds) != 0) return NULL;
+    *pid = fork();
+    if (*pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return NULL;
+    }
+    if (*pid == 0) {
+        dup2(fds[1], STDOUT_FILENO);
+        close(fds[0]);
+        close(fds[1]);
+        int null = open("/dev/null", O_WRONLY);
+        if (null >= 0) dup2(null, STDERR_FILENO);
+        char *argv[] = { "unzip", "-p", (char*)archive, (char*)name, NULL };
+        execvp(argv[0], argv);
+        _exit(127);
+    }
+    close(fds[1]);
+    FILE *file = fdopen(fds[0], "r");
+    if (!file) {
+        close(fds[0]);
+        waitpid(*pid, NULL, 0);
+    }
+    return file;
+}
+
+// Reads a file of the SSD directory, or a member of the SSP archive with unzip
+static char* readSystemFile(const System *system, const char *name) {
+    char path[2048];
+    FILE *file;
+    pid_t pid = -1;
+    if (system->archive) {
+        file = openArchiveMember(system->archive, name, &pid);
+    } else {
+        snprintf(path, sizeof(path), "%s%s", system->directory, name);
+        file = fopen(path, "r");
+    }
+    if (!file) return NULL;
+
+    size_t size = 0, capacity = 65536;
+    char *text = (char*)malloc(capacity);
+    size_t n;
+    while (text && (n = fread(text + size, 1, capacity - size - 1, file)) > 0) {
+        size += n;
+        if (size + 1 == capacity) {
+            char *grown = (char*)realloc(text, 2 * capacity);
+            if (!grown) free(text);
+            text = grown;
+            capacity *= 2;
+        }
+    }
+    fclose(file);
+    if (pid > 0) waitpid(pid, NULL, 0);
+    if (text && size == 0) {
+        free(text);
+        return NULL;
+    }
+    if (text) text[size] = '\0';
+    return text;
+}
+
+// Copies the value of attribute name of the tag [tag, end) into value, -1 if there is none
+static int xmlAttribute(const char *tag, const char *end, const char *name, char *value, size_t size) {
+    size_t length = strlen(name);
+    for (const char *p = tag + 1; p + length + 2 < end; p++) {
+        if ((p[-1] != ' ' && p[-1] != '\t' && p[-1] != '\n' && p[-1] != '\r') ||
+            strncmp(p, name, length) != 0 || p[length] != '=' || (p[length + 1] != '"' && p[length + 1] != '\'')) {
+            continue;
+        }
+        const char *start = p + length + 2;
+        const char *stop = memchr(start, p[length + 1], end - start);
+        if (!stop || (size_t)(stop - start) >= size) return -1;
+        memcpy(value, start, stop - start);
+        value[stop - start] = '\0';
+        return 0;
+    }
+    return -1;
+}
+
+static int findComponent(const System *system, const char *name) {
+    for (int c = 0; c < system->nComponents; c++) {
+        if (strcmp(system->components[c].name, name) == 0) return c;
+    }
+    return -1;
+}
+
+/**
+ * Scans the elements of an SSD, or of an SSV file bound to component, without building a tree:
+ * only the components, the parameter values and the connections are needed.
+ */
+static int parseSystemXml(System *system, const char *text, int component, const ScalarVariable *variables) {
+    char name[256], value[256], parameter[256] = "";
+    char startElement[256], startConnector[256], endElement[256], endConnector[256];
+    for (const char *tag = strchr(text, '<'); tag; tag = strchr(tag + 1, '<')) {
+        if (strncmp(tag, "<!--", 4) == 0) {
+            tag = strstr(tag, "-->");
+            if (!tag) break;
+            continue;
+        }
+        const char *end = strchr(tag, '>');
+        if (!end) break;
+        int closing = tag[1] == '/';
+        const char *element = tag + 1 + closing;
+        size_t length = strcspn(element, " \t\r\n/>");
+        const char *colon = memchr(element, ':', length);
+        if (colon) {
+            length -= colon + 1 - element;
+            element = colon + 1;
+        }
+#define IS_ELEMENT(literal) (length == strlen(literal) && strncmp(element, literal, length) == 0)
+
+        if (IS_ELEMENT("Component")) {
+            if (closing) {
+                component = -1;
+                continue;
+            }
+            if (xmlAttribute(tag, end, "name", name, sizeof(name)) != 0) {
+                printf("SSD component without a name\n");
+                return -1;
+            }
+            // fmusim is built around one model, every component must be an instance of it
+            char source[1024] = "";
+            xmlAttribute(tag, end, "source", source, sizeof(source));
+            const char *file = strrchr(source, '/') ? strrchr(source, '/') + 1 : source;
+            size_t stem = strlen(file) > 4 && strcmp(file + strlen(file) - 4, ".fmu") == 0 ? strlen(file) - 4 : strlen(file);
+            if (strlen(MODEL_FILE) != stem || strncmp(file, MODEL_FILE, stem) != 0) {
+                printf("Component %s is %s, fmusim is built with %s.fmu\n", name, source, MODEL_FILE);
+                return -1;
+            }
+            SystemComponent *components = (SystemComponent*)realloc(system->components,
+                                                                    (system->nComponents + 1) * sizeof(SystemComponent));
+            if (!components) return -1;
+            system->components = components;
+            component = system->nComponents++;
+            memset(&components[component], 0, sizeof(SystemComponent));
+            components[component].name = strdup(name);
+            if (!components[component].name) return -1;
+            if (end[-1] == '/') component = -1;
+        } else if (IS_ELEMENT("ParameterBinding") && !closing && component >= 0 &&
+                   xmlAttribute(tag, end, "source", name, sizeof(name)) == 0) {
+            // A binding refers to a file of the system, never to one outside of it
+            int outside = name[0] == '/';
+            for (const char *segment = name; !outside && segment; segment = strchr(segment, '/')) {
+                if (*segment == '/') segment++;
+                outside = strncmp(segment, "..", 2) == 0 && (segment[2] == '/' || segment[2] == '\0');
+            }
+            if (outside) {
+                printf("The parameter values %s are outside of the system\n", name);
+                return -1;
+            }
+            char *values = readSystemFile(system, name);
+            if (!values) {
+                printf("Cannot read the parameter values %s\n", name);
+                return -1;
+            }
+            int result = parseSystemXml(system, values, component, variables);
+            free(values);
+            if (result != 0) return -1;
+        } else if (IS_ELEMENT("Parameter") && component >= 0) {
+            if (closing || xmlAttribute(tag, end, "name", parameter, sizeof(parameter)) != 0) parameter[0] = '\0';
+        } else if ((IS_ELEMENT("Real") || IS_ELEMENT("Integer") || IS_ELEMENT("Boolean") ||
+                    IS_ELEMENT("String") || IS_ELEMENT("Enumeration")) &&
+                   !closing && component >= 0 && parameter[0] &&
+                   xmlAttribute(tag, end, "value", value, sizeof(value)) == 0) {
+            char assignment[600];
+            snprintf(assignment, sizeof(assignment), "%s=%s", parameter, value);
+            if (addParameterOverride(&system->components[component].parameters, assignment) != 0) return -1;
+        } else if (IS_ELEMENT("Connection") && !closing) {
+            if (xmlAttribute(tag, end, "startConnector", startConnector, sizeof(startConnector)) != 0 ||
+                xmlAttribute(tag, end, "endConnector", endConnector, sizeof(endConnector)) != 0) {
+                printf("SSD connection without connectors\n");
+                return -1;
+            }
+            if (xmlAttribute(tag, end, "startElement", startElement, sizeof(startElement)) != 0 ||
+                xmlAttribute(tag, end, "endElement", endElement, sizeof(endElement)) != 0) {
+                printf("Connection %s -> %s to the system boundary ignored\n", startConnector, endConnector);
+                continue;
+            }
+            SystemConnection connection;
+            connection.source = findComponent(system, startElement);
+            connection.target = findComponent(system, endElement);
+            connection.sourceVariable = get_variable_index(startConnector);
+            connection.targetVariable = get_variable_index(endConnector);
+            if (connection.source < 0 || connection.target < 0) {
+                printf("Connection %s.%s -> %s.%s between unknown components\n", startElement, startConnector,
+                       endElement, endConnector);
+                return -1;
+            }
+            if (connection.sourceVariable < 0 || connection.targetVariable < 0 ||
+                variables[connection.sourceVariable].type != REAL || variables[connection.targetVariable].type != REAL ||
+                variables[connection.targetVariable].causality != INPUT) {
+                printf("Connection %s.%s -> %s.%s must go from a Real variable to a Real input\n", startElement,
+                       startConnector, endElement, endConnector);
+                return -1;
+            }
+            SystemConnection *connections = (SystemConnection*)realloc(system->connections,
+                                                                       (system->nConnections + 1) * sizeof(SystemConnection));
+            if (!connections) return -1;
+            system->connections = connections;
+            connections[system->nConnections++] = connection;
+        }
+#undef IS_ELEMENT
+    }
+    return 0;
+}
+
+// Builds the flat exchange table, grouped by component
+static int buildConnectionTable(System *system, const ScalarVariable *variables) {
+    int n = system->nComponents, m = system->nConnections;
+    system->outputStart = (int*)calloc(n + 1, sizeof(int));
+    system->inputStart = (int*)calloc(n + 1, sizeof(int));
+    system->outputVrs = (fmi2ValueReference*)malloc((m + 1) * sizeof(fmi2ValueReference));
+    system->values = (double*)malloc((m + 1) * sizeof(double));
+    system->inputVrs = (fmi2ValueReference*)malloc((m + 1) * sizeof(fmi2ValueReference));
+    system->inputSlots = (int*)malloc((m + 1) * sizeof(int));
+    system->inputs = (double*)malloc((m + 1) * sizeof(double));
+    int *slots = (int*)malloc((m + 1) * sizeof(int));
+    if (!system->outputStart || !system->inputStart || !system->outputVrs || !system->values ||
+        !system->inputVrs || !system->inputSlots || !system->inputs || !slots) {
+        free(slots);
+        return -1;
+    }
+
+    // Outputs, each one read once
+    int nOutputs = 0;
+    for (int c = 0; c < n; c++) {
+        system->outputStart[c] = nOutputs;
+        for (int k = 0; k < m; k++) {
+            const SystemConnection *connection = &system->connections[k];
+            if (connection->source != c) continue;
+            fmi2ValueReference vr = variables[connection->sourceVariable].valueReference;
+            int slot = system->outputStart[c];
+            while (slot < nOutputs && system->outputVrs[slot] != vr) slot++;
+            if (slot == nOutputs) system->outputVrs[nOutputs++] = vr;
+            slots[k] = slot;
+        }
+    }
+    system->outputStart[n] = nOutputs;
+
+    // Inputs, an input connected twice is an error of the SSD
+    int nInputs = 0;
+    for (int c = 0; c < n; c++) {
+        system->inputStart[c] = nInputs;
+        for (int k = 0; k < m; k++) {
+            const SystemConnection *connection = &system->connections[k];
+            if (connection->target != c) continue;
+            fmi2ValueReference vr = variables[connection->targetVariable].valueReference;
+            for (int j = system->inputStart[c]; j < nInputs; j++) {
+                if (system->inputVrs[j] == vr) {
+                    printf("Input %s of %s is connected twice\n", variable_names[connection->targetVariable],
+                           system->components[c].name);
+                    free(slots);
+                    return -1;
+                }
+            }
+            system->inputVrs[nInputs] = vr;
+            system->inputSlots[nInputs++] = slots[k];
+        }
+    }
+    system->inputStart[n] = nInputs;
+    free(slots);
+
+    // An output which is a state has its derivative in the model, the exact slope of the output
+    system->derivativeStart = (int*)calloc(n + 1, sizeof(int));
+    system->derivativeVrs = (fmi2ValueReference*)malloc((nOutputs + 1) * sizeof(fmi2ValueReference));
+    system->derivativeSlots = (int*)malloc((nOutputs + 1) * sizeof(int));
+    system->slopes = (double*)malloc((nOutputs + 1) * sizeof(double));
+    system->curvatures = (double*)malloc((nOutputs + 1) * sizeof(double));
+    system->history = (double*)malloc((2 * nOutputs + 1) * sizeof(double));
+    system->inputSlopes = (double*)calloc(nInputs + 1, sizeof(double));
+    system->inputCurvatures = (double*)calloc(nInputs + 1, sizeof(double));
+    system->extrapolated = (double*)malloc((nInputs + 1) * sizeof(double));
+    system->next = (double*)malloc((nOutputs + 1) * sizeof(double));
+    int nOrders = max(nOutputs, nInputs);
+    system->firstOrders = (fmi2Integer*)malloc(2 * (nOrders + 1) * sizeof(fmi2Integer));
+    if (!system->derivativeStart || !system->derivativeVrs || !system->derivativeSlots || !system->slopes ||
+        !system->curvatures || !system->history || !system->inputSlopes || !system->inputCurvatures || !system->extrapolated ||
+        !system->next || !system->firstOrders) {
+        return -1;
+    }
+    system->secondOrders = system->firstOrders + nOrders + 1;
+    for (int k = 0; k <= nOrders; k++) {
+        system->firstOrders[k] = 1;
+        system->secondOrders[k] = 2;
+    }
+    int nDerivatives = 0;
+    for (int c = 0; c < n; c++) {
+        system->derivativeStart[c] = nDerivatives;
+        for (int slot = system->outputStart[c]; slot < system->outputStart[c + 1]; slot++) {
+            for (int k = 0; k < model.numberOfContinuousStates; k++) {
+                if (variables[model_states[k].state].valueReference != system->outputVrs[slot]) continue;
+                system->derivativeVrs[nDerivatives] = variables[model_states[k].derivative].valueReference;
+                system->derivativeSlots[nDerivatives++] = slot;
+                break;
+            }
+        }
+    }
+    system->derivativeStart[n] = nDerivatives;
+    return 0;
+}
+
+// Tells whether a variable depends on an input at the same instant, from <ModelStructure>
+static int dependsOnInput(int variable, int input) {
+    // A continuous state is integrated, it has no direct feedthrough whether or not it is an output
+    for (int k = 0; k < model.numberOfContinuousStates; k++) {
+        if (model_states[k].state == variable) return 0;
+    }
+    const ModelUnknown *unknown = NULL;
+    for (int k = 0; k < NOUTPUTS; k++) {
+        if (model_outputs[k].variable == variable) unknown = &model_outputs[k];
+    }
+    for (int k = 0; k < model.numberOfContinuousStates; k++) {
+        if (model_derivative_dependencies[k].variable == variable) unknown = &model_derivative_dependencies[k];
+    }
+    // Not an unknown of <ModelStructure>, or dependencies not given: assume the worst
+    if (!unknown || unknown->count < 0) return 1;
+    for (int d = 0; d < unknown->count; d++) {
+        if (model_dependencies[unknown->start + d] == input) return 1;
+    }
+    return 0;
+}
+
+/**
+ * Finds the connections in algebraic loops: connection k feeds connection j when the output of j
+ * depends directly on the input of k, and k is in a loop when it feeds itself through such edges.
+ */
+static int detectAlgebraicLoops(System *system, const ScalarVariable *variables) {
+    int m = system->nConnections;
+    char *edges = (char*)calloc((size_t)m * m + 1, 1);
+    char *reached = (char*)malloc(m + 1);
+    int *queue = (int*)malloc((m + 1) * sizeof(int));
+    system->loops = (int*)malloc((m + 1) * sizeof(int));
+    system->loopInputs = (int*)malloc((m + 1) * sizeof(int));
+    system->loopOutputVrs = (fmi2ValueReference*)malloc((m + 1) * sizeof(fmi2ValueReference));
+    int result = -1;
+    if (!edges || !reached || !queue || !system->loops || !system->loopInputs || !system->loopOutputVrs) goto done;
+
+    for (int k = 0; k < m; k++) {
+        for (int j = 0; j < m; j++) {
+            const SystemConnection *from = &system->connections[k], *to = &system->connections[j];
+            edges[(size_t)k * m + j] = from->target == to->source &&
+                                       dependsOnInput(to->sourceVariable, from->targetVariable);
+        }
+    }
+    for (int k = 0; k < m; k++) {
+        int head = 0, tail = 0, loop = 0;
+        memset(reached, 0, m);
+        queue[tail++] = k;
+        while (head < tail && !loop) {
+            int i = queue[head++];
+            for (int j = 0; j < m; j++) {
+                if (!edges[(size_t)i * m + j] || reached[j]) continue;
+                if (j == k) loop = 1;
+                reached[j] = 1;
+                queue[tail++] = j;
+            }
+        }
+        if (!loop) continue;
+
+        const SystemConnection *connection = &system->connections[k];
+        int c = connection->target;
+        int input = system->inputStart[c];
+        while (system->inputVrs[input] != variables[connection->targetVariable].valueReference) input++;
+        system->loopInputs[system->nLoops] = input;
+        system->loopOutputVrs[system->nLoops] = variables[connection->sourceVariable].valueReference;
+        system->loops[system->nLoops++] = k;
+        printf("Algebraic loop through %s.%s -> %s.%s\n", system->components[connection->source].name,
+               variable_names[connection->sourceVariable], system->components[c].name,
+               variable_names[connection->targetVariable]);
+    }
+
+    int n = system->nLoops;
+    system->loopValues = (double*)malloc((n + 1) * sizeof(double));
+    system->loopResiduals = (double*)malloc((n + 1) * sizeof(double));
+    system->loopJacobian = (double*)malloc(((size_t)n * n + 1) * sizeof(double));
+    if (system->loopValues && system->loopResiduals && system->loopJacobian) result = 0;
+
+done:
+    free(edges);
+    free(reached);
+    free(queue);
+    return result;
+}
+
+/**
+ * @brief Frees the memory held by a system.
+ */
+void freeSystem(System *system) {
+    for (int c = 0; c < system->nComponents; c++) {
+        free(system->components[c].name);
+        freeParameterOverrides(&system->components[c].parameters);
+    }
+    free(system->components);
+    free(system->connections);
+    free(system->outputStart);
+    free(system->outputVrs);
+    free(system->values);
+    free(system->inputStart);
+    free(system->inputVrs);
+    free(system->inputSlots);
+    free(system->inputs);
+    free(system->derivativeStart);
+    free(system->derivativeVrs);
+    free(system->derivativeSlots);
+    free(system->slopes);
+    free(system->curvatures);
+    free(system->history);
+    free(system->inputSlopes);
+    free(system->inputCurvatures);
+    free(system->extrapolated);
+    free(system->firstOrders);
+    free(system->next);
+    free(system->loops);
+    free(system->loopInputs);
+    free(system->loopOutputVrs);
+    free(system->loopValues);
+    free(system->loopResiduals);
+    free(system->loopJacobian);
+    free(system->archive);
+    free(system->directory);
+    int maxThreads = system->maxThreads, inputOrder = system->inputOrder, coSimulation = system->coSimulation;
+    double tolerance = system->tolerance;
+    memset(system, 0, sizeof(System));
+    system->maxThreads = maxThreads;
+    system->coSimulation = coSimulation;
+    system->inputOrder = inputOrder;
+    system->tolerance = tolerance;
+}
+
+/**
+ * @brief Loads a system from an SSP archive (.ssp) or from its SystemStructure.ssd.
+ *
+ * Every component must be an instance of the model fmusim is built with. The parameter values
+ * of the SSD, inline or in .ssv files, become the overrides of their component, and the user
+ * overrides are applied after them.
+ *
+ * @return 0 on success, -1 if the system is invalid or memory is exhausted.
+ */
+int loadSystem(System *system, const char *path, const ScalarVariable *variables, const ParameterOverrides *overrides) {
+    size_t length = strlen(path);
+    const char *slash = strrchr(path, '/');
+    system->directory = slash ? strndup(path, slash + 1 - path) : strdup("");
+    if (!system->directory) return -1;
+    const char *name = slash ? slash + 1 : path;
+    if (length > 4 && strcmp(path + length - 4, ".ssp") == 0) {
+        system->archive = strdup(path);
+        if (!system->archive) return -1;
+        name = SYSTEM_STRUCTURE;
+    }
+
+    long nProcessors = sysconf(_SC_NPROCESSORS_ONLN);
+    if (system->maxThreads <= 0) system->maxThreads = nProcessors > 0 ? (int)nProcessors : 1;
+
+    char *text = readSystemFile(system, name);
+    if (!text) {
+        printf("Cannot read the system structure %s\n", path);
+        return -1;
+    }
+    int result = parseSystemXml(system, text, -1, variables);
+    free(text);
+    if (result != 0) return -1;
+    if (system->nComponents == 0) {
+        printf("The system %s has no component\n", path);
+        return -1;
+    }
+
+    for (int c = 0; c < system->nComponents; c++) {
+        for (int k = 0; overrides && k < overrides->count; k++) {
+            char assignment[1024];
+            snprintf(assignment, sizeof(assignment), "%s=%s", overrides->items[k].name, overrides->items[k].value);
+            if (addParameterOverride(&system->components[c].parameters, assignment) != 0) return -1;
+        }
+    }
+    if (buildConnectionTable(system, variables) != 0) return -1;
+    return detectAlgebraicLoops(system, variables);
+}
+
+// Copies the connected outputs to the inputs, one getReal and one setReal per component
+static fmi2Status exchangeConnections(System *system, FMU *fmu, fmi2Component *instances) {
+    fmi2Status status = fmi2OK, flag;
+    for (int c = 0; c < system->nComponents; c++) {
+        int start = system->outputStart[c], count = system->outputStart[c + 1] - start;
+        if (count == 0) continue;
+        flag = fmu->getReal(instances[c], system->outputVrs + start, count, system->values + start);
+        if (flag > status) status = flag;
+        if (status > fmi2Warning) return status;
+    }
+    for (int c = 0; c < system->nComponents; c++) {
+        int start = system->inputStart[c], count = system->inputStart[c + 1] - start;
+        if (count == 0) continue;
+        for (int k = start; k < start + count; k++) system->inputs[k] = system->values[system->inputSlots[k]];
+        flag = fmu->setReal(instances[c], system->inputVrs + start, count, system->inputs + start);
+        if (flag > status) status = flag;
+        if (status > fmi2Warning) return status;
+    }
+    return status;
+}
+
+// Sets the loop inputs to u and computes r = y(u) - u, y being the outputs connected to them
+static fmi2Status loopResiduals(System *system, FMU *fmu, fmi2Component *instances, const double *u, double *r) {
+    fmi2Status status = fmi2OK, flag;
+    for (int j = 0; j < system->nLoops; j++) {
+        const SystemConnection *connection = &system->connections[system->loops[j]];
+        flag = fmu->setReal(instances[connection->target], &system->inputVrs[system->loopInputs[j]], 1, &u[j]);
+        if (flag > status) status = flag;
+    }
+    for (int k = 0; k < system->nLoops && status <= fmi2Warning; k++) {
+        const SystemConnection *connection = &system->connections[system->loops[k]];
+        flag = fmu->getReal(instances[connection->source], &system->loopOutputVrs[k], 1, &r[k]);
+        if (flag > status) status = flag;
+        r[k] -= u[k];
+    }
+    return status;
+}
+
+// Jacobian of the residuals, J = dy/du - I, dy_k/du_j being nonzero only inside a component
+static fmi2Status loopJacobian(System *system, FMU *fmu, fmi2Component *instances, const double *u, double *J) {
+    int n = system->nLoops;
+    fmi2Status status = fmi2OK, flag;
+    for (int k = 0; k < n * n; k++) J[k] = 0;
+    for (int j = 0; j < n && status <= fmi2Warning; j++) {
+        const SystemConnection *input = &system->connections[system->loops[j]];
+        fmi2ValueReference known = system->inputVrs[system->loopInputs[j]];
+        double delta = 1e-7 * (1 + fabs(u[j])), perturbed = u[j] + delta;
+        J[j * n + j] = -1;
+        for (int k = 0; k < n; k++) {
+            const SystemConnection *output = &system->connections[system->loops[k]];
+            if (output->source != input->target || !dependsOnInput(output->sourceVariable, input->targetVariable)) {
+                continue;
+            }
+            fmi2Component instance = instances[output->source];
+            fmi2ValueReference unknown = system->loopOutputVrs[k];
+            double derivative, y0, y1, one = 1;
+            if (system->coSimulation ? model.csProvidesDirectionalDerivative : model.providesDirectionalDerivative) {
+                flag = fmu->getDirectionalDerivative(instance, &unknown, 1, &known, 1, &one, &derivative);
+            } else {
+                // Forward difference, the input is restored for the next column
+                flag = fmu->getReal(instance, &unknown, 1, &y0);
+                if (flag <= fmi2Warning) flag = fmu->setReal(instance, &known, 1, &perturbed);
+                if (flag <= fmi2Warning) flag = fmu->getReal(instance, &unknown, 1, &y1);
+                if (flag <= fmi2Warning) flag = fmu->setReal(instance, &known, 1, &u[j]);
+                derivative = (y1 - y0) / delta;
+            }
+            if (flag > status) status = flag;
+            J[k * n + j] += derivative;
+        }
+    }
+    return status;
+}
+
+/**
+ * Solves y(u) = u over the loop inputs by Newton, the Jacobian coming from the directional
+ * derivatives of the model, or from finite differences if it has none. A fixed-point step is
+ * taken when the Jacobian is singular.
+ */
+static fmi2Status solveAlgebraicLoops(System *system, FMU *fmu, fmi2Component *instances) {
+    int n = system->nLoops, converged = 0;
+    double *u = system->loopValues, *r = system->loopResiduals, *J = system->loopJacobian;
+    for (int j = 0; j < n; j++) u[j] = system->inputs[system->loopInputs[j]];
+
+    fmi2Status status = fmi2OK, flag;
+    for (int iteration = 0; iteration <= LOOP_MAX_ITERATIONS; iteration++) {
+        flag = loopResiduals(system, fmu, instances, u, r);
+        if (flag > status) status = flag;
+        if (status > fmi2Warning) return status;
+        converged = 1;
+        for (int j = 0; j < n; j++) converged = converged && fabs(r[j]) <= LOOP_TOLERANCE * (1 + fabs(u[j]));
+        if (converged || iteration == LOOP_MAX_ITERATIONS) break;
+
+        system->nLoopIterations++;
+        flag = loopJacobian(system, fmu, instances, u, J);
+        if (flag > status) status = flag;
+        if (status > fmi2Warning) return status;
+        for (int j = 0; j < n; j++) r[j] = -r[j];
+        if (solveLinearSystem(J, r, n) != 0) {
+            // Singular Jacobian: fixed-point step u = y(u)
+            flag = loopResiduals(system, fmu, instances, u, r);
+            if (flag > status) status = flag;
+            if (status > fmi2Warning) return status;
+        }
+        for (int j = 0; j < n; j++) u[j] += r[j];
+    }
+    if (!converged) {
+        system->nLoopFailures++;
+        if (status < fmi2Warning) status = fmi2Warning;
+    }
+    return status;
+}
+
+/**
+ * Derivatives of the inputs at the communication point: a slave gives those of its outputs up to
+ * its maxOutputDerivativeOrder; otherwise the slope of an output which is a state is its derivative,
+ * read from the model. The other slopes and the curvatures are those of the polynomial through the
+ * values of the last communication points (Newton divided differences).
+ */
+static fmi2Status updateInputDerivatives(System *system, FMU *fmu, fmi2Component *instances, double time) {
+    int nOutputs = system->outputStart[system->nComponents];
+    fmi2Status status = fmi2OK, flag;
+    double *derivatives = system->next;
+    int slaveOrder = system->coSimulation && fmu->getRealOutputDerivatives ?
+                     min(system->inputOrder, model.csMaxOutputDerivativeOrder) : 0;
+    for (int slot = 0; slot < nOutputs; slot++) system->slopes[slot] = system->curvatures[slot] = NAN;
+    for (int c = 0; c < system->nComponents && system->inputOrder > 0; c++) {
+        int outputs = system->outputStart[c], nSlots = system->outputStart[c + 1] - outputs;
+        if (slaveOrder > 0 && nSlots > 0) {
+            flag = fmu->getRealOutputDerivatives(instances[c], system->outputVrs + outputs, nSlots,
+                                                 system->firstOrders, system->slopes + outputs);
+            if (flag > status) status = flag;
+            if (slaveOrder > 1 && status <= fmi2Warning) {
+                flag = fmu->getRealOutputDerivatives(instances[c], system->outputVrs + outputs, nSlots,
+                                                     system->secondOrders, system->curvatures + outputs);
+                if (flag > status) status = flag;
+            }
+            if (status > fmi2Warning) return status;
+            continue;
+        }
+        int start = system->derivativeStart[c], count = system->derivativeStart[c + 1] - start;
+        if (count == 0) continue;
+        flag = fmu->getReal(instances[c], system->derivativeVrs + start, count, derivatives);
+        if (flag > status) status = flag;
+        if (status > fmi2Warning) return status;
+        for (int k = 0; k < count; k++) system->slopes[system->derivativeSlots[start + k]] = derivatives[k];
+    }
+
+    double t0 = time, t1 = system->historyTimes[0], t2 = system->historyTimes[1];
+    for (int slot = 0; slot < nOutputs; slot++) {
+        double u0 = system->values[slot], u1 = system->history[slot], u2 = system->history[nOutputs + slot];
+        double d01 = system->nHistory > 0 ? (u0 - u1) / (t0 - t1) : 0;
+        double d12 = system->nHistory > 1 ? (u1 - u2) / (t1 - t2) : 0;
+        double dd = system->nHistory > 1 ? (d01 - d12) / (t0 - t2) : 0;
+        double slope = isnan(system->slopes[slot]) ? d01 + dd * (t0 - t1) : system->slopes[slot];
+        double curvature = isnan(system->curvatures[slot]) ? 2 * dd : system->curvatures[slot];
+        system->curvatures[slot] = system->inputOrder > 1 ? curvature : 0;
+        system->slopes[slot] = slope;
+    }
+
+    for (int k = 0; k < system->inputStart[system->nComponents]; k++) {
+        system->inputSlopes[k] = system->slopes[system->inputSlots[k]];
+        system->inputCurvatures[k] = system->curvatures[system->inputSlots[k]];
+    }
+    memcpy(system->history + nOutputs, system->history, nOutputs * sizeof(double));
+    memcpy(system->history, system->values, nOutputs * sizeof(double));
+    system->historyTimes[1] = system->historyTimes[0];
+    system->historyTimes[0] = time;
+    if (system->nHistory < 2) system->nHistory++;
+    system->communicationTime = time;
+    return status;
+}
+
+/**
+ * @brief Sets the inputs of component c to their extrapolation at time t, with a single setReal.
+ *
+ * Each component only touches its own inputs, the components may be extrapolated concurrently.
+ */
+fmi2Status extrapolateInputs(System *system, FMU *fmu, fmi2Component instance, int c, double time) {
+    int start = system->inputStart[c], count = system->inputStart[c + 1] - start;
+    if (system->inputOrder == 0 || count == 0) return fmi2OK;
+    double dt = time - system->communicationTime;
+    for (int k = start; k < start + count; k++) {
+        system->extrapolated[k] = system->inputs[k] + dt * (system->inputSlopes[k] + 0.5 * dt * system->inputCurvatures[k]);
+    }
+    return fmu->setReal(instance, system->inputVrs + start, count, system->extrapolated + start);
+}
+
+/**
+ * @brief Gives slave c the derivatives of its inputs at the communication point, with one
+ * setRealInputDerivatives per order: the slave extrapolates its inputs over the step itself.
+ */
+fmi2Status setInputDerivatives(System *system, FMU *fmu, fmi2Component instance, int c) {
+    int start = system->inputStart[c], count = system->inputStart[c + 1] - start;
+    if (system->inputOrder == 0 || count == 0) return fmi2OK;
+    fmi2Status status = fmu->setRealInputDerivatives(instance, system->inputVrs + start, count, system->firstOrders,
+                                                     system->inputSlopes + start), flag;
+    if (system->inputOrder > 1 && status <= fmi2Warning) {
+        flag = fmu->setRealInputDerivatives(instance, system->inputVrs + start, count, system->secondOrders,
+                                            system->inputCurvatures + start);
+        if (flag > status) status = flag;
+    }
+    return status;
+}
+
+/**
+ * @brief Copies the connected outputs to the inputs, one getReal and one setReal per component.
+ *
+ * The inputs in algebraic loops are then solved so that the outputs and the inputs agree at the
+ * communication point, and the connections are exchanged once more with the solved values.
+ * With an input order, the derivatives of the inputs are then updated for extrapolateInputs.
+ *
+ * @param system The system.
+ * @param fmu The FMU.
+ * @param instances The instance of each component.
+ * @param time The communication point.
+ * @return fmi2Status The worst status of the FMU, fmi2Warning if a loop did not converge.
+ */
+fmi2Status propagateConnections(System *system, FMU *fmu, fmi2Component *instances, double time) {
+    fmi2Status status = exchangeConnections(system, fmu, instances), flag;
+    if (system->nLoops > 0 && status <= fmi2Warning) {
+        flag = solveAlgebraicLoops(system, fmu, instances);
+        if (flag > status) status = flag;
+        if (status > fmi2Warning) return status;
+        flag = exchangeConnections(system, fmu, instances);
+        if (flag > status) status = flag;
+    }
+    if (system->inputOrder > 0 && status <= fmi2Warning) {
+        flag = updateInputDerivatives(system, fmu, instances, time);
+        if (flag > status) status = flag;
+    }
+    return status;
+}
+
+/**
+ * @brief Error of the communication step which just ended, relative to the tolerance.
+ *
+ * The connected outputs at the end of the step are compared with the values their inputs were
+ * given, held or extrapolated from the start of the step: the difference is the coupling error,
+ * obtained without any additional step. A value above 1 means the step must be rejected.
+ *
+ * @param system The system, its derivatives being those of the start of the step.
+ * @param fmu The FMU.
+ * @param instances The instance of each component, at the end of the step.
+ * @param H The length of the step.
+ * @param error The relative error, set on success.
+ * @return fmi2Status The worst status of the FMU.
+ */
+fmi2Status couplingError(System *system, FMU *fmu, fmi2Component *instances, double H, double *error) {
+    fmi2Status status = fmi2OK, flag;
+    for (int c = 0; c < system->nComponents; c++) {
+        int start = system->outputStart[c], count = system->outputStart[c + 1] - start;
+        if (count == 0) continue;
+        flag = fmu->getReal(instances[c], system->outputVrs + start, count, system->next + start);
+        if (flag > status) status = flag;
+        if (status > fmi2Warning) return status;
+    }
+
+    *error = 0;
+    for (int slot = 0; slot < system->outputStart[system->nComponents]; slot++) {
+        double predicted = system->values[slot];
+        if (system->inputOrder > 0) predicted += H * (system->slopes[slot] + 0.5 * H * system->curvatures[slot]);
+        double scale = system->tolerance * (1 + fabs(system->next[slot]));
+        double e = fabs(system->next[slot] - predicted) / scale;
+        if (e > *error) *error = e;
+    }
+    return status;
+}
@@ -11,10 +11,14 @@ with open(file_path, 'r') as file:
 # Extract the column names
 columns = {name: [] for name in header}
 
-# Populate the columns with data
+# Populate the columns with data, String variables (quoted values) are not plotted
 for row in data:
 	for name, value in zip(header, row):
-		columns[name].append(float(value))
+		if value.startswith('"'):
+			columns.pop(name, None)
+		elif name in columns:
+			columns[name].append(float(value))
+header = [name for name in header if name in columns]
 
 # Extract the first column as the x-axis
 x_values = columns[header[0]]
@@ -0,0 +1,570 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include "headers/fmi2TypesPlatform.h"
+#include "headers/fmi2FunctionTypes.h"
+#include "headers/fmi2Functions.h"
+
+// Rows transformed at once, every operation of a kernel is a loop over a block of this size
+#define TRANSFORM_BLOCK 256
+#define MAX_NAME_SIZE 256
+
+/**
+ * @brief Operations of the derived signal bytecode, evaluated on a stack of row blocks.
+ */
+typedef enum {
+    OP_LOAD,                         // push the column of variable arg
+    OP_LOAD_DERIVED,                 // push the column of the derived signal arg
+    OP_CONST,                        // push value
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_NEG,
+    OP_LT,                           // comparisons and logical operations push 1 or 0
+    OP_LE,
+    OP_GT,
+    OP_GE,
+    OP_EQ,
+    OP_NE,
+    OP_AND,
+    OP_OR,
+    OP_NOT
+} OpCode;
+
+typedef struct {
+    unsigned char op;                // OpCode
+    int arg;
+    double value;
+} Instruction;
+
+/**
+ * @struct DerivedSignal
+ * @brief A signal computed from the recorded variables, e.g. "P=V*I".
+ */
+typedef struct {
+    char *name;
+    int start;                       // first instruction in Transforms::code
+    int length;                      // number of instructions
+    double *column;                  // one value per recorded row
+} DerivedSignal;
+
+/**
+ * @struct Transforms
+ * @brief Record-time transform stage: derived signals, then conversion to the display units.
+ *
+ * The expressions of all the derived signals are compiled into one flat postfix bytecode.
+ * Recorded rows are transformed by blocks of TRANSFORM_BLOCK rows taken from the result
+ * columns, so every instruction is a tight loop over contiguous doubles that the compiler
+ * can vectorize. Derived signals are computed from the values in the units of the model,
+ * the display unit conversion is then applied in place to the Real columns.
+ */
+typedef struct {
+    Instruction *code;
+    int nCode;
+    int codeCapacity;
+    DerivedSignal *signals;
+    int nSignals;
+    int signalCapacity;
+    int maxDepth;                    // deepest evaluation stack over all the signals
+    double *stack;                   // maxDepth blocks of TRANSFORM_BLOCK doubles
+    int *scaled;                     // variables converted to their display unit
+    int nScaled;
+    size_t nRows;                    // rows already transformed
+    size_t capacity;                 // allocated rows per derived column
+} Transforms;
+
+/**
+ * @brief Parser state of a derived signal expression.
+ */
+typedef struct {
+    const char *p;
+    Transforms *transforms;
+    const ScalarVariable *variables;
+    int depth;                       // stack depth after the instructions emitted so far
+    int maxDepth;
+    int error;
+} ExpressionParser;
+
+static void emit(ExpressionParser *parser, unsigned char op, int arg, double value) {
+    Transforms *transforms = parser->transforms;
+    if (parser->error) return;
+    if (transforms->nCode == transforms->codeCapacity) {
+        int capacity = transforms->codeCapacity ? 2 * transforms->codeCapacity : 64;
+        Instruction *code = (Instruction*)realloc(transforms->code, capacity * sizeof(Instruction));
+        if (!code) { parser->error = 1; return; }
+        transforms->code = code;
+        transforms->codeCapacity = capacity;
+    }
+    Instruction *instruction = &transforms->code[transforms->nCode++];
+    instruction->op = op;
+    instruction->arg = arg;
+    instruction->value = value;
+
+    if (op == OP_LOAD || op == OP_LOAD_DERIVED || op == OP_CONST) {
+        if (++parser->depth > parser->maxDepth) parser->maxDepth = parser->depth;
+    } else if (op != OP_NEG && op != OP_NOT) {
+        parser->depth--;
+    }
+}
+
+static void skipBlanks(ExpressionParser *parser) {
+    while (*parser->p == ' ' || *parser->p == '\t') parser->p++;
+}
+
+// Reads a variable name: 'quoted name', der(name) or a run of name characters
+static int readName(ExpressionParser *parser, char *name) {
+    size_t n = 0;
+    if (*parser->p == '\'') {
+        parser->p++;
+        while (*parser->p && *parser->p != '\'' && n < MAX_NAME_SIZE - 1) name[n++] = *parser->p++;
+        if (*parser->p != '\'') return -1;
+        parser->p++;
+    } else {
+        while ((isalnum((unsigned char)*parser->p) || strchr("_.[]", *parser->p)) && *parser->p &&
+               n < MAX_NAME_SIZE - 1) {
+            name[n++] = *parser->p++;
+        }
+        if (n == 3 && strncmp(name, "der", 3) == 0 && *parser->p == '(') {
+            while (*parser->p && *parser->p != ')' && n < MAX_NAME_SIZE - 2) name[n++] = *parser->p++;
+            if (*parser->p != ')') return -1;
+            name[n++] = *parser->p++;
+        }
+    }
+    name[n] = '\0';
+    return n > 0 ? 0 : -1;
+}
+
+static void parseOr(ExpressionParser *parser);
+
+static void parsePrimary(ExpressionParser *parser) {
+    skipBlanks(parser);
+    if (*parser->p == '(') {
+        parser->p++;
+        parseOr(parser);
+        skipBlanks(parser);
+        if (*parser->p != ')') { parser->error = 1; return; }
+        parser->p++;
+        return;
+    }
+
+    if (isdigit((unsigned char)*parser->p) || *parser->p == '.') {
+        char *end;
+        double value = strtod(parser->p, &end);
+        if (end == parser->p) { parser->error = 1; return; }
+        parser->p = end;
+        emit(parser, OP_CONST, 0, value);
+        return;
+    }
+
+    char name[MAX_NAME_SIZE];
+    if (readName(parser, name) != 0) { parser->error = 1; return; }
+
+    // Earlier derived signals first, then the model variables, unnamed signals are never found
+    Transforms *transforms = parser->transforms;
+    for (int s = 0; s < transforms->nSignals; s++) {
+        if (transforms->signals[s].name && strcmp(transforms->signals[s].name, name) == 0) {
+            emit(parser, OP_LOAD_DERIVED, s, 0);
+            return;
+        }
+    }
+    int i = get_variable_index(name);
+    if (i < 0 || parser->variables[i].type == STRING) {
+        printf("Unknown numeric variable %s in derived signal\n", name);
+        parser->error = 1;
+        return;
+    }
+    emit(parser, OP_LOAD, i, 0);
+}
+
+static void parseUnary(ExpressionParser *parser) {
+    skipBlanks(parser);
+    if (*parser->p == '-') {
+        parser->p++;
+        parseUnary(parser);
+        emit(parser, OP_NEG, 0, 0);
+    } else if (*parser->p == '+') {
+        parser->p++;
+        parseUnary(parser);
+    } else if (*parser->p == '!' && parser->p[1] != '=') {
+        parser->p++;
+        parseUnary(parser);
+        emit(parser, OP_NOT, 0, 0);
+    } else {
+        parsePrimary(parser);
+    }
+}
+
+static void parseProduct(ExpressionParser *parser) {
+    parseUnary(parser);
+    for (;;) {
+        skipBlanks(parser);
+        char op = *parser->p;
+        if (op != '*' && op != '/') return;
+        parser->p++;
+        parseUnary(parser);
+        emit(parser, op == '*' ? OP_MUL : OP_DIV, 0, 0);
+    }
+}
+
+static void parseSum(ExpressionParser *parser) {
+    parseProduct(parser);
+    for (;;) {
+        skipBlanks(parser);
+        char op = *parser->p;
+        if (op != '+' && op != '-') return;
+        parser->p++;
+        parseProduct(parser);
+        emit(parser, op == '+' ? OP_ADD : OP_SUB, 0, 0);
+    }
+}
+
+// A single comparison, comparisons do not chain
+static void parseComparison(ExpressionParser *parser) {
+    parseSum(parser);
+    skipBlanks(parser);
+    static const struct { const char *token; unsigned char op; } comparisons[] = {
+        {"<=", OP_LE}, {">=", OP_GE}, {"==", OP_EQ}, {"!=", OP_NE}, {"<", OP_LT}, {">", OP_GT}
+    };
+    for (size_t k = 0; k < sizeof(comparisons) / sizeof(comparisons[0]); k++) {
+        size_t length = strlen(comparisons[k].token);
+        if (strncmp(parser->p, comparisons[k].token, length) == 0) {
+            parser->p += length;
+            parseSum(parser);
+            emit(parser, comparisons[k].op, 0, 0);
+            return;
+        }
+    }
+}
+
+static void parseAnd(ExpressionParser *parser) {
+    parseComparison(parser);
+    for (;;) {
+        skipBlanks(parser);
+        if (strncmp(parser->p, "&&", 2) != 0) return;
+        parser->p += 2;
+        parseComparison(parser);
+        emit(parser, OP_AND, 0, 0);
+    }
+}
+
+static void parseOr(ExpressionParser *parser) {
+    parseAnd(parser);
+    for (;;) {
+        skipBlanks(parser);
+        if (strncmp(parser->p, "||", 2) != 0) return;
+        parser->p += 2;
+        parseAnd(parser);
+        emit(parser, OP_OR, 0, 0);
+    }
+}
+
+// Compiles an expression into a new signal, which takes the name, NULL for an unnamed signal
+static int compileSignal(Transforms *transforms, char *name, const char *expression, const ScalarVariable *variables) {
+    ExpressionParser parser = {expression, transforms, variables, 0, 0, 0};
+    int start = transforms->nCode;
+    parseOr(&parser);
+    skipBlanks(&parser);
+    if (parser.error || *parser.p != '\0' || parser.depth != 1) {
+        transforms->nCode = start;
+        free(name);
+        return -1;
+    }
+
+    if (transforms->nSignals == transforms->signalCapacity) {
+        int capacity = transforms->signalCapacity ? 2 * transforms->signalCapacity : 8;
+        DerivedSignal *signals = (DerivedSignal*)realloc(transforms->signals, capacity * sizeof(DerivedSignal));
+        if (!signals) {
+            free(name);
+            return -1;
+        }
+        transforms->signals = signals;
+        transforms->signalCapacity = capacity;
+    }
+
+    DerivedSignal *signal = &transforms->signals[transforms->nSignals++];
+    signal->name = name;
+    signal->start = start;
+    signal->length = transforms->nCode - start;
+    signal->column = NULL;
+    if (parser.maxDepth > transforms->maxDepth) transforms->maxDepth = parser.maxDepth;
+    return 0;
+}
+
+/**
+ * @brief Compiles a derived signal "name=expression" and adds it to the transforms.
+ *
+ * Expressions use + - * /, parentheses, numbers, variable names, der(name), 'quoted names'
+ * and the names of the signals defined before. Comparisons < <= > >= == != and the logical
+ * operators && || ! give 1 for true and 0 for false.
+ *
+ * @param transforms The transforms to add the signal to.
+ * @param definition A string of the form "name=expression".
+ * @param variables The model variables.
+ * @return 0 on success, -1 if the definition is invalid or memory is exhausted.
+ */
+int addDerivedSignal(Transforms *transforms, const char *definition, const ScalarVariable *variables) {
+    const char *equal = strchr(definition, '=');
+    if (!equal || equal == definition) return -1;
+
+    const char *nameStart = definition;
+    const char *nameEnd = equal;
+    while (nameStart < nameEnd && (*nameStart == ' ' || *nameStart == '\t')) nameStart++;
+    while (nameEnd > nameStart && (nameEnd[-1] == ' ' || nameEnd[-1] == '\t')) nameEnd--;
+    if (nameStart == nameEnd) return -1;
+
+    char *name = strndup(nameStart, nameEnd - nameStart);
+    if (!name) return -1;
+    return compileSignal(transforms, name, equal + 1, variables);
+}
+
+/**
+ * @brief Compiles an unnamed signal, such as a monitor condition, and adds it to the transforms.
+ *
+ * Later expressions cannot refer to it, so it never hides a model variable.
+ *
+ * @return 0 on success, -1 if the expression is invalid or memory is exhausted.
+ */
+int addUnnamedSignal(Transforms *transforms, const char *expression, const ScalarVariable *variables) {
+    return compileSignal(transforms, NULL, expression, variables);
+}
+
+/**
+ * @brief Converts every Real variable that has a display unit to it at record time.
+ *
+ * @param transforms The transforms to configure.
+ * @param variables The model variables.
+ * @param nVariables The number of model variables.
+ * @return 0 on success, -1 if memory is exhausted.
+ */
+int addDisplayUnits(Transforms *transforms, const ScalarVariable *variables, int nVariables) {
+    free(transforms->scaled);
+    transforms->nScaled = 0;
+    transforms->scaled = (int*)malloc((nVariables > 0 ? nVariables : 1) * sizeof(int));
+    if (!transforms->scaled) return -1;
+
+    for (int i = 0; i < nVariables; i++) {
+        if (variables[i].type == REAL && variable_display_units[i].name) {
+            transforms->scaled[transforms->nScaled++] = i;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Frees the memory held by the transforms.
+ */
+void freeTransforms(Transforms *transforms) {
+    for (int s = 0; s < transforms->nSignals; s++) {
+        free(transforms->signals[s].name);
+        free(transforms->signals[s].column);
+    }
+    free(transforms->signals);
+    free(transforms->code);
+    free(transforms->stack);
+    free(transforms->scaled);
+    memset(transforms, 0, sizeof(Transforms));
+}
+
+// Copies rows [row, row + n) of a variable into a block of doubles
+static void loadBlock(double *block, const Results *results, const ScalarVariable *variables, int i,
+                      size_t row, size_t n) {
+    int k = results->column[i];
+    switch (variables[i].type) {
+        case REAL:
+            memcpy(block, results->realColumns[k] + row, n * sizeof(double));
+            break;
+        case INTEGER:
+        case ENUMERATION:
+            for (size_t j = 0; j < n; j++) block[j] = (double)results->integerColumns[k][row + j];
+            break;
+        case BOOLEAN:
+            for (size_t j = 0; j < n; j++) {
+                block[j] = (double)((results->booleanColumns[k][(row + j) / 8] >> ((row + j) % 8)) & 1);
+            }
+            break;
+        case STRING:
+            break;
+    }
+}
+
+// a = a op b on a block, the operands being distinct blocks of the stack: restrict lets the
+// compiler vectorize each loop without checking for overlap
+static void binaryBlock(int op, double *restrict a, const double *restrict b, size_t n) {
+    switch (op) {
+        case OP_ADD:
+            for (size_t j = 0; j < n; j++) a[j] += b[j];
+            break;
+        case OP_SUB:
+            for (size_t j = 0; j < n; j++) a[j] -= b[j];
+            break;
+        case OP_MUL:
+            for (size_t j = 0; j < n; j++) a[j] *= b[j];
+            break;
+        case OP_DIV:
+            for (size_t j = 0; j < n; j++) a[j] /= b[j];
+            break;
+        case OP_LT:
+            for (size_t j = 0; j < n; j++) a[j] = a[j] < b[j];
+            break;
+        case OP_LE:
+            for (size_t j = 0; j < n; j++) a[j] = a[j] <= b[j];
+            break;
+        case OP_GT:
+            for (size_t j = 0; j < n; j++) a[j] = a[j] > b[j];
+            break;
+        case OP_GE:
+            for (size_t j = 0; j < n; j++) a[j] = a[j] >= b[j];
+            break;
+        case OP_EQ:
+            for (size_t j = 0; j < n; j++) a[j] = a[j] == b[j];
+            break;
+        case OP_NE:
+            for (size_t j = 0; j < n; j++) a[j] = a[j] != b[j];
+            break;
+        case OP_AND:
+            for (size_t j = 0; j < n; j++) a[j] = (double)(a[j] != 0) * (double)(b[j] != 0);   // products of 0/1, no branch
+            break;
+        case OP_OR:
+            for (size_t j = 0; j < n; j++) a[j] = 1.0 - (double)(a[j] == 0) * (double)(b[j] == 0);
+            break;
+    }
+}
+
+// Runs the bytecode of every derived signal, then the display unit conversions, on n rows from row
+static void transformBlock(Transforms *transforms, Results *results, const ScalarVariable *variables,
+                           size_t row, size_t n) {
+    for (int s = 0; s < transforms->nSignals; s++) {
+        const DerivedSignal *signal = &transforms->signals[s];
+        double *stack = transforms->stack;
+        int depth = 0;
+
+        for (int c = signal->start; c < signal->start + signal->length; c++) {
+            const Instruction *instruction = &transforms->code[c];
+            double *top = stack + depth * TRANSFORM_BLOCK;   // next free block
+            double *b = depth > 0 ? top - TRANSFORM_BLOCK : stack;  // operands of an operation
+            double *a = depth > 1 ? b - TRANSFORM_BLOCK : stack;
+            switch (instruction->op) {
+                case OP_LOAD:
+                    loadBlock(top, results, variables, instruction->arg, row, n);
+                    depth++;
+                    break;
+                case OP_LOAD_DERIVED:
+                    memcpy(top, transforms->signals[instruction->arg].column + row, n * sizeof(double));
+                    depth++;
+                    break;
+                case OP_CONST: {
+                    double value = instruction->value;   // read once, it could alias the block
+                    for (size_t j = 0; j < n; j++) top[j] = value;
+                    depth++;
+                    break;
+                }
+                case OP_NEG:
+                    for (size_t j = 0; j < n; j++) b[j] = -b[j];
+                    break;
+                case OP_NOT:
+                    for (size_t j = 0; j < n; j++) b[j] = b[j] == 0;
+                    break;
+                default:
+                    binaryBlock(instruction->op, a, b, n);
+                    depth--;
+                    break;
+            }
+        }
+        memcpy(signal->column + row, stack, n * sizeof(double));
+    }
+
+    for (int s = 0; s < transforms->nScaled; s++) {
+        int i = transforms->scaled[s];
+        double *column = results->realColumns[results->column[i]] + row;
+        double factor = variable_display_units[i].factor;
+        double offset = variable_display_units[i].offset;
+        for (size_t j = 0; j < n; j++) column[j] = factor * column[j] + offset;
+    }
+}
+
+/**
+ * @brief Evaluates the bytecode of one derived signal on a single recorded row.
+ *
+ * Used where a value is needed as soon as the row is recorded, instead of by blocks.
+ *
+ * @param transforms The compiled signals.
+ * @param s The signal to evaluate.
+ * @param results The recorded results, in the units of the model.
+ * @param variables The model variables.
+ * @param row The row to evaluate the signal on.
+ * @param derived The values of the signals before s on this row.
+ * @param stack At least maxDepth doubles.
+ * @return The value of the signal.
+ */
+double evaluateSignal(const Transforms *transforms, int s, const Results *results, const ScalarVariable *variables,
+                      size_t row, const double *derived, double *stack) {
+    const DerivedSignal *signal = &transforms->signals[s];
+    int depth = 0;
+
+    for (int c = signal->start; c < signal->start + signal->length; c++) {
+        const Instruction *instruction = &transforms->code[c];
+        double *a = depth > 1 ? &stack[depth - 2] : stack, b = depth > 0 ? stack[depth - 1] : 0;
+        switch (instruction->op) {
+            case OP_LOAD: stack[depth++] = getResultValue(results, variables, instruction->arg, row); break;
+            case OP_LOAD_DERIVED: stack[depth++] = derived[instruction->arg]; break;
+            case OP_CONST: stack[depth++] = instruction->value; break;
+            case OP_ADD: *a += b; depth--; break;
+            case OP_SUB: *a -= b; depth--; break;
+            case OP_MUL: *a *= b; depth--; break;
+            case OP_DIV: *a /= b; depth--; break;
+            case OP_NEG: stack[depth - 1] = -b; break;
+            case OP_LT: *a = *a < b; depth--; break;
+            case OP_LE: *a = *a <= b; depth--; break;
+            case OP_GT: *a = *a > b; depth--; break;
+            case OP_GE: *a = *a >= b; depth--; break;
+            case OP_EQ: *a = *a == b; depth--; break;
+            case OP_NE: *a = *a != b; depth--; break;
+            case OP_AND: *a = *a != 0 && b != 0; depth--; break;
+            case OP_OR: *a = *a != 0 || b != 0; depth--; break;
+            case OP_NOT: stack[depth - 1] = b == 0; break;
+        }
+    }
+    return stack[0];
+}
+
+/**
+ * @brief Transforms the rows recorded since the last call, by whole blocks.
+ *
+ * Must be called after recordResults; the rows of an incomplete block are kept for a later
+ * call unless flush is set, which transforms all of them (at the end of the simulation).
+ * Rows of the results are in the display units once transformed.
+ *
+ * @param transforms The transforms to apply.
+ * @param results The recorded results.
+ * @param variables The model variables.
+ * @param flush Transform the last incomplete block too.
+ * @return 0 on success, -1 if memory is exhausted.
+ */
+int applyTransforms(Transforms *transforms, Results *results, const ScalarVariable *variables, int flush) {
+    size_t pending = results->nRows - transforms->nRows;
+    if (pending == 0 || (!flush && pending < TRANSFORM_BLOCK)) return 0;
+
+    if (!transforms->stack && transforms->maxDepth > 0) {
+        transforms->stack = (double*)malloc(transforms->maxDepth * TRANSFORM_BLOCK * sizeof(double));
+        if (!transforms->stack) return -1;
+    }
+    if (results->nRows > transforms->capacity) {
+        size_t capacity = results->capacity;
+        for (int s = 0; s < transforms->nSignals; s++) {
+            double *column = (double*)realloc(transforms->signals[s].column, capacity * sizeof(double));
+            if (!column) return -1;
+            transforms->signals[s].column = column;
+        }
+        transforms->capacity = capacity;
+    }
+
+    while (transforms->nRows < results->nRows) {
+        size_t n = min(results->nRows - transforms->nRows, TRANSFORM_BLOCK);
+        if (n < TRANSFORM_BLOCK && !flush) break;
+        transformBlock(transforms, results, variables, transforms->nRows, n);
+        transforms->nRows += n;
+    }
+    return 0;
+}
@@ -0,0 +1,332 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include "headers/fmi2TypesPlatform.h"
+#include "headers/fmi2FunctionTypes.h"
+#include "headers/fmi2Functions.h"
+
+#define TRIM_TOLERANCE 1e-8          // largest |der(x)| accepted as a steady state
+#define TRIM_MAX_ITERATIONS 50       // Newton iterations before the pseudo-transient fallback
+#define TRIM_MAX_PSEUDO_STEPS 2000
+#define TRIM_MAX_BACKTRACKS 10
+
+/**
+ * @struct Trim
+ * @brief Steady-state search: finds the states (and free inputs) for which der(x) = 0.
+ *
+ * The unknowns are the states which are not fixed, then the free inputs, so there must be as
+ * many fixed states as free inputs. The Jacobian of der(x) is the [A B] part of the linearization
+ * pattern, evaluated with directional derivatives or finite differences.
+ */
+typedef struct {
+    int enabled;
+    int *freeInputs;                 // variable index of the inputs solved for
+    int nFreeInputs;
+    int *fixedStates;                // index in x of the states kept at their initial value
+    int nFixedStates;
+    Linearization jacobian;          // pattern and coloring of [A B; C D]
+    int n;                           // number of unknowns, the number of states
+    int *unknownColumns;             // column of each unknown in the pattern
+    int *position;                   // per column, position in the unknowns or -1
+} Trim;
+
+/**
+ * @brief Frees the memory held by the trim options.
+ */
+void freeTrim(Trim *trim) {
+    free(trim->freeInputs);
+    free(trim->fixedStates);
+    free(trim->unknownColumns);
+    free(trim->position);
+    freeLinearization(&trim->jacobian);
+    memset(trim, 0, sizeof(Trim));
+}
+
+/**
+ * @brief Lets the trim solve for a Real input, given by its name.
+ *
+ * @return 0 on success, -1 if the name is not a Real input or memory is exhausted.
+ */
+int addTrimFreeInput(Trim *trim, const char *name, const ScalarVariable *variables) {
+    int i = get_variable_index(name);
+    if (i < 0 || variables[i].causality != INPUT || variables[i].type != REAL) return -1;
+
+    int *freeInputs = (int*)realloc(trim->freeInputs, (trim->nFreeInputs + 1) * sizeof(int));
+    if (!freeInputs) return -1;
+    trim->freeInputs = freeInputs;
+    trim->freeInputs[trim->nFreeInputs++] = i;
+    trim->enabled = 1;
+    return 0;
+}
+
+/**
+ * @brief Keeps a continuous state, given by its name, at its initial value during the trim.
+ *
+ * @return 0 on success, -1 if the name is not a continuous state or memory is exhausted.
+ */
+int addTrimFixedState(Trim *trim, const char *name) {
+    int i = get_variable_index(name);
+    int k = 0;
+    while (k < model.numberOfContinuousStates && model_states[k].state != i) k++;
+    if (i < 0 || k == model.numberOfContinuousStates) return -1;
+
+    int *fixedStates = (int*)realloc(trim->fixedStates, (trim->nFixedStates + 1) * sizeof(int));
+    if (!fixedStates) return -1;
+    trim->fixedStates = fixedStates;
+    trim->fixedStates[trim->nFixedStates++] = k;
+    trim->enabled = 1;
+    return 0;
+}
+
+/**
+ * @brief Builds the Jacobian pattern and the list of unknowns.
+ *
+ * @return 0 on success, -1 if the problem is not square or memory is exhausted.
+ */
+int initTrim(Trim *trim, const ScalarVariable *variables, int nVariables) {
+    if (trim->nFreeInputs != trim->nFixedStates) {
+        printf("The trim needs as many fixed states as free inputs (%d fixed, %d free)\n",
+               trim->nFixedStates, trim->nFreeInputs);
+        return -1;
+    }
+    if (initLinearization(&trim->jacobian, variables, nVariables) != 0) return -1;
+
+    const LinearizationPattern *pattern = &trim->jacobian.pattern;
+    int nColumns = pattern->nx + pattern->nu;
+    trim->n = pattern->nx;
+    trim->unknownColumns = (int*)malloc((trim->n + 1) * sizeof(int));
+    trim->position = (int*)malloc((nColumns + 1) * sizeof(int));
+    if (!trim->unknownColumns || !trim->position) return -1;
+
+    for (int c = 0; c < nColumns; c++) trim->position[c] = c < pattern->nx ? 0 : -1;
+    for (int k = 0; k < trim->nFixedStates; k++) trim->position[trim->fixedStates[k]] = -1;
+    for (int k = 0; k < trim->nFreeInputs; k++) {
+        for (int c = pattern->nx; c < nColumns; c++) {
+            if (pattern->knownVariables[c] == trim->freeInputs[k]) trim->position[c] = 0;
+        }
+    }
+
+    int n = 0;
+    for (int c = 0; c < nColumns; c++) {
+        if (trim->position[c] == 0) {
+            trim->position[c] = n;
+            trim->unknownColumns[n++] = c;
+        }
+    }
+    if (n != trim->n) {
+        printf("A state is fixed or an input is freed twice in the trim\n");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Solves M y = b in place by Gaussian elimination with partial pivoting.
+ *
+ * @param M The n x n matrix, row-major, overwritten.
+ * @param b The right-hand side, overwritten by the solution.
+ * @return 0 on success, -1 if the matrix is singular.
+ */
+static int solveLinearSystem(double *M, double *b, int n) {
+    double scale = 0;
+    for (int k = 0; k < n * n; k++) scale = fmax(scale, fabs(M[k]));
+    if (scale == 0) return n > 0 ? -1 : 0;
+
+    for (int j = 0; j < n; j++) {
+        int pivot = j;
+        for (int i = j + 1; i < n; i++) {
+            if (fabs(M[i * n + j]) > fabs(M[pivot * n + j])) pivot = i;
+        }
+        if (fabs(M[pivot * n + j]) <= n * DBL_EPSILON * scale) return -1;
+        if (pivot != j) {
+            for (int k = 0; k < n; k++) {
+                double t = M[j * n + k]; M[j * n + k] = M[pivot * n + k]; M[pivot * n + k] = t;
+            }
+            double t = b[j]; b[j] = b[pivot]; b[pivot] = t;
+        }
+        for (int i = j + 1; i < n; i++) {
+            double factor = M[i * n + j] / M[j * n + j];
+            if (factor == 0) continue;
+            for (int k = j; k < n; k++) M[i * n + k] -= factor * M[j * n + k];
+            b[i] -= factor * b[j];
+        }
+    }
+    for (int j = n - 1; j >= 0; j--) {
+        for (int k = j + 1; k < n; k++) b[j] -= M[j * n + k] * b[k];
+        b[j] /= M[j * n + j];
+    }
+    return 0;
+}
+
+/**
+ * @brief Sets the states and the free inputs from the unknowns and evaluates der(x).
+ *
+ * @param v The states then the Real inputs of the pattern, the unknowns are copied into it.
+ * @param z The unknowns.
+ * @param r The derivatives, the residual of the trim.
+ * @param norm The largest |r[i]|, infinite if the FMU fails or returns a NaN.
+ */
+static fmi2Status evaluateTrim(FMU *fmu, fmi2Component component, const Trim *trim, double *v,
+                               const double *z, double *r, double *norm) {
+    const LinearizationPattern *pattern = &trim->jacobian.pattern;
+    for (int k = 0; k < trim->n; k++) v[trim->unknownColumns[k]] = z[k];
+
+    fmi2Status status = fmu->setContinuousStates(component, v, pattern->nx);
+    fmi2Status fmi2Flag;
+    if (status <= fmi2Warning && pattern->nu > 0) {
+        fmi2Flag = fmu->setReal(component, pattern->knownVRs + pattern->nx, pattern->nu, v + pattern->nx);
+        if (fmi2Flag > status) status = fmi2Flag;
+    }
+    if (status <= fmi2Warning) {
+        fmi2Flag = fmu->getDerivatives(component, r, pattern->nx);
+        if (fmi2Flag > status) status = fmi2Flag;
+    }
+
+    *norm = status > fmi2Warning ? INFINITY : 0;
+    for (int i = 0; i < pattern->nx && status <= fmi2Warning; i++) {
+        *norm = isnan(r[i]) ? INFINITY : fmax(*norm, fabs(r[i]));
+    }
+    return status;
+}
+
+/**
+ * @brief Fills the dense Jacobian of der(x) with respect to the unknowns at the current point.
+ */
+static fmi2Status trimJacobian(FMU *fmu, fmi2Component component, const Trim *trim, double *values, double *J) {
+    const LinearizationPattern *pattern = &trim->jacobian.pattern;
+    fmi2Status status = model.providesDirectionalDerivative
+                        ? directionalJacobian(fmu, component, pattern, values)
+                        : finiteDifferenceJacobian(fmu, component, pattern, values);
+
+    memset(J, 0, (size_t)trim->n * trim->n * sizeof(double));
+    for (int r = 0; r < pattern->nx; r++) {
+        for (int p = pattern->rowStart[r]; p < pattern->rowStart[r + 1]; p++) {
+            int k = trim->position[pattern->columns[p]];
+            if (k >= 0) J[r * trim->n + k] = values[p];
+        }
+    }
+    return status;
+}
+
+/**
+ * @brief Moves the instance to a steady state, der(x) = 0, before the simulation starts.
+ *
+ * Newton iterations with a backtracking line search are tried first. If they stall or the
+ * Jacobian is singular, pseudo-transient continuation takes over from the best point found:
+ * implicit Euler steps (I/dt - J) dz = der(x) whose step dt grows as the residual decreases.
+ * The instance is left at the solution, set with setContinuousStates and setReal.
+ *
+ * @param fmu Pointer to the FMU structure
+ * @param component The instance, in continuous-time mode
+ * @param trim The trim options, initialized with initTrim
+ * @param h The first pseudo-time step, the simulation step size
+ * @return fmi2Status The worst status of the FMU, fmi2Error if no steady state was found
+ */
+fmi2Status trimSteadyState(FMU *fmu, fmi2Component component, Trim *trim, double h) {
+    const LinearizationPattern *pattern = &trim->jacobian.pattern;
+    int n = trim->n, nColumns = pattern->nx + pattern->nu;
+    double *v = (double*)malloc((nColumns + 1) * sizeof(double));
+    double *z = (double*)malloc((n + 1) * sizeof(double));
+    double *zNew = (double*)malloc((n + 1) * sizeof(double));
+    double *r = (double*)malloc((n + 1) * sizeof(double));
+    double *dz = (double*)malloc((n + 1) * sizeof(double));
+    double *J = (double*)malloc(((size_t)n * n + 1) * sizeof(double));
+    double *values = (double*)calloc(pattern->nNonZeros + 1, sizeof(double));
+    fmi2Status status = fmi2OK, fmi2Flag;
+    double norm, normNew;
+    int converged = 0, iteration = 0, pseudoStep = 0;
+
+    if (!v || !z || !zNew || !r || !dz || !J || !values) {
+        status = fmi2Error;
+        goto done;
+    }
+
+    status = fmu->getContinuousStates(component, v, pattern->nx);
+    if (status <= fmi2Warning && pattern->nu > 0) {
+        fmi2Flag = fmu->getReal(component, pattern->knownVRs + pattern->nx, pattern->nu, v + pattern->nx);
+        if (fmi2Flag > status) status = fmi2Flag;
+    }
+    if (status > fmi2Warning) goto done;
+    for (int k = 0; k < n; k++) z[k] = v[trim->unknownColumns[k]];
+
+    fmi2Flag = evaluateTrim(fmu, component, trim, v, z, r, &norm);
+    if (fmi2Flag > status) status = fmi2Flag;
+    if (status > fmi2Warning) goto done;
+    converged = norm <= TRIM_TOLERANCE;
+
+    // Newton with backtracking: z += lambda dz, J dz = -der(x)
+    for (; !converged && iteration < TRIM_MAX_ITERATIONS; iteration++) {
+        fmi2Flag = trimJacobian(fmu, component, trim, values, J);
+        if (fmi2Flag > fmi2Warning) break;
+        for (int k = 0; k < n; k++) dz[k] = -r[k];
+        if (solveLinearSystem(J, dz, n) != 0) break;
+
+        double lambda = 1;
+        int accepted = 0;
+        for (int b = 0; b <= TRIM_MAX_BACKTRACKS && !accepted; b++, lambda /= 2) {
+            for (int k = 0; k < n; k++) zNew[k] = z[k] + lambda * dz[k];
+            evaluateTrim(fmu, component, trim, v, zNew, r, &normNew);
+            accepted = normNew < (1 - 1e-4 * lambda) * norm;
+        }
+        if (!accepted) break;
+        memcpy(z, zNew, n * sizeof(double));
+        norm = normNew;
+        converged = norm <= TRIM_TOLERANCE;
+    }
+
+    // Pseudo-transient continuation from the last accepted point
+    if (!converged) {
+        INFO("Newton stalled after %d iterations (residual %g), pseudo-transient continuation\n", iteration, norm);
+        fmi2Flag = evaluateTrim(fmu, component, trim, v, z, r, &norm);
+        double dt = h;
+        for (; !converged && pseudoStep < TRIM_MAX_PSEUDO_STEPS && fmi2Flag <= fmi2Warning; pseudoStep++) {
+            fmi2Flag = trimJacobian(fmu, component, trim, values, J);
+            if (fmi2Flag > fmi2Warning) break;
+            for (int k = 0; k < n * n; k++) J[k] = -J[k];
+            for (int k = 0; k < n; k++) {
+                J[k * n + k] += 1 / dt;
+                dz[k] = r[k];
+            }
+            if (solveLinearSystem(J, dz, n) != 0) {
+                dt /= 10;
+                continue;
+            }
+
+            for (int k = 0; k < n; k++) zNew[k] = z[k] + dz[k];
+            fmi2Flag = evaluateTrim(fmu, component, trim, v, zNew, r, &normNew);
+            if (normNew == INFINITY) {
+                // Failed evaluation: smaller pseudo-time step from the previous point
+                dt /= 10;
+                fmi2Flag = evaluateTrim(fmu, component, trim, v, z, r, &norm);
+                continue;
+            }
+            // Switched evolution relaxation: the step grows as the residual decreases
+            dt = fmin(dt * norm / fmax(normNew, DBL_MIN), 1e12);
+            memcpy(z, zNew, n * sizeof(double));
+            norm = normNew;
+            converged = norm <= TRIM_TOLERANCE;
+        }
+        if (fmi2Flag > status) status = fmi2Flag;
+    }
+
+    if (converged) {
+        INFO("Steady state found after %d Newton iterations and %d pseudo-time steps\n", iteration, pseudoStep);
+        fmi2Flag = evaluateTrim(fmu, component, trim, v, z, r, &norm);
+        if (fmi2Flag > status) status = fmi2Flag;
+    } else {
+        printf("No steady state found, largest derivative %g\n", norm);
+        status = fmi2Error;
+    }
+
+done:
+    free(v);
+    free(z);
+    free(zNew);
+    free(r);
+    free(dz);
+    free(J);
+    free(values);
+    return status;
+}